@@ -11,13 +11,11 @@
 #include "EmptyRegularizer.hpp"
 #include "GaussianNoiseGenerator.hpp"
 #include "ImResize.h"
+#include "ImageIO.hpp"
 #include "MotionBlurImageGenerator.hpp"
 #include "MotionBlurMaker.hpp"
 #include "RLDeblurrer.hpp"
 #include "RMSErrorCalculator.hpp"
-#include "bitmap.h"
-
-constexpr auto fileExtension = ".bmp";
 
 int main(int argc, char* argv[]) {
   if (argc < 2) {
@@ -26,18 +24,19 @@ int main(int argc, char* argv[]) {
   }
 
   std::string fname{argv[1]};
-  const auto pos = fname.find(fileExtension);
-  if (pos == std::string::npos) {
-    printf("Expected %s to end with %s\n", fname.c_str(), fileExtension);
+  const std::string fileExtension = getImageExtension(fname);
+  if (fileExtension.empty()) {
+    printf("Expected %s to end with .bmp, .pfm, .pgm or .ppm\n",
+           fname.c_str());
     return EXIT_SUCCESS;
   }
-  const auto prefix = fname.substr(0, pos);
+  const auto prefix = fname.substr(0, fname.size() - fileExtension.size());
 
   int width = 0, height = 0;
   std::vector<float> fImg[3];
 
   printf("Load Image: %s\n", fname.c_str());
-  readBMPchannels(fname, fImg[0], fImg[1], fImg[2], width, height);
+  readImageChannels(fname, fImg[0], fImg[1], fImg[2], width, height);
   int blurwidth = width, blurheight = height;
 
   if (fImg[0].empty()) {
@@ -86,7 +85,7 @@ int main(int argc, char* argv[]) {
   ///////////////////////////////////
   generateMotionBlurredImage(fImg, inputWeight, outputWeight, width, height,
                              blurwidth, blurheight, prefix, blurGenerator,
-                             errorCalculator, bImg);
+                             errorCalculator, bImg, fileExtension);
 
   // Add noise
   const float sigma = 2.0f;
@@ -94,7 +93,7 @@ int main(int argc, char* argv[]) {
       prefix + "_blur_noise_sigma" + std::to_string(sigma) + "_";
   GaussianNoiseGenerator noiseGenerator(sigma);
   addNoiseToImage(bImg, width, height, blurwidth, blurheight, noisePrefix,
-                  noiseGenerator, errorCalculator);
+                  noiseGenerator, errorCalculator, fileExtension);
 
   ///////////////////////////////////
   // Main Deblurring algorithm
@@ -123,11 +122,18 @@ int main(int argc, char* argv[]) {
 
     printf("Basic Algorithm:\n");
 
-    DeblurParameters rLParams{.Niter = 500, .bPoisson = true};
-    rLDeblurrer.deblurRgb(bImg[0].data(), bImg[1].data(), bImg[2].data(),
-                          blurwidth, blurheight, deblurImg[0].data(),
-                          deblurImg[1].data(), deblurImg[2].data(), width,
-                          height, rLParams, emptyRegularizer, 0.0);
+    // Stop once an iteration changes the image by less than 0.1%
+    DeblurParameters rLParams{.Niter = 500,
+                              .bPoisson = true,
+                              .relativeChangeThreshold = 1e-3f};
+    const DeblurResult result = rLDeblurrer.deblurRgb(
+        bImg[0].data(), bImg[1].data(), bImg[2].data(), blurwidth, blurheight,
+        deblurImg[0].data(), deblurImg[1].data(), deblurImg[2].data(), width,
+        height, rLParams, emptyRegularizer, 0.0);
+    printf("Stopped after %d iterations on %s\n", result.iterations,
+           toString(result.reason));
+    printf("Peak scratch memory: %.1f MB\n",
+           result.peakBufferBytes / (1024.0 * 1024.0));
     RMSError = errorCalculator.calculateErrorRgb(
         deblurImg[0].data(), deblurImg[1].data(), deblurImg[2].data(), width,
         height);
@@ -135,8 +141,8 @@ int main(int argc, char* argv[]) {
     fname = prefix + "_deblurBasic_" + std::to_string(RMSError * 255.0f) +
             fileExtension;
     printf("Done, RMS Error: %f\n", RMSError * 255.0f);
-    writeBMPchannels(fname, width, height, deblurImg[0], deblurImg[1],
-                     deblurImg[2]);
+    writeImageChannels(fname, width, height, deblurImg[0], deblurImg[1],
+                       deblurImg[2]);
   }
 
   return EXIT_SUCCESS;
@@ -9,13 +9,11 @@
 #include "DeblurParameters.hpp"
 #include "GaussianNoiseGenerator.hpp"
 #include "ImResize.h"
+#include "ImageIO.hpp"
 #include "MotionBlurImageGenerator.hpp"
 #include "MotionBlurMaker.hpp"
 #include "ProjectiveMotionRLMultiScaleGray.hpp"
 #include "RMSErrorCalculator.hpp"
-#include "bitmap.h"
-
-constexpr auto fileExtension = ".bmp";
 
 int main(int argc, char* argv[]) {
   if (argc < 2) {
@@ -24,18 +22,19 @@ int main(int argc, char* argv[]) {
   }
 
   std::string fname{argv[1]};
-  const auto pos = fname.find(fileExtension);
-  if (pos == std::string::npos) {
-    printf("Expected %s to end with %s\n", fname.c_str(), fileExtension);
+  const std::string fileExtension = getImageExtension(fname);
+  if (fileExtension.empty()) {
+    printf("Expected %s to end with .bmp, .pfm, .pgm or .ppm\n",
+           fname.c_str());
     return EXIT_SUCCESS;
   }
-  const auto prefix = fname.substr(0, pos);
+  const auto prefix = fname.substr(0, fname.size() - fileExtension.size());
 
   int width = 0, height = 0;
   std::vector<float> fImg[3];
 
   printf("Load Image: %s\n", fname.c_str());
-  readBMPchannels(fname, fImg[0], fImg[1], fImg[2], width, height);
+  readImageChannels(fname, fImg[0], fImg[1], fImg[2], width, height);
   int blurwidth = width, blurheight = height;
 
   if (fImg[0].empty()) {
@@ -83,7 +82,7 @@ int main(int argc, char* argv[]) {
   ///////////////////////////////////
   generateMotionBlurredImage(fImg, inputWeight, outputWeight, width, height,
                              blurwidth, blurheight, prefix, blurGenerator,
-                             errorCalculator, bImg);
+                             errorCalculator, bImg, fileExtension);
 
   // Add noise
   const float sigma = 2.0f;
@@ -91,7 +90,7 @@ int main(int argc, char* argv[]) {
       prefix + "_blur_noise_sigma" + std::to_string(sigma) + "_";
   GaussianNoiseGenerator noiseGenerator(sigma);
   addNoiseToImage(bImg, width, height, blurwidth, blurheight, noisePrefix,
-                  noiseGenerator, errorCalculator);
+                  noiseGenerator, errorCalculator, fileExtension);
 
   ///////////////////////////////////
   // Projective Motion RL Multi Scale Gray
@@ -108,7 +107,8 @@ int main(int argc, char* argv[]) {
 
     ProjectiveMotionRLMultiScaleGray rLDeblurrerMultiscale;
 
-    for (int i = 0; i < MotionBlurImageGenerator::NumSamples; i++) {
+    rLDeblurrerMultiscale.SetNumSamples(blurGenerator.GetNumSamples());
+    for (int i = 0; i < blurGenerator.GetNumSamples(); i++) {
       rLDeblurrerMultiscale.Hmatrix[i] = blurGenerator.Hmatrix[i];
       Homography::MatrixInverse(rLDeblurrerMultiscale.Hmatrix[i].Hmatrix,
                                 rLDeblurrerMultiscale.IHmatrix[i].Hmatrix);
@@ -133,8 +133,8 @@ int main(int argc, char* argv[]) {
     fname = prefix + "_deblurMultiscale_" + std::to_string(RMSError * 255.0f) +
             fileExtension;
     printf("Done, RMS Error: %f\n", RMSError * 255.0f);
-    writeBMPchannels(fname, width, height, deblurImg[0], deblurImg[1],
-                     deblurImg[2]);
+    writeImageChannels(fname, width, height, deblurImg[0], deblurImg[1],
+                       deblurImg[2]);
   }
 
   return EXIT_SUCCESS;
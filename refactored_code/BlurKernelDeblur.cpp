@@ -13,14 +13,13 @@
 #include "EmptyRegularizer.hpp"
 #include "GaussianNoiseGenerator.hpp"
 #include "ImResize.h"
+#include "ImageIO.hpp"
 #include "KernelRegularizer.hpp"
 #include "MotionBlurMaker.hpp"
 #include "RLDeblurrer.hpp"
 #include "RMSErrorCalculator.hpp"
 #include "bitmap.h"
 
-constexpr auto fileExtension = ".bmp";
-
 void fillGaussian5x5Kernel(float* aKernelImg, int width, int height);
 
 void positiveXlineKernel(int aLength, float* aKernelImg, int width, int height);
@@ -123,7 +122,7 @@ class BoxBlurImageGenerator : public IBlurImageGenerator {
     }
   }
 
-  void SetBuffer(int width, int height) override {}
+  void SetBuffer(int width, int height, int channels) override {}
 
   void ClearBuffer() override {}
 };
@@ -135,18 +134,19 @@ int main(int argc, char* argv[]) {
   }
 
   std::string fname{argv[1]};
-  const auto pos = fname.find(fileExtension);
-  if (pos == std::string::npos) {
-    printf("Expected %s to end with %s\n", fname.c_str(), fileExtension);
+  const std::string fileExtension = getImageExtension(fname);
+  if (fileExtension.empty()) {
+    printf("Expected %s to end with .bmp, .pfm, .pgm or .ppm\n",
+           fname.c_str());
     return EXIT_SUCCESS;
   }
-  const auto prefix = fname.substr(0, pos);
+  const auto prefix = fname.substr(0, fname.size() - fileExtension.size());
 
   int width = 0, height = 0;
   std::vector<float> fImg[3];
 
   printf("Load Image: %s\n", fname.c_str());
-  readBMPchannels(fname, fImg[0], fImg[1], fImg[2], width, height);
+  readImageChannels(fname, fImg[0], fImg[1], fImg[2], width, height);
   int blurwidth = width, blurheight = height;
 
   if (fImg[0].empty()) {
@@ -213,7 +213,8 @@ int main(int argc, char* argv[]) {
 
   generateMotionBlurredImage(kernelImg, inputWeight, outputWeight, width,
                              height, blurwidth, blurheight, prefix,
-                             blurGenerator, errorCalculator, deblurImg);
+                             blurGenerator, errorCalculator, deblurImg,
+                             fileExtension);
 
   errorCalculator.SetGroundTruthImgRgb(
       kernelImg[0].data(), kernelImg[1].data(), kernelImg[2].data(), width,
@@ -225,7 +226,8 @@ int main(int argc, char* argv[]) {
   ///////////////////////////////////
   generateMotionBlurredImage(kernelImg, inputWeight, outputWeight, width,
                              height, blurwidth, blurheight, prefix,
-                             blurGenerator, emptyErrorCalculator, bImg);
+                             blurGenerator, emptyErrorCalculator, bImg,
+                             fileExtension);
 
   // Add noise
   // const float sigma = 2.0f;
@@ -288,8 +290,8 @@ int main(int argc, char* argv[]) {
   printf("Done, RMS Error: %f\n", RMSError * 255.0f);
 
   // TODO: Restore when algorithm is fixed
-  writeBMPchannels(fname, width, height, deblurImg[0], deblurImg[1],
-                   deblurImg[2]);
+  writeImageChannels(fname, width, height, deblurImg[0], deblurImg[1],
+                     deblurImg[2]);
 
   return EXIT_SUCCESS;
 }
@@ -1,7 +1,10 @@
 #include <charconv>
+#include <chrono>
+#include <cmath>
 #include <cstring>
 #include <fstream>
 #include <iomanip>
+#include <ostream>
 #include <string>
 #include <vector>
 
@@ -11,13 +14,95 @@
 #include "EmptyRegularizer.hpp"
 #include "GaussianNoiseGenerator.hpp"
 #include "ImResize.h"
+#include "ImageIO.hpp"
 #include "MotionBlurImageGenerator.hpp"
 #include "MotionBlurMaker.hpp"
 #include "RLDeblurrer.hpp"
 #include "RMSErrorCalculator.hpp"
-#include "bitmap.h"
 
-constexpr auto fileExtension = ".bmp";
+// Writes the RMS error of every iteration of a deblurring call
+class RMSErrorRecorder : public IErrorCalculator {
+ public:
+  RMSErrorRecorder(RMSErrorCalculator& aErrorCalculator, std::ostream& aStream)
+      : mErrorCalculator(aErrorCalculator), mStream(aStream) {}
+
+  float calculateErrorRgb(float* ImgR, float* ImgG, float* ImgB, int width,
+                          int height) override {
+    const float RMSError =
+        mErrorCalculator.calculateErrorRgb(ImgR, ImgG, ImgB, width, height);
+    mStream << std::setprecision(12) << RMSError * 255.0f << '\n';
+    return RMSError;
+  }
+
+  float calculateErrorGray(float* Img, int width, int height) override {
+    const float RMSError =
+        mErrorCalculator.calculateErrorGray(Img, width, height);
+    mStream << std::setprecision(12) << RMSError * 255.0f << '\n';
+    return RMSError;
+  }
+
+ private:
+  RMSErrorCalculator& mErrorCalculator;
+  std::ostream& mStream;
+};
+
+// Records the RMS error and the time of every iteration of a deblurring
+// call, less the time of the error computation
+class RMSTimeRecorder : public IErrorCalculator {
+ public:
+  explicit RMSTimeRecorder(RMSErrorCalculator& aErrorCalculator)
+      : mErrorCalculator(aErrorCalculator) {}
+
+  // Called before the deblurring call
+  void Start() {
+    mErrors.clear();
+    mSeconds.clear();
+    mErrorSeconds = 0.0;
+    mStart = std::chrono::steady_clock::now();
+  }
+
+  float calculateErrorRgb(float* ImgR, float* ImgG, float* ImgB, int width,
+                          int height) override {
+    const auto begin = std::chrono::steady_clock::now();
+    const float RMSError =
+        mErrorCalculator.calculateErrorRgb(ImgR, ImgG, ImgB, width, height);
+    Record(begin, RMSError);
+    return RMSError;
+  }
+
+  float calculateErrorGray(float* Img, int width, int height) override {
+    const auto begin = std::chrono::steady_clock::now();
+    const float RMSError =
+        mErrorCalculator.calculateErrorGray(Img, width, height);
+    Record(begin, RMSError);
+    return RMSError;
+  }
+
+  float GetFinalError() const { return mErrors.empty() ? NAN : mErrors.back(); }
+  double GetSeconds() const { return mSeconds.empty() ? 0.0 : mSeconds.back(); }
+  // Seconds until the error was at or below aTarget, negative if it was not
+  double GetTimeToTarget(float aTarget) const {
+    for (std::size_t i = 0; i < mErrors.size(); i++) {
+      if (mErrors[i] <= aTarget) return mSeconds[i];
+    }
+    return -1.0;
+  }
+
+ private:
+  void Record(std::chrono::steady_clock::time_point begin, float RMSError) {
+    const auto end = std::chrono::steady_clock::now();
+    const std::chrono::duration<double> elapsed = begin - mStart;
+    mSeconds.push_back(elapsed.count() - mErrorSeconds);
+    mErrorSeconds += std::chrono::duration<double>(end - begin).count();
+    mErrors.push_back(RMSError * 255.0f);
+  }
+
+  RMSErrorCalculator& mErrorCalculator;
+  std::chrono::steady_clock::time_point mStart;
+  double mErrorSeconds = 0.0;
+  std::vector<float> mErrors;
+  std::vector<double> mSeconds;
+};
 
 int main(int argc, char* argv[]) {
   if (argc < 2) {
@@ -26,18 +111,19 @@ int main(int argc, char* argv[]) {
   }
 
   std::string fname{argv[1]};
-  const auto pos = fname.find(fileExtension);
-  if (pos == std::string::npos) {
-    printf("Expected %s to end with %s\n", fname.c_str(), fileExtension);
+  const std::string fileExtension = getImageExtension(fname);
+  if (fileExtension.empty()) {
+    printf("Expected %s to end with .bmp, .pfm, .pgm or .ppm\n",
+           fname.c_str());
     return EXIT_SUCCESS;
   }
-  const auto prefix = fname.substr(0, pos);
+  const auto prefix = fname.substr(0, fname.size() - fileExtension.size());
 
   int width = 0, height = 0;
   std::vector<float> fImg[3];
 
   printf("Load Image: %s\n", fname.c_str());
-  readBMPchannels(fname, fImg[0], fImg[1], fImg[2], width, height);
+  readImageChannels(fname, fImg[0], fImg[1], fImg[2], width, height);
   int blurwidth = width, blurheight = height;
 
   if (fImg[0].empty()) {
@@ -86,7 +172,7 @@ int main(int argc, char* argv[]) {
   ///////////////////////////////////
   generateMotionBlurredImage(fImg, inputWeight, outputWeight, width, height,
                              blurwidth, blurheight, prefix, blurGenerator,
-                             errorCalculator, bImg);
+                             errorCalculator, bImg, fileExtension);
 
   // Add noise
   const float sigma = 2.0f;
@@ -94,7 +180,7 @@ int main(int argc, char* argv[]) {
       prefix + "_blur_noise_sigma" + std::to_string(sigma) + "_";
   GaussianNoiseGenerator noiseGenerator(sigma);
   addNoiseToImage(bImg, width, height, blurwidth, blurheight, noisePrefix,
-                  noiseGenerator, errorCalculator);
+                  noiseGenerator, errorCalculator, fileExtension);
 
   ///////////////////////////////////
   EmptyRegularizer emptyRegularizer;
@@ -131,8 +217,8 @@ int main(int argc, char* argv[]) {
           //   iteration, RMSError * 255.0f);
           fname = prefix + "_deblurBasic_pitr" + std::to_string(iteration) +
                   "_" + std::to_string(RMSError * 255.0f) + fileExtension;
-          writeBMPchannels(fname, width, height, deblurImg[0], deblurImg[1],
-                           deblurImg[2]);
+          writeImageChannels(fname, width, height, deblurImg[0], deblurImg[1],
+                             deblurImg[2]);
         }
       }
     }
@@ -156,9 +242,80 @@ int main(int argc, char* argv[]) {
           //   RMSError * 255.0f);
           fname = prefix + "_deblurBasic_gitr" + std::to_string(iteration) +
                   "_" + std::to_string(RMSError * 255.0f) + fileExtension;
-          writeBMPchannels(fname, width, height, deblurImg[0], deblurImg[1],
-                           deblurImg[2]);
+          writeImageChannels(fname, width, height, deblurImg[0], deblurImg[1],
+                             deblurImg[2]);
+        }
+      }
+    }
+
+    // The accelerated iterations keep their state within one call, the
+    // recorder writes the error of every iteration
+    for (const bool bPoisson : {true, false}) {
+      printf("Testing for Convergence of the Accelerated Algorithm\n");
+      ImChoppingGray(bImg[0].data(), blurwidth, blurheight,
+                     deblurImg[0].data(), width, height);
+      ImChoppingGray(bImg[1].data(), blurwidth, blurheight,
+                     deblurImg[1].data(), width, height);
+      ImChoppingGray(bImg[2].data(), blurwidth, blurheight,
+                     deblurImg[2].data(), width, height);
+
+      const std::string noiseModel = bPoisson ? "Poisson" : "Gaussian";
+      fname = "ConvergenceAccelerated" + noiseModel + prefix + ".txt";
+      std::fstream fp(fname, std::fstream::out);
+      RMSErrorRecorder errorRecorder{errorCalculator, fp};
+      RLDeblurrer rLDeblurrerAccelerated{blurGenerator, errorRecorder};
+      DeblurParameters rLParams{
+          .Niter = 5000, .bPoisson = bPoisson, .bAccelerated = true};
+      rLDeblurrerAccelerated.deblurRgb(
+          bImg[0].data(), bImg[1].data(), bImg[2].data(), blurwidth,
+          blurheight, deblurImg[0].data(), deblurImg[1].data(),
+          deblurImg[2].data(), width, height, rLParams, emptyRegularizer, 0.0);
+      RMSError = errorCalculator.calculateErrorRgb(
+          deblurImg[0].data(), deblurImg[1].data(), deblurImg[2].data(), width,
+          height);
+      fname = prefix + "_deblurAccelerated" + noiseModel + "_" +
+              std::to_string(RMSError * 255.0f) + fileExtension;
+      writeImageChannels(fname, width, height, deblurImg[0], deblurImg[1],
+                         deblurImg[2]);
+    }
+
+    // Time until the accelerated iterations reach the final error of the
+    // plain ones, within 1%
+    printf("Testing for Time to Target RMS\n");
+    fname = "TimeToTarget" + prefix + ".txt";
+    {
+      constexpr int kIterations = 200;
+      std::fstream fp(fname, std::fstream::out);
+      RMSTimeRecorder timeRecorder{errorCalculator};
+      RLDeblurrer rLDeblurrerTimed{blurGenerator, timeRecorder};
+      float targetRMS = NAN;
+      for (const bool bAccelerated : {false, true}) {
+        ImChoppingGray(bImg[0].data(), blurwidth, blurheight,
+                       deblurImg[0].data(), width, height);
+        ImChoppingGray(bImg[1].data(), blurwidth, blurheight,
+                       deblurImg[1].data(), width, height);
+        ImChoppingGray(bImg[2].data(), blurwidth, blurheight,
+                       deblurImg[2].data(), width, height);
+
+        DeblurParameters rLParams{.Niter = kIterations,
+                                  .bPoisson = true,
+                                  .bAccelerated = bAccelerated};
+        timeRecorder.Start();
+        rLDeblurrerTimed.deblurRgb(
+            bImg[0].data(), bImg[1].data(), bImg[2].data(), blurwidth,
+            blurheight, deblurImg[0].data(), deblurImg[1].data(),
+            deblurImg[2].data(), width, height, rLParams, emptyRegularizer,
+            0.0);
+        if (!bAccelerated) {
+          targetRMS = timeRecorder.GetFinalError() * 1.01f;
         }
+        const double seconds = timeRecorder.GetTimeToTarget(targetRMS);
+        printf("Accelerated %d: RMS %f after %f s, target %f after %f s\n",
+               bAccelerated, timeRecorder.GetFinalError(),
+               timeRecorder.GetSeconds(), targetRMS, seconds);
+        fp << bAccelerated << ' ' << std::setprecision(12)
+           << timeRecorder.GetFinalError() << ' ' << timeRecorder.GetSeconds()
+           << ' ' << seconds << '\n';
       }
     }
   }
@@ -0,0 +1,476 @@
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "BicubicInterpolation.h"
+#include "BilateralLaplacianRegularizer.hpp"
+#include "BilateralRegularizer.hpp"
+#include "BilinearSampler.h"
+#include "DeblurParameters.hpp"
+#include "EmptyRegularizer.hpp"
+#include "Image.hpp"
+#include "IErrorCalculator.hpp"
+#include "KernelRegularizer.hpp"
+#include "LaplacianRegularizer.hpp"
+#include "MotionBlurImageGenerator.hpp"
+#include "MotionBlurMaker.hpp"
+#include "RLDeblurrer.hpp"
+#include "TVRegularizer.hpp"
+#include "ThreadPool.hpp"
+#include "WarpMap.hpp"
+#include "warping.h"
+
+// Microbenchmarks of the deblurring kernels. The images are square, the
+// first argument is their side. Throughput is reported in output pixels
+// per second.
+
+namespace {
+
+constexpr int kThreads = 4;
+
+std::vector<float> makeImage(int width, int height, unsigned seed) {
+  std::mt19937 generator(seed);
+  std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+  std::vector<float> img(width * height);
+  for (auto& value : img) {
+    value = distribution(generator);
+  }
+  return img;
+}
+
+// The error of the iterations is not computed
+class NoErrorCalculator : public IErrorCalculator {
+ public:
+  float calculateErrorGray(float*, int, int) override { return 0.0f; }
+  float calculateErrorRgb(float*, float*, float*, int, int) override {
+    return 0.0f;
+  }
+};
+
+// The cameraman convergence example of setBlur
+void setBlur(MotionBlurImageGenerator& blurGenerator) {
+  blurGenerator.SetGlobalParameters(-10, 1.1f, 0.0004f, 0.0002f, 20, -15);
+}
+
+void setPixelsProcessed(benchmark::State& state, int64_t pixels) {
+  state.SetItemsProcessed(state.iterations() * pixels);
+  state.counters["pixels/s"] = benchmark::Counter(
+      static_cast<double>(state.iterations() * pixels),
+      benchmark::Counter::kIsRate);
+}
+
+void SizeArgs(benchmark::internal::Benchmark* bench) {
+  bench->ArgName("size")->Arg(256)->Arg(512)->Arg(1024)->Arg(2048);
+}
+
+// Wall time, the work of the pool threads is not in the CPU time
+void SizeThreadArgs(benchmark::internal::Benchmark* bench) {
+  bench->ArgNames({"size", "threads"})
+      ->ArgsProduct({{256, 512, 1024, 2048}, {1, kThreads}})
+      ->UseRealTime();
+}
+
+////////////////////////////////////
+// Warping
+////////////////////////////////////
+void BM_WarpImageGray(benchmark::State& state) {
+  const int size = static_cast<int>(state.range(0));
+  const int threads = static_cast<int>(state.range(1));
+  MotionBlurImageGenerator blurGenerator;
+  setBlur(blurGenerator);
+  ThreadPool threadPool(threads);
+
+  auto img = makeImage(size, size, 1);
+  std::vector<float> warpImg(size * size);
+  std::vector<float> warpWeight(size * size);
+
+  for (auto _ : state) {
+    if (threads > 1) {
+      warpImageGray(img.data(), nullptr, size, size, warpImg.data(),
+                    warpWeight.data(), size, size,
+                    blurGenerator.IHmatrix[15], threadPool);
+    } else {
+      warpImageGray(img.data(), nullptr, size, size, warpImg.data(),
+                    warpWeight.data(), size, size,
+                    blurGenerator.IHmatrix[15]);
+    }
+    benchmark::DoNotOptimize(warpImg.data());
+  }
+  setPixelsProcessed(state, int64_t{size} * size);
+}
+BENCHMARK(BM_WarpImageGray)->Apply(SizeThreadArgs);
+
+void BM_WarpImageRgb(benchmark::State& state) {
+  const int size = static_cast<int>(state.range(0));
+  const int threads = static_cast<int>(state.range(1));
+  MotionBlurImageGenerator blurGenerator;
+  setBlur(blurGenerator);
+  ThreadPool threadPool(threads);
+
+  auto imgR = makeImage(size, size, 1);
+  auto imgG = makeImage(size, size, 2);
+  auto imgB = makeImage(size, size, 3);
+  std::vector<float> warpImgR(size * size);
+  std::vector<float> warpImgG(size * size);
+  std::vector<float> warpImgB(size * size);
+  std::vector<float> warpWeight(size * size);
+
+  for (auto _ : state) {
+    if (threads > 1) {
+      warpImageRgb(imgR.data(), imgG.data(), imgB.data(), nullptr, size, size,
+                   warpImgR.data(), warpImgG.data(), warpImgB.data(),
+                   warpWeight.data(), size, size, blurGenerator.IHmatrix[15],
+                   threadPool);
+    } else {
+      warpImageRgb(imgR.data(), imgG.data(), imgB.data(), nullptr, size, size,
+                   warpImgR.data(), warpImgG.data(), warpImgB.data(),
+                   warpWeight.data(), size, size, blurGenerator.IHmatrix[15]);
+    }
+    benchmark::DoNotOptimize(warpImgR.data());
+  }
+  setPixelsProcessed(state, int64_t{size} * size);
+}
+BENCHMARK(BM_WarpImageRgb)->Apply(SizeThreadArgs);
+
+////////////////////////////////////
+// Sampling
+////////////////////////////////////
+// Per pixel bilinear sampling at the positions given by the homography, the
+// centered coordinates, weight and clamp of the per pixel warpImageGray
+void BM_ReturnInterpolatedValueFast(benchmark::State& state) {
+  const int size = static_cast<int>(state.range(0));
+  MotionBlurImageGenerator blurGenerator;
+  setBlur(blurGenerator);
+  const Homography& homography = blurGenerator.IHmatrix[15];
+  const float offset = size * 0.5f;
+
+  auto img = makeImage(size, size, 1);
+  std::vector<float> warpImg(size * size);
+  std::vector<float> warpWeight(size * size);
+
+  for (auto _ : state) {
+    for (int y = 0, index = 0; y < size; y++) {
+      for (int x = 0; x < size; x++, index++) {
+        float fx = x - offset, fy = y - offset;
+        homography.Transform(fx, fy);
+        fx += offset;
+        fy += offset;
+
+        if (fx >= 0 && fx < size - 1 && fy >= 0 && fy < size - 1) {
+          warpWeight[index] = 1.01f;
+        } else {
+          warpWeight[index] = 0.01f;
+        }
+
+        if (fx < 0) fx = 0;
+        if (fy < 0) fy = 0;
+        if (fx >= size - 1.001f) fx = size - 1.001f;
+        if (fy >= size - 1.001f) fy = size - 1.001f;
+
+        warpImg[index] =
+            ReturnInterpolatedValueFast(fx, fy, img.data(), size, size);
+      }
+    }
+    benchmark::DoNotOptimize(warpImg.data());
+    benchmark::DoNotOptimize(warpWeight.data());
+  }
+  setPixelsProcessed(state, int64_t{size} * size);
+}
+BENCHMARK(BM_ReturnInterpolatedValueFast)->Apply(SizeArgs);
+
+// The same sampling with the row sampler, registered in main for every
+// kernel supported by the CPU
+void BM_SampleRowGray(benchmark::State& state, SamplerIsa isa) {
+  const int size = static_cast<int>(state.range(0));
+  const SamplerIsa defaultIsa = getSamplerIsa();
+  setSamplerIsa(isa);
+
+  MotionBlurImageGenerator blurGenerator;
+  setBlur(blurGenerator);
+  auto img = makeImage(size, size, 1);
+  std::vector<float> warpImg(size * size);
+  std::vector<float> warpWeight(size * size);
+
+  for (auto _ : state) {
+    for (int y = 0; y < size; y++) {
+      sampleRowGray(img.data(), nullptr, size, size, warpImg.data(),
+                    warpWeight.data(), size, size, blurGenerator.IHmatrix[15],
+                    y, 0, size);
+    }
+    benchmark::DoNotOptimize(warpImg.data());
+  }
+  setPixelsProcessed(state, int64_t{size} * size);
+  setSamplerIsa(defaultIsa);
+}
+
+void RegisterSamplerBenchmarks() {
+  for (const SamplerIsa isa : {SamplerIsa::Scalar, SamplerIsa::Sse41,
+                               SamplerIsa::Avx2, SamplerIsa::Avx512,
+                               SamplerIsa::Neon}) {
+    if (!isSamplerIsaSupported(isa)) continue;
+    const std::string name =
+        std::string("BM_SampleRowGray/") + getSamplerIsaName(isa);
+    benchmark::RegisterBenchmark(name.c_str(), BM_SampleRowGray, isa)
+        ->Apply(SizeArgs);
+  }
+}
+
+////////////////////////////////////
+// Motion blur
+////////////////////////////////////
+void BM_BlurGray(benchmark::State& state, bool bforward) {
+  const int size = static_cast<int>(state.range(0));
+  const int threads = static_cast<int>(state.range(1));
+  MotionBlurImageGenerator blurGenerator;
+  setBlur(blurGenerator);
+  blurGenerator.SetNumThreads(threads);
+  blurGenerator.SetBuffer(size, size, 1);
+
+  auto img = makeImage(size, size, 1);
+  std::vector<float> blurImg(size * size);
+  std::vector<float> blurWeight(size * size);
+
+  for (auto _ : state) {
+    blurGenerator.blurGray(img.data(), nullptr, size, size, blurImg.data(),
+                           blurWeight.data(), size, size, bforward);
+    benchmark::DoNotOptimize(blurImg.data());
+  }
+  setPixelsProcessed(state, int64_t{size} * size);
+}
+BENCHMARK_CAPTURE(BM_BlurGray, Forward, true)->Apply(SizeThreadArgs);
+BENCHMARK_CAPTURE(BM_BlurGray, Backward, false)->Apply(SizeThreadArgs);
+
+// Blur from a warp map built before the timing, maps are only used with the
+// scalar kernel
+void BM_BlurGrayWarpMap(benchmark::State& state) {
+  const int size = static_cast<int>(state.range(0));
+  const int threads = static_cast<int>(state.range(1));
+  const SamplerIsa defaultIsa = getSamplerIsa();
+  setSamplerIsa(SamplerIsa::Scalar);
+
+  MotionBlurImageGenerator blurGenerator;
+  setBlur(blurGenerator);
+  blurGenerator.SetNumThreads(threads);
+  blurGenerator.SetWarpMapBudget(
+      WarpMap::GetBytes(blurGenerator.GetNumSamples(), size, size));
+
+  auto img = makeImage(size, size, 1);
+  std::vector<float> blurImg(size * size);
+  std::vector<float> blurWeight(size * size);
+  blurGenerator.blurGray(img.data(), nullptr, size, size, blurImg.data(),
+                         blurWeight.data(), size, size, true);
+
+  for (auto _ : state) {
+    blurGenerator.blurGray(img.data(), nullptr, size, size, blurImg.data(),
+                           blurWeight.data(), size, size, true);
+    benchmark::DoNotOptimize(blurImg.data());
+  }
+  setPixelsProcessed(state, int64_t{size} * size);
+  setSamplerIsa(defaultIsa);
+}
+BENCHMARK(BM_BlurGrayWarpMap)->Apply(SizeThreadArgs);
+
+// Blur by the sparse operator assembled before the timing, the backward
+// blur is its adjoint
+void BM_BlurGraySparse(benchmark::State& state, bool bforward) {
+  const int size = static_cast<int>(state.range(0));
+  const int threads = static_cast<int>(state.range(1));
+  MotionBlurImageGenerator blurGenerator;
+  setBlur(blurGenerator);
+  blurGenerator.SetNumThreads(threads);
+  blurGenerator.SetSparseOperator(true);
+
+  auto img = makeImage(size, size, 1);
+  std::vector<float> blurImg(size * size);
+  std::vector<float> blurWeight(size * size);
+  blurGenerator.blurGray(img.data(), nullptr, size, size, blurImg.data(),
+                         blurWeight.data(), size, size, bforward);
+
+  for (auto _ : state) {
+    blurGenerator.blurGray(img.data(), nullptr, size, size, blurImg.data(),
+                           blurWeight.data(), size, size, bforward);
+    benchmark::DoNotOptimize(blurImg.data());
+  }
+  setPixelsProcessed(state, int64_t{size} * size);
+}
+BENCHMARK_CAPTURE(BM_BlurGraySparse, Forward, true)->Apply(SizeThreadArgs);
+BENCHMARK_CAPTURE(BM_BlurGraySparse, Backward, false)->Apply(SizeThreadArgs);
+
+// Blur of the setBlur presets with their 30 samples, or with the samples
+// spaced by at most half a pixel. The samples are reported as a counter.
+void BM_BlurGrayPreset(benchmark::State& state) {
+  constexpr int kSize = 512;
+  const int blurType = static_cast<int>(state.range(0));
+  const bool bAdaptive = state.range(1) != 0;
+  MotionBlurImageGenerator blurGenerator;
+  ::setBlur(blurType, blurGenerator);
+  if (bAdaptive) {
+    blurGenerator.SetAdaptiveNumSamples(kSize, kSize);
+  }
+
+  auto img = makeImage(kSize, kSize, 1);
+  std::vector<float> blurImg(kSize * kSize);
+  std::vector<float> blurWeight(kSize * kSize);
+
+  for (auto _ : state) {
+    blurGenerator.blurGray(img.data(), nullptr, kSize, kSize, blurImg.data(),
+                           blurWeight.data(), kSize, kSize, true);
+    benchmark::DoNotOptimize(blurImg.data());
+  }
+  setPixelsProcessed(state, int64_t{kSize} * kSize);
+  state.counters["samples"] = blurGenerator.GetNumSamples();
+  state.counters["spacing"] = blurGenerator.GetSampleSpacing(kSize, kSize);
+}
+BENCHMARK(BM_BlurGrayPreset)
+    ->ArgNames({"blur", "adaptive"})
+    ->ArgsProduct({{0, 1, 2, 3, 4, 5, 6}, {0, 1}});
+
+////////////////////////////////////
+// Regularization
+////////////////////////////////////
+template <typename Regularizer>
+void BM_Regularizer(benchmark::State& state) {
+  const int size = static_cast<int>(state.range(0));
+  Regularizer regularizer;
+  auto img = makeImage(size, size, 1);
+
+  for (auto _ : state) {
+    regularizer.applyRegularizationGray(img.data(), size, size, true, 0.001f);
+    benchmark::DoNotOptimize(img.data());
+  }
+  setPixelsProcessed(state, int64_t{size} * size);
+}
+BENCHMARK_TEMPLATE(BM_Regularizer, TVRegularizer)->Apply(SizeArgs);
+BENCHMARK_TEMPLATE(BM_Regularizer, LaplacianRegularizer)->Apply(SizeArgs);
+BENCHMARK_TEMPLATE(BM_Regularizer, BilateralRegularizer)->Apply(SizeArgs);
+BENCHMARK_TEMPLATE(BM_Regularizer, BilateralLaplacianRegularizer)
+    ->Apply(SizeArgs);
+BENCHMARK_TEMPLATE(BM_Regularizer, KernelRegularizer)->Apply(SizeArgs);
+
+////////////////////////////////////
+// Deblurring
+////////////////////////////////////
+// One RL iteration: forward blur, ratio, backward blur and update
+void BM_RLIterationGray(benchmark::State& state) {
+  const int size = static_cast<int>(state.range(0));
+  const int threads = static_cast<int>(state.range(1));
+  MotionBlurImageGenerator blurGenerator;
+  setBlur(blurGenerator);
+  blurGenerator.SetNumThreads(threads);
+  NoErrorCalculator errorCalculator;
+  EmptyRegularizer regularizer;
+  RLDeblurrer rLDeblurrer{blurGenerator, errorCalculator};
+
+  auto img = makeImage(size, size, 1);
+  std::vector<float> blurImg(size * size);
+  std::vector<float> blurWeight(size * size);
+  blurGenerator.blurGray(img.data(), nullptr, size, size, blurImg.data(),
+                         blurWeight.data(), size, size, true);
+  std::vector<float> deblurImg = blurImg;
+
+  const DeblurParameters rLParams{.Niter = 1, .bPoisson = true};
+  for (auto _ : state) {
+    rLDeblurrer.deblurGray(blurImg.data(), size, size, deblurImg.data(), size,
+                           size, rLParams, regularizer, 0.0f);
+    benchmark::DoNotOptimize(deblurImg.data());
+  }
+  setPixelsProcessed(state, int64_t{size} * size);
+}
+BENCHMARK(BM_RLIterationGray)->Apply(SizeThreadArgs);
+
+void BM_RLIterationRgb(benchmark::State& state) {
+  const int size = static_cast<int>(state.range(0));
+  const int threads = static_cast<int>(state.range(1));
+  MotionBlurImageGenerator blurGenerator;
+  setBlur(blurGenerator);
+  blurGenerator.SetNumThreads(threads);
+  NoErrorCalculator errorCalculator;
+  EmptyRegularizer regularizer;
+  RLDeblurrer rLDeblurrer{blurGenerator, errorCalculator};
+
+  auto imgR = makeImage(size, size, 1);
+  auto imgG = makeImage(size, size, 2);
+  auto imgB = makeImage(size, size, 3);
+  std::vector<float> blurImgR(size * size);
+  std::vector<float> blurImgG(size * size);
+  std::vector<float> blurImgB(size * size);
+  std::vector<float> blurWeight(size * size);
+  blurGenerator.blurRgb(imgR.data(), imgG.data(), imgB.data(), nullptr, size,
+                        size, blurImgR.data(), blurImgG.data(),
+                        blurImgB.data(), blurWeight.data(), size, size, true);
+  std::vector<float> deblurImgR = blurImgR;
+  std::vector<float> deblurImgG = blurImgG;
+  std::vector<float> deblurImgB = blurImgB;
+
+  const DeblurParameters rLParams{.Niter = 1, .bPoisson = true};
+  for (auto _ : state) {
+    rLDeblurrer.deblurRgb(blurImgR.data(), blurImgG.data(), blurImgB.data(),
+                          size, size, deblurImgR.data(), deblurImgG.data(),
+                          deblurImgB.data(), size, size, rLParams, regularizer,
+                          0.0f);
+    benchmark::DoNotOptimize(deblurImgR.data());
+  }
+  setPixelsProcessed(state, int64_t{size} * size);
+}
+BENCHMARK(BM_RLIterationRgb)->Apply(SizeThreadArgs);
+
+// A burst of kBatchImages gray images sharing the motion, with the images
+// distributed on the threads. Throughput is reported in images per second.
+constexpr int kBatchImages = 8;
+
+void BM_DeblurBatchGray(benchmark::State& state) {
+  const int size = static_cast<int>(state.range(0));
+  const int threads = static_cast<int>(state.range(1));
+  MotionBlurImageGenerator blurGenerator;
+  setBlur(blurGenerator);
+  NoErrorCalculator errorCalculator;
+  RLDeblurrer rLDeblurrer{blurGenerator, errorCalculator};
+
+  std::vector<std::vector<float>> blurImgs, deblurImgs;
+  std::vector<float> blurWeight(size * size);
+  for (int i = 0; i < kBatchImages; i++) {
+    auto img = makeImage(size, size, i + 1);
+    blurImgs.emplace_back(size * size);
+    blurGenerator.blurGray(img.data(), nullptr, size, size,
+                           blurImgs.back().data(), blurWeight.data(), size,
+                           size, true);
+    deblurImgs.push_back(blurImgs.back());
+  }
+
+  std::vector<DeblurBatchImage> images;
+  for (int i = 0; i < kBatchImages; i++) {
+    images.push_back({Image<const float>(blurImgs[i].data(), size, size),
+                      Image<float>(deblurImgs[i].data(), size, size)});
+  }
+
+  const DeblurParameters rLParams{.Niter = 1, .bPoisson = true};
+  const RegularizerFactory makeRegularizer = [] {
+    return std::make_unique<TVRegularizer>();
+  };
+  for (auto _ : state) {
+    rLDeblurrer.deblurBatch(images, rLParams, makeRegularizer, 0.5f, threads);
+    benchmark::DoNotOptimize(deblurImgs.data());
+  }
+  state.counters["images/s"] = benchmark::Counter(
+      static_cast<double>(state.iterations() * kBatchImages),
+      benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_DeblurBatchGray)->Apply(SizeThreadArgs);
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  RegisterSamplerBenchmarks();
+
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return EXIT_FAILURE;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return EXIT_SUCCESS;
+}
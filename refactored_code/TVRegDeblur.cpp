@@ -11,35 +11,35 @@
 #include "EmptyRegularizer.hpp"
 #include "GaussianNoiseGenerator.hpp"
 #include "ImResize.h"
+#include "ImageIO.hpp"
 #include "MotionBlurImageGenerator.hpp"
 #include "MotionBlurMaker.hpp"
 #include "ProjectiveMotionRLMultiScaleGray.hpp"
 #include "RLDeblurrer.hpp"
 #include "RMSErrorCalculator.hpp"
 #include "TVRegularizer.hpp"
-#include "bitmap.h"
-
-constexpr auto fileExtension = ".bmp";
 
 int main(int argc, char* argv[]) {
   if (argc < 2) {
-    printf("Usage: %s image_filename [blur_type]\n", argv[0]);
+    printf("Usage: %s image_filename [blur_type] [checkpoint_file]\n",
+           argv[0]);
     return EXIT_SUCCESS;
   }
 
   std::string fname{argv[1]};
-  const auto pos = fname.find(fileExtension);
-  if (pos == std::string::npos) {
-    printf("Expected %s to end with %s\n", fname.c_str(), fileExtension);
+  const std::string fileExtension = getImageExtension(fname);
+  if (fileExtension.empty()) {
+    printf("Expected %s to end with .bmp, .pfm, .pgm or .ppm\n",
+           fname.c_str());
     return EXIT_SUCCESS;
   }
-  const auto prefix = fname.substr(0, pos);
+  const auto prefix = fname.substr(0, fname.size() - fileExtension.size());
 
   int width = 0, height = 0;
   std::vector<float> fImg[3];
 
   printf("Load Image: %s\n", fname.c_str());
-  readBMPchannels(fname, fImg[0], fImg[1], fImg[2], width, height);
+  readImageChannels(fname, fImg[0], fImg[1], fImg[2], width, height);
   int blurwidth = width, blurheight = height;
 
   if (fImg[0].empty()) {
@@ -88,7 +88,7 @@ int main(int argc, char* argv[]) {
   ///////////////////////////////////
   generateMotionBlurredImage(fImg, inputWeight, outputWeight, width, height,
                              blurwidth, blurheight, prefix, blurGenerator,
-                             errorCalculator, bImg);
+                             errorCalculator, bImg, fileExtension);
 
   // Add noise
   const float sigma = 2.0f;
@@ -96,7 +96,7 @@ int main(int argc, char* argv[]) {
       prefix + "_blur_noise_sigma" + std::to_string(sigma) + "_";
   GaussianNoiseGenerator noiseGenerator(sigma);
   addNoiseToImage(bImg, width, height, blurwidth, blurheight, noisePrefix,
-                  noiseGenerator, errorCalculator);
+                  noiseGenerator, errorCalculator, fileExtension);
 
   ///////////////////////////////////
   EmptyRegularizer emptyRegularizer;
@@ -115,6 +115,12 @@ int main(int argc, char* argv[]) {
     TVRegularizer tvRegularizer;
     DeblurParameters tvRLParams{.Niter = 100, .bPoisson = true};
     RLDeblurrer rLDeblurrerTVReg{blurGenerator, emptyErrorCalculator};
+    // A preempted run resumes from the checkpoint, every call of the
+    // deblurrer is checkpointed
+    if (argc > 3) {
+      printf("Checkpoint: %s\n", argv[3]);
+      rLDeblurrerTVReg.SetCheckpoint(argv[3], 10);
+    }
 
     // Gradually decrease the regularization weight, otherwise, the result will
     // be over smooth. Actually, the following regularization produce similar
@@ -153,8 +159,9 @@ int main(int argc, char* argv[]) {
     fname = prefix + "_deblurTVReg_" + std::to_string(RMSError * 255.0f) +
             fileExtension;
     printf("Done, RMS Error: %f\n", RMSError * 255.0f);
-    writeBMPchannels(fname, width, height, deblurImg[0], deblurImg[1],
-                     deblurImg[2]);
+    writeImageChannels(fname, width, height, deblurImg[0], deblurImg[1],
+                       deblurImg[2]);
+    rLDeblurrerTVReg.RemoveCheckpoint();
   }
 
   return EXIT_SUCCESS;
@@ -0,0 +1,76 @@
+#include <charconv>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include "DeblurParameters.hpp"
+#include "EmptyRegularizer.hpp"
+#include "ImageIO.hpp"
+#include "MotionBlurImageGenerator.hpp"
+#include "MotionBlurMaker.hpp"
+#include "TiledDeblurrer.hpp"
+
+// Deblurs an image that is already blurred by one of the motions of
+// setBlur, tile by tile, without loading it into memory
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    printf("Usage: %s blurred_image_filename [blur_type] [tile_size]\n",
+           argv[0]);
+    return EXIT_SUCCESS;
+  }
+
+  std::string fname{argv[1]};
+  const std::string fileExtension = getImageExtension(fname);
+  if (fileExtension.empty()) {
+    printf("Expected %s to end with .bmp, .pfm, .pgm or .ppm\n",
+           fname.c_str());
+    return EXIT_SUCCESS;
+  }
+  const auto prefix = fname.substr(0, fname.size() - fileExtension.size());
+
+  int args[2] = {0, 512};
+  for (int i = 2; i < argc && i < 4; i++) {
+    const std::string arg{argv[i]};
+    const auto convResult =
+        std::from_chars(arg.data(), arg.data() + arg.size(), args[i - 2]);
+    if (convResult.ec != std::errc()) {
+      printf("Error convering %s to int\n", arg.c_str());
+      return EXIT_SUCCESS;
+    }
+  }
+
+  MotionBlurImageGenerator blurGenerator;
+  if (!setBlur(args[0], blurGenerator)) {
+    return EXIT_SUCCESS;
+  }
+
+  try {
+    const auto blurFile = openImageFile(fname);
+    const int width = blurFile->GetWidth();
+    const int height = blurFile->GetHeight();
+    const std::string deblurName = prefix + "_deblurTiled" + fileExtension;
+    const auto deblurFile =
+        createImageFile(deblurName, width, height, blurFile->GetChannels());
+
+    TiledDeblurrer tiledDeblurrer(blurGenerator);
+    tiledDeblurrer.SetTileSize(args[1]);
+    printf("Image %dx%d, tiles of %d with a halo of %d\n", width, height,
+           args[1], tiledDeblurrer.GetHalo(width, height));
+
+    DeblurParameters rLParams{.Niter = 100,
+                              .bPoisson = true,
+                              .relativeChangeThreshold = 1e-3f};
+    const DeblurResult result = tiledDeblurrer.deblur(
+        *blurFile, *deblurFile, rLParams,
+        [] { return std::make_unique<EmptyRegularizer>(); }, 0.0f);
+    printf("Longest tile stopped after %d iterations on %s\n",
+           result.iterations, toString(result.reason));
+    printf("Peak scratch memory: %.1f MB\n",
+           result.peakBufferBytes / (1024.0 * 1024.0));
+    printf("Done: %s\n", deblurName.c_str());
+  } catch (const std::exception& error) {
+    printf("%s\n", error.what());
+  }
+
+  return EXIT_SUCCESS;
+}
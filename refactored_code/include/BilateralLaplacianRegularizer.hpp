@@ -1,7 +1,6 @@
 #pragma once
 
-#include <vector>
-
+#include "BufferPool.hpp"
 #include "IRegularizer.hpp"
 
 class BilateralLaplacianRegularizer : public IRegularizer {
@@ -12,8 +11,10 @@ class BilateralLaplacianRegularizer : public IRegularizer {
   ////////////////////////////////////
   // These functions are used to set Buffer for caching
   ////////////////////////////////////
-  void SetBuffer(int width, int height);
+  // Only the buffers of the channel count, 1 or 3, are allocated
+  void SetBuffer(int width, int height, int channels);
   void ClearBuffer();
+  void SetBufferPool(BufferPool& aPool) override;
 
   ////////////////////////////////////
   // These functions are used to apply regularization
@@ -25,6 +26,10 @@ class BilateralLaplacianRegularizer : public IRegularizer {
                               float* DeblurImgB, int width, int height,
                               bool bPoisson, float lambda) override;
 
+  // The RGB regularization keeps the separate pass
+  bool computeRegularizationTermGray(float* DeblurImg, int width, int height,
+                                     const float*& TermImg) override;
+
  private:
   void SetBilateralTable();
 
@@ -37,8 +42,10 @@ class BilateralLaplacianRegularizer : public IRegularizer {
   void ComputeBilaterRegImageGray(float* Img, int width, int height,
                                   float* BRImg);
 
-  std::vector<float> mBilateralRegImg;
-  std::vector<float> mBilateralRegImgR;
-  std::vector<float> mBilateralRegImgG;
-  std::vector<float> mBilateralRegImgB;
+  BufferPool* mBufferPool = &BufferPool::GetDefault();
+
+  PoolBuffer mBilateralRegImg;
+  PoolBuffer mBilateralRegImgR;
+  PoolBuffer mBilateralRegImgG;
+  PoolBuffer mBilateralRegImgB;
 };
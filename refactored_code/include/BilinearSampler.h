@@ -0,0 +1,109 @@
+#pragma once
+
+#include "Homography.hpp"
+
+// Batch bilinear sampling of a projective warp.
+//
+// For the output pixels [xBegin, xEnd) of row y, the row samplers compute the
+// source position through homography, the output weight and the clamped
+// bilinear sample of every input plane, exactly like the per pixel code of
+// ReturnInterpolatedValueFast. Whole row segments are processed in vector
+// registers, the kernel is selected once at runtime from the instruction sets
+// supported by the CPU. AVX-512 has to be selected with setSamplerIsa.
+// The span of a segment whose positions are inside the input is found from
+// the homography and sampled without the bounds tests and clamps.
+
+enum class SamplerIsa { Scalar, Sse41, Avx2, Avx512, Neon };
+
+// Exact: two divides per pixel, the same result for every kernel.
+// Incremental: the numerators and the denominator of the homography are
+// stepped along the row with additions and one reciprocal per pixel, and
+// recomputed exactly every resyncPixels pixels to bound the float drift.
+// Homographies with a zero perspective row, as the translation, rotation and
+// scaling blurs, skip the reciprocal.
+enum class SamplerTransform { Exact, Incremental };
+
+constexpr int kDefaultResyncPixels = 64;
+
+void sampleRowGray(const float* InputImg, const float* inputWeight, int iwidth,
+                   int iheight, float* OutputImg, float* outputWeight,
+                   int width, int height, const Homography& homography, int y,
+                   int xBegin, int xEnd);
+
+void sampleRowRgb(const float* InputImgR, const float* InputImgG,
+                  const float* InputImgB, const float* inputWeight, int iwidth,
+                  int iheight, float* OutputImgR, float* OutputImgG,
+                  float* OutputImgB, float* outputWeight, int width,
+                  int height, const Homography& homography, int y, int xBegin,
+                  int xEnd);
+
+// Part of the input images copied to separate buffers. The input pixel
+// (x, y), in the coordinates of the iwidth x iheight image, is at
+// (y - y0) * stride + x - x0 of the window buffers.
+struct SamplerWindow {
+  int x0 = 0;
+  int y0 = 0;
+  int stride = 0;
+};
+
+// Same sampling, but value * weight is added to BlurImg and the weight to
+// outputWeight, so a blur can sum its samples without a warped image buffer.
+// With a window the inputs point to the window buffers, which must hold every
+// pixel read for the output segment.
+void accumulateRowGray(const float* InputImg, const float* inputWeight,
+                       int iwidth, int iheight, float* BlurImg,
+                       float* outputWeight, int width, int height,
+                       const Homography& homography, int y, int xBegin,
+                       int xEnd, const SamplerWindow* window = nullptr);
+
+void accumulateRowRgb(const float* InputImgR, const float* InputImgG,
+                      const float* InputImgB, const float* inputWeight,
+                      int iwidth, int iheight, float* BlurImgR,
+                      float* BlurImgG, float* BlurImgB, float* outputWeight,
+                      int width, int height, const Homography& homography,
+                      int y, int xBegin, int xEnd,
+                      const SamplerWindow* window = nullptr);
+
+// Precomputed sample of an output pixel: the input pixel index of the top
+// left tap of the clamped bilinear sample and the fractions of its position.
+// A negative index, ~index, marks a position outside the input, whose output
+// weight is the minimum one. Inside positions within 0.001 of the last column
+// or row are clamped for the value only, their fraction is then stored
+// negated and the weight is sampled at its absolute value.
+struct WarpTap {
+  int index;
+  float fx;
+  float fy;
+};
+
+// Taps of the output pixels [xBegin, xEnd) of row y, the positions of the
+// row samplers with the current transform
+void computeWarpTaps(int iwidth, int iheight, int width, int height,
+                     const Homography& homography, int y, int xBegin,
+                     int xEnd, WarpTap* taps);
+
+// accumulateRow* of count output pixels from their taps, the inputs are the
+// full images
+void accumulateTapsGray(const float* InputImg, const float* inputWeight,
+                        int iwidth, int iheight, const WarpTap* taps,
+                        float* BlurImg, float* outputWeight, int count);
+
+void accumulateTapsRgb(const float* InputImgR, const float* InputImgG,
+                       const float* InputImgB, const float* inputWeight,
+                       int iwidth, int iheight, const WarpTap* taps,
+                       float* BlurImgR, float* BlurImgG, float* BlurImgB,
+                       float* outputWeight, int count);
+
+// Kernel used by the row samplers
+SamplerIsa getSamplerIsa();
+const char* getSamplerIsaName(SamplerIsa isa);
+
+// Forces a kernel, returns false if the CPU does not support it
+bool setSamplerIsa(SamplerIsa isa);
+bool isSamplerIsaSupported(SamplerIsa isa);
+
+// resyncPixels is rounded up to a multiple of the widest vector (16)
+void setSamplerTransform(SamplerTransform transform,
+                         int resyncPixels = kDefaultResyncPixels);
+SamplerTransform getSamplerTransform();
+int getSamplerResyncPixels();
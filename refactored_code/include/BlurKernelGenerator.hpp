@@ -27,7 +27,7 @@ class BlurKernelGenerator : public IBlurImageGenerator {
                float* BlurImgG, float* BlurImgB, float* outputWeight, int width,
                int height, bool bforward) override;
 
-  void SetBuffer(int width, int height) override;
+  void SetBuffer(int width, int height, int channels) override;
   void ClearBuffer() override;
 
  private:
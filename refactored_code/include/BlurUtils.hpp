@@ -14,9 +14,11 @@ void generateMotionBlurredImage(std::vector<float> (&aInitialImage)[3],
                                 const std::string& aPrefix,
                                 IBlurImageGenerator& aBlurGenerator,
                                 IErrorCalculator& aErrorCalculator,
-                                std::vector<float> (&aBlurredImage)[3]);
+                                std::vector<float> (&aBlurredImage)[3],
+                                const std::string& aExtension = ".bmp");
 
 void addNoiseToImage(std::vector<float> (&bImg)[3], int width, int height,
                      int blurWidth, int blurHeight, const std::string& prefix,
                      INoiseGenerator& noiseGenerator,
-                     IErrorCalculator& errorCalculator);
\ No newline at end of file
+                     IErrorCalculator& errorCalculator,
+                     const std::string& extension = ".bmp");
\ No newline at end of file
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+// Pool of 64-byte aligned float frames shared by the deblurring components.
+// A released frame is kept and handed to the next acquire that fits in it,
+// so repeated deblurs of the same size do not go back to the allocator. The
+// deblurring calls trim the free frames when they return, so the pool does
+// not keep the sizes of earlier images.
+class BufferPool {
+ public:
+  BufferPool() = default;
+  ~BufferPool();
+
+  BufferPool(const BufferPool&) = delete;
+  BufferPool& operator=(const BufferPool&) = delete;
+
+  // Pool of the components that were not given another one
+  static BufferPool& GetDefault();
+
+  // Smallest free frame of at least size and at most twice size floats, or
+  // a new one. capacity receives its size.
+  float* Acquire(std::size_t size, std::size_t& capacity);
+  void Release(float* frame);
+
+  // Frees the frames that are not in use
+  void Trim();
+
+  ////////////////////////////////////
+  // These functions are used to report the memory of the frames
+  ////////////////////////////////////
+  std::size_t GetBytesInUse() const;
+  std::size_t GetPeakBytesInUse() const;
+  std::size_t GetBytesReserved() const;
+  // The peak restarts from the bytes in use
+  void ResetPeak();
+
+ private:
+  struct Frame {
+    float* data = nullptr;
+    std::size_t capacity = 0;
+    bool inUse = false;
+  };
+
+  mutable std::mutex mMutex;
+  std::vector<Frame> mFrames;
+  std::size_t mBytesInUse = 0;
+  std::size_t mPeakBytesInUse = 0;
+  std::size_t mBytesReserved = 0;
+};
+
+// Float buffer in a frame of a BufferPool, with the part of the
+// std::vector interface used by the components. The frame goes back to its
+// pool when the buffer is cleared, grows out of it or is destroyed.
+class PoolBuffer {
+ public:
+  PoolBuffer() = default;
+  ~PoolBuffer() { clear(); }
+
+  PoolBuffer(const PoolBuffer&) = delete;
+  PoolBuffer& operator=(const PoolBuffer&) = delete;
+  PoolBuffer(PoolBuffer&& other) noexcept;
+  PoolBuffer& operator=(PoolBuffer&& other) noexcept;
+
+  // Like std::vector::resize, the new values are zero
+  void resize(std::size_t size, BufferPool& pool);
+  void clear();
+
+  float* data() { return mData; }
+  const float* data() const { return mData; }
+  std::size_t size() const { return mSize; }
+  bool empty() const { return mSize == 0; }
+
+  float& operator[](std::size_t index) { return mData[index]; }
+  const float& operator[](std::size_t index) const { return mData[index]; }
+
+ private:
+  BufferPool* mPool = nullptr;
+  float* mData = nullptr;
+  std::size_t mSize = 0;
+  std::size_t mCapacity = 0;
+};
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <span>
+#include <string>
+
+// Iteration state of an RLDeblurrer, written with its planes to a binary
+// checkpoint: the estimate, then the previous estimate and last step of the
+// accelerated mode, planes of width * height floats
+struct DeblurCheckpointState {
+  // Deblurring call of the deblurrer and its completed iterations. A
+  // checkpoint of iteration 0 holds the result of the previous call.
+  int call = 0;
+  int iteration = 0;
+  int width = 0;
+  int height = 0;
+  int channels = 0;
+  int numPlanes = 0;
+  // Correlation of the last two steps of the accelerated mode
+  double stepDot = 0.0;
+  double stepNorm = 0.0;
+};
+
+// Reads the state of a checkpoint, false if fname does not exist. Throws
+// std::runtime_error if it is not a complete checkpoint.
+bool readCheckpointState(const std::string& fname,
+                         DeblurCheckpointState& state);
+// Reads the first planes.size() planes, at most state.numPlanes
+void readCheckpointPlanes(const std::string& fname,
+                          const DeblurCheckpointState& state,
+                          std::span<float* const> planes);
+// Writes state.numPlanes planes. The checkpoint replaces fname once it is
+// complete, a preempted write leaves the previous checkpoint.
+void writeCheckpoint(const std::string& fname,
+                     const DeblurCheckpointState& state,
+                     std::span<const float* const> planes);
@@ -1,6 +1,50 @@
 #pragma once
 
+#include <cstddef>
+
+// Why the iterations of a deblurring call stopped
+enum class DeblurStopReason {
+  Iterations,
+  RelativeChange,
+  Residual,
+  TimeBudget
+};
+
+inline const char* toString(DeblurStopReason aReason) {
+  switch (aReason) {
+    case DeblurStopReason::RelativeChange:
+      return "relative change";
+    case DeblurStopReason::Residual:
+      return "residual";
+    case DeblurStopReason::TimeBudget:
+      return "time budget";
+    default:
+      return "iterations";
+  }
+}
+
 struct DeblurParameters {
   int Niter = 20;
   bool bPoisson = true;
-};
\ No newline at end of file
+  // Biggs-Andrews accelerated iterations, each iteration starts from an
+  // extrapolation of the last two estimates
+  bool bAccelerated = false;
+
+  // Early termination, Niter stays the maximum number of iterations.
+  // A value <= 0 disables the criterion.
+  // Stop when ||x_k - x_k-1|| / ||x_k|| of the deblurred image is below
+  float relativeChangeThreshold = 0.0f;
+  // Stop when the RMS of observed - blurred estimate is below
+  float residualThreshold = 0.0f;
+  // Stop when the iterations took longer than this in seconds
+  double maxSeconds = 0.0;
+};
+
+struct DeblurResult {
+  int iterations = 0;
+  DeblurStopReason reason = DeblurStopReason::Iterations;
+  // Peak of the bytes in use in the buffer pool of the deblurrer during the
+  // call. The regularizer and blur generator buffers are included when they
+  // share that pool, as they do by default.
+  std::size_t peakBufferBytes = 0;
+};
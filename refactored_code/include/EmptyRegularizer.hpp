@@ -15,4 +15,13 @@ class EmptyRegularizer : public IRegularizer {
   void applyRegularizationRgb(float* DeblurImgR, float* DeblurImgG,
                               float* DeblurImgB, int width, int height,
                               bool bPoisson, float lambda) override;
+
+  bool computeRegularizationTermGray(float* DeblurImg, int width, int height,
+                                     const float*& TermImg) override;
+
+  bool computeRegularizationTermRgb(float* DeblurImgR, float* DeblurImgG,
+                                    float* DeblurImgB, int width, int height,
+                                    const float*& TermImgR,
+                                    const float*& TermImgG,
+                                    const float*& TermImgB) override;
 };
\ No newline at end of file
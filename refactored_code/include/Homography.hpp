@@ -54,6 +54,12 @@ class Homography {
     I[2][2] = (float)((A[0][0] * A[1][1] - A[0][1] * A[1][0]) / detA);
   }
 
+  // Samples of a motion at i / numSamples of it, interpolated linearly
+  // between the samples, which are at i / samples.size(). Past the last
+  // sample the motion of the last step continues.
+  static std::vector<Homography> ResampleMotion(
+      const std::vector<Homography>& samples, int numSamples);
+
   void Transform(float& x, float& y) const {
     const float z = Hmatrix[2][0] * x + Hmatrix[2][1] * y + Hmatrix[2][2];
     const float fx =
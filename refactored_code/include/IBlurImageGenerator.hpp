@@ -1,5 +1,13 @@
 #pragma once
 
+#include <functional>
+
+#include "BufferPool.hpp"
+#include "Image.hpp"
+
+// Called with the pixel indices [begin, end) of a finished output segment
+using BlurEpilogue = std::function<void(int begin, int end)>;
+
 class IBlurImageGenerator {
  public:
   virtual ~IBlurImageGenerator() = default;
@@ -14,6 +22,66 @@ class IBlurImageGenerator {
                        float* outputWeight, int width, int height,
                        bool bforward) = 0;
 
-  virtual void SetBuffer(int width, int height) = 0;
+  // Same blur, aEpilogue runs on every output segment as soon as it is
+  // final, while it is still in cache. Segments can be processed
+  // concurrently. Returns false if the generator has no fused blur, the
+  // caller then runs blurGray / blurRgb and its own pass.
+  virtual bool blurGrayFused([[maybe_unused]] float* InputImg,
+                             [[maybe_unused]] float* inputWeight,
+                             [[maybe_unused]] int iwidth,
+                             [[maybe_unused]] int iheight,
+                             [[maybe_unused]] float* BlurImg,
+                             [[maybe_unused]] float* outputWeight,
+                             [[maybe_unused]] int width,
+                             [[maybe_unused]] int height,
+                             [[maybe_unused]] bool bforward,
+                             [[maybe_unused]] const BlurEpilogue& aEpilogue) {
+    return false;
+  }
+  virtual bool blurRgbFused(
+      [[maybe_unused]] float* InputImgR, [[maybe_unused]] float* InputImgG,
+      [[maybe_unused]] float* InputImgB, [[maybe_unused]] float* inputWeight,
+      [[maybe_unused]] int iwidth, [[maybe_unused]] int iheight,
+      [[maybe_unused]] float* BlurImgR, [[maybe_unused]] float* BlurImgG,
+      [[maybe_unused]] float* BlurImgB, [[maybe_unused]] float* outputWeight,
+      [[maybe_unused]] int width, [[maybe_unused]] int height,
+      [[maybe_unused]] bool bforward,
+      [[maybe_unused]] const BlurEpilogue& aEpilogue) {
+    return false;
+  }
+
+  // Blur of gray or RGB image views of any layout and stride. The weights
+  // are gray images of the input and output size, inputWeight can be empty.
+  // Contiguous planar images are blurred in place, others are copied.
+  template <typename TInput, ImageLayout Layout>
+  void blur(const Image<TInput, Layout>& InputImg,
+            const Image<const float>& inputWeight,
+            const Image<float, Layout>& BlurImg,
+            const Image<float>& outputWeight, bool bforward) {
+    const ImagePlanes<const float, Layout> input{InputImg};
+    const ImagePlanes<const float, ImageLayout::Planar> inWeight{inputWeight};
+    const ImagePlanes<float, Layout> output{BlurImg};
+    const ImagePlanes<float, ImageLayout::Planar> outWeight{outputWeight};
+
+    if (InputImg.channels() == 1) {
+      blurGray(input[0], inWeight[0], InputImg.width(), InputImg.height(),
+               output[0], outWeight[0], BlurImg.width(), BlurImg.height(),
+               bforward);
+    } else {
+      blurRgb(input[0], input[1], input[2], inWeight[0], InputImg.width(),
+              InputImg.height(), output[0], output[1], output[2],
+              outWeight[0], BlurImg.width(), BlurImg.height(), bforward);
+    }
+
+    output.writeBack();
+    outWeight.writeBack();
+  }
+
+  // Scratch buffers for images of width * height and 1 (gray) or 3 (RGB)
+  // channels, only the buffers of that channel count are allocated
+  virtual void SetBuffer(int width, int height, int channels) = 0;
   virtual void ClearBuffer() = 0;
+
+  // Pool of the scratch buffers, the default pool unless set
+  virtual void SetBufferPool([[maybe_unused]] BufferPool& aPool) {}
 };
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "Image.hpp"
+
+// Image kept in a file and accessed by regions, only the regions in use are
+// in memory
+class IImageFile {
+ public:
+  virtual ~IImageFile() = default;
+
+  virtual int GetWidth() const = 0;
+  virtual int GetHeight() const = 0;
+  // 1 (gray) or 3 (RGB)
+  virtual int GetChannels() const = 0;
+
+  // The region of the view size at (x, y) into or from the view, which has
+  // the channels of the file
+  virtual void ReadRegion(int x, int y, const Image<float>& region) = 0;
+  virtual void WriteRegion(int x, int y,
+                           const Image<const float>& region) = 0;
+};
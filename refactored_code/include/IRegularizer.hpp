@@ -1,9 +1,17 @@
 #pragma once
 
+#include <cmath>
+
+#include "BufferPool.hpp"
+#include "Image.hpp"
+
 class IRegularizer {
  public:
   virtual ~IRegularizer() = default;
 
+  // Pool of the scratch buffers, the default pool unless set
+  virtual void SetBufferPool([[maybe_unused]] BufferPool& aPool) {}
+
   ////////////////////////////////////
   // These functions are used to apply regularization
   ////////////////////////////////////
@@ -13,4 +21,87 @@ class IRegularizer {
   virtual void applyRegularizationRgb(float* DeblurImgR, float* DeblurImgG,
                                       float* DeblurImgB, int width, int height,
                                       bool bPoisson, float lambda) = 0;
-};
\ No newline at end of file
+
+  // Regularization of a gray or RGB image view of any layout and stride
+  template <ImageLayout Layout>
+  void applyRegularization(const Image<float, Layout>& DeblurImg,
+                           bool bPoisson, float lambda) {
+    const ImagePlanes<float, Layout> planes{DeblurImg};
+    if (DeblurImg.channels() == 1) {
+      applyRegularizationGray(planes[0], DeblurImg.width(), DeblurImg.height(),
+                              bPoisson, lambda);
+    } else {
+      applyRegularizationRgb(planes[0], planes[1], planes[2],
+                             DeblurImg.width(), DeblurImg.height(), bPoisson,
+                             lambda);
+    }
+    planes.writeBack();
+  }
+
+  ////////////////////////////////////
+  // These functions are used to fuse the regularization into the RL update
+  ////////////////////////////////////
+  // Computes the per pixel term of the regularization, which is then applied
+  // with regularizePixel. TermImg points to a buffer of the regularizer, or
+  // is nullptr when there is nothing to apply. Returns false if the
+  // regularization has no per pixel form, applyRegularization* is then used.
+  virtual bool computeRegularizationTermGray(
+      [[maybe_unused]] float* DeblurImg, [[maybe_unused]] int width,
+      [[maybe_unused]] int height, [[maybe_unused]] const float*& TermImg) {
+    return false;
+  }
+
+  virtual bool computeRegularizationTermRgb(
+      [[maybe_unused]] float* DeblurImgR, [[maybe_unused]] float* DeblurImgG,
+      [[maybe_unused]] float* DeblurImgB, [[maybe_unused]] int width,
+      [[maybe_unused]] int height, [[maybe_unused]] const float*& TermImgR,
+      [[maybe_unused]] const float*& TermImgG,
+      [[maybe_unused]] const float*& TermImgB) {
+    return false;
+  }
+
+  // Noise model as a template parameter, for the kernels specialized on it
+  template <bool Poisson>
+  static float regularizePixel(float value, float term, float lambda) {
+    if constexpr (Poisson) {
+      return (float)(value * (1.0 / (1.0 + lambda * term)));
+    } else {
+      return value - lambda * term;
+    }
+  }
+
+  static float regularizePixel(float value, float term, bool bPoisson,
+                               float lambda) {
+    return bPoisson ? regularizePixel<true>(value, term, lambda)
+                    : regularizePixel<false>(value, term, lambda);
+  }
+
+  // regularizePixel of the size pixels of a plane, the noise model is
+  // selected once for the plane. bZeroNaN replaces NaN results by 0.
+  static void regularizePlane(float* DeblurImg, const float* TermImg,
+                              int size, bool bPoisson, float lambda,
+                              bool bZeroNaN = false) {
+    if (bPoisson && bZeroNaN) {
+      regularizePlane<true, true>(DeblurImg, TermImg, size, lambda);
+    } else if (bPoisson) {
+      regularizePlane<true, false>(DeblurImg, TermImg, size, lambda);
+    } else if (bZeroNaN) {
+      regularizePlane<false, true>(DeblurImg, TermImg, size, lambda);
+    } else {
+      regularizePlane<false, false>(DeblurImg, TermImg, size, lambda);
+    }
+  }
+
+ private:
+  template <bool Poisson, bool ZeroNaN>
+  static void regularizePlane(float* DeblurImg, const float* TermImg,
+                              int size, float lambda) {
+    for (int index = 0; index < size; index++) {
+      DeblurImg[index] =
+          regularizePixel<Poisson>(DeblurImg[index], TermImg[index], lambda);
+      if constexpr (ZeroNaN) {
+        if (std::isnan(DeblurImg[index])) DeblurImg[index] = 0;
+      }
+    }
+  }
+};
@@ -0,0 +1,237 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+#include "BufferPool.hpp"
+
+// Plane alignment of the images allocated by ImageBuffer, enough for AVX-512
+constexpr std::size_t kImageAlignment = 64;
+
+// Planar: one plane per channel, the value (x, y) of channel c is at
+// plane(c)[y * stride + x].
+// Interleaved: the channels of a pixel are adjacent, the value is at
+// data[y * stride + x * channels + c].
+enum class ImageLayout { Planar, Interleaved };
+
+// Non owning view of an image of 1 to 3 channels. The stride is the
+// distance between the rows in elements, it can be larger than the row to
+// wrap padded or externally owned buffers.
+template <typename T, ImageLayout Layout = ImageLayout::Planar>
+class Image {
+ public:
+  static constexpr int MaxChannels = 3;
+
+  Image() = default;
+
+  // Gray image, of any layout
+  Image(T* data, int width, int height, int stride = 0)
+      : mWidth(width), mHeight(height), mChannels(1) {
+    mPlanes[0] = data;
+    mStride = stride > 0 ? stride : width;
+  }
+
+  // Planar RGB image
+  Image(T* planeR, T* planeG, T* planeB, int width, int height, int stride = 0)
+    requires(Layout == ImageLayout::Planar)
+      : mWidth(width), mHeight(height), mChannels(3) {
+    mPlanes[0] = planeR;
+    mPlanes[1] = planeG;
+    mPlanes[2] = planeB;
+    mStride = stride > 0 ? stride : width;
+  }
+
+  // Interleaved image of channels values per pixel
+  Image(T* data, int width, int height, int channels, int stride)
+    requires(Layout == ImageLayout::Interleaved)
+      : mWidth(width), mHeight(height), mChannels(channels) {
+    mPlanes[0] = data;
+    mStride = stride > 0 ? stride : width * channels;
+  }
+
+  // Const view of a mutable image
+  operator Image<const T, Layout>() const
+    requires(!std::is_const_v<T>)
+  {
+    Image<const T, Layout> view;
+    view.mWidth = mWidth;
+    view.mHeight = mHeight;
+    view.mChannels = mChannels;
+    view.mStride = mStride;
+    for (int c = 0; c < MaxChannels; c++) view.mPlanes[c] = mPlanes[c];
+    return view;
+  }
+
+  int width() const { return mWidth; }
+  int height() const { return mHeight; }
+  int channels() const { return mChannels; }
+  int stride() const { return mStride; }
+  bool empty() const { return mPlanes[0] == nullptr; }
+
+  // Distance between two pixels of a row in elements
+  static constexpr int pixelStep(int channels) {
+    return Layout == ImageLayout::Planar ? 1 : channels;
+  }
+
+  // First value of channel c in row y, the next pixels are pixelStep apart
+  T* row(int y, int c = 0) const {
+    if constexpr (Layout == ImageLayout::Planar) {
+      return mPlanes[c] + static_cast<std::ptrdiff_t>(y) * mStride;
+    } else {
+      return mPlanes[0] + static_cast<std::ptrdiff_t>(y) * mStride + c;
+    }
+  }
+
+  T& at(int x, int y, int c = 0) const {
+    return row(y, c)[static_cast<std::ptrdiff_t>(x) * pixelStep(mChannels)];
+  }
+
+  // Planar and without padding, the planes are width * height buffers that
+  // the raw pointer interfaces can use directly
+  bool isContiguous() const {
+    return Layout == ImageLayout::Planar && mStride == mWidth;
+  }
+
+  T* plane(int c) const { return mPlanes[c]; }
+
+  // Every row of every plane starts on an alignment boundary
+  bool isAligned(std::size_t alignment = kImageAlignment) const {
+    if ((mStride * sizeof(T)) % alignment != 0) return false;
+    const int planes = Layout == ImageLayout::Planar ? mChannels : 1;
+    for (int c = 0; c < planes; c++) {
+      if (reinterpret_cast<std::uintptr_t>(mPlanes[c]) % alignment != 0) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+ private:
+  template <typename, ImageLayout>
+  friend class Image;
+
+  T* mPlanes[MaxChannels]{};
+  int mWidth = 0;
+  int mHeight = 0;
+  int mChannels = 0;
+  int mStride = 0;
+};
+
+// Owning image without row padding, every plane starts on a kImageAlignment
+// boundary. A planar ImageBuffer is contiguous, so ImagePlanes and the raw
+// pointer interfaces use it without a copy. The kernels take no stride, so
+// padded rows would only add a copy per call.
+template <typename T, ImageLayout Layout = ImageLayout::Planar>
+class ImageBuffer {
+ public:
+  ImageBuffer() = default;
+
+  ImageBuffer(int width, int height, int channels) {
+    resize(width, height, channels);
+  }
+
+  void resize(int width, int height, int channels) {
+    constexpr std::size_t alignment = kImageAlignment / sizeof(T);
+    const int stride = width * Image<T, Layout>::pixelStep(channels);
+    const std::size_t planeValues = static_cast<std::size_t>(stride) * height;
+    const std::size_t planeStride =
+        (planeValues + alignment - 1) / alignment * alignment;
+    const int planes = Layout == ImageLayout::Planar ? channels : 1;
+
+    mData.reset(static_cast<T*>(::operator new[](
+        planeStride * planes * sizeof(T), std::align_val_t(kImageAlignment))));
+    T* plane[3]{};
+    for (int c = 0; c < planes; c++) {
+      plane[c] = mData.get() + planeStride * c;
+      std::fill(plane[c], plane[c] + planeValues, T{});
+    }
+
+    if constexpr (Layout == ImageLayout::Planar) {
+      mImage = channels == 1
+                   ? Image<T, Layout>(plane[0], width, height, stride)
+                   : Image<T, Layout>(plane[0], plane[1], plane[2], width,
+                                      height, stride);
+    } else {
+      mImage = Image<T, Layout>(plane[0], width, height, channels, stride);
+    }
+  }
+
+  const Image<T, Layout>& view() const { return mImage; }
+
+ private:
+  struct AlignedDelete {
+    void operator()(T* data) const {
+      ::operator delete[](data, std::align_val_t(kImageAlignment));
+    }
+  };
+
+  std::unique_ptr<T, AlignedDelete> mData;
+  Image<T, Layout> mImage;
+};
+
+// Contiguous width * height planes of an image, for the raw pointer
+// interfaces. The planes of a contiguous planar image are used in place,
+// other images are copied to and, with writeBack, from planes of pool.
+template <typename T, ImageLayout Layout>
+class ImagePlanes {
+  static_assert(std::is_same_v<std::remove_const_t<T>, float>,
+                "The raw pointer interfaces take float planes");
+
+ public:
+  explicit ImagePlanes(const Image<T, Layout>& image,
+                       BufferPool& pool = BufferPool::GetDefault())
+      : mImage(image) {
+    if (image.empty()) return;
+    if (image.isContiguous()) {
+      for (int c = 0; c < image.channels(); c++) {
+        mPlanes[c] = const_cast<float*>(image.plane(c));
+      }
+      return;
+    }
+
+    const int step = Image<T, Layout>::pixelStep(image.channels());
+    mStorage.resize(static_cast<std::size_t>(image.channels()) *
+                        image.width() * image.height(),
+                    pool);
+    for (int c = 0; c < image.channels(); c++) {
+      mPlanes[c] = mStorage.data() +
+                   static_cast<std::size_t>(c) * image.width() * image.height();
+      float* plane = mPlanes[c];
+      for (int y = 0; y < image.height(); y++) {
+        const T* row = image.row(y, c);
+        for (int x = 0; x < image.width(); x++) {
+          *plane++ = row[x * step];
+        }
+      }
+    }
+  }
+
+  float* operator[](int c) const { return mPlanes[c]; }
+
+  // Copies the planes back into a copied image
+  void writeBack() const
+    requires(!std::is_const_v<T>)
+  {
+    if (mStorage.empty()) return;
+    const int step = Image<T, Layout>::pixelStep(mImage.channels());
+    for (int c = 0; c < mImage.channels(); c++) {
+      const float* plane = mPlanes[c];
+      for (int y = 0; y < mImage.height(); y++) {
+        T* row = mImage.row(y, c);
+        for (int x = 0; x < mImage.width(); x++) {
+          row[x * step] = *plane++;
+        }
+      }
+    }
+  }
+
+ private:
+  Image<T, Layout> mImage;
+  float* mPlanes[Image<T, Layout>::MaxChannels]{};
+  PoolBuffer mStorage;
+};
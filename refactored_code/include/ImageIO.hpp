@@ -0,0 +1,35 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "IImageFile.hpp"
+
+// Image files of the formats given by their extension: .bmp (bitmap.h),
+// .pfm (32-bit floats), .pgm and .ppm (8 or 16-bit, see pnm.h). The
+// extensions are compared without case.
+
+// Supported extension that ends fname, as written in fname, or empty
+std::string getImageExtension(const std::string& fname);
+
+// Maps an existing file, its regions can be written if bWritable. Throws
+// std::runtime_error if it cannot be read.
+std::unique_ptr<IImageFile> openImageFile(const std::string& fname,
+                                          bool bWritable = false);
+// Creates a black image of width * height with 1 or 3 channels. BMP files
+// are 8 or 24-bit, PGM and PPM files 16-bit. A PGM file has 1 channel and a
+// PPM file 3.
+std::unique_ptr<IImageFile> createImageFile(const std::string& fname,
+                                            int width, int height,
+                                            int channels);
+
+// readBMPchannels and writeBMPchannels for every format. A gray image is
+// read into the three channels, R is written to a gray file.
+void readImageChannels(const std::string& fname, std::vector<float>& fImgR,
+                       std::vector<float>& fImgG, std::vector<float>& fImgB,
+                       int& width, int& height);
+void writeImageChannels(const std::string& iname, int width, int height,
+                        const std::vector<float>& dataR,
+                        const std::vector<float>& dataG,
+                        const std::vector<float>& dataB);
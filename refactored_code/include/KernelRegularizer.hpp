@@ -10,7 +10,7 @@ class KernelRegularizer : public IRegularizer {
   ////////////////////////////////////
   // These functions are used to set Buffer for caching
   ////////////////////////////////////
-  void SetBuffer(int width, int height);
+  void SetBuffer(int width, int height, int channels);
   void ClearBuffer();
 
   ////////////////////////////////////
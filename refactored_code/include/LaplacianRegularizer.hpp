@@ -1,7 +1,6 @@
 #pragma once
 
-#include <vector>
-
+#include "BufferPool.hpp"
 #include "IRegularizer.hpp"
 
 // Value of lambda used in Levin et al is also un-normalized by minWeight,
@@ -16,8 +15,10 @@ class LaplacianRegularizer : public IRegularizer {
   ////////////////////////////////////
   // These functions are used to set Buffer for caching
   ////////////////////////////////////
-  void SetBuffer(int width, int height);
+  // Only the buffers of the channel count, 1 or 3, are allocated
+  void SetBuffer(int width, int height, int channels);
   void ClearBuffer();
+  void SetBufferPool(BufferPool& aPool) override;
 
   ////////////////////////////////////
   // These functions are used to apply regularization
@@ -29,6 +30,15 @@ class LaplacianRegularizer : public IRegularizer {
                               float* DeblurImgB, int width, int height,
                               bool bPoisson, float lambda) override;
 
+  bool computeRegularizationTermGray(float* DeblurImg, int width, int height,
+                                     const float*& TermImg) override;
+
+  bool computeRegularizationTermRgb(float* DeblurImgR, float* DeblurImgG,
+                                    float* DeblurImgB, int width, int height,
+                                    const float*& TermImgR,
+                                    const float*& TermImgG,
+                                    const float*& TermImgB) override;
+
  private:
   // These are buffer and lookup table variables
   float mSpsTable[256]{};
@@ -46,21 +56,23 @@ class LaplacianRegularizer : public IRegularizer {
   void ComputeGradientImageGray(float* Img, int width, int height, float* DxImg,
                                 float* DyImg, bool bflag = true);
 
-  std::vector<float> mDxImg;
-  std::vector<float> mDyImg;
-  std::vector<float> mDxxImg;
-  std::vector<float> mDyyImg;
+  BufferPool* mBufferPool = &BufferPool::GetDefault();
+
+  PoolBuffer mDxImg;
+  PoolBuffer mDyImg;
+  PoolBuffer mDxxImg;
+  PoolBuffer mDyyImg;
 
-  std::vector<float> mDxImgR;
-  std::vector<float> mDyImgR;
-  std::vector<float> mDxxImgR;
-  std::vector<float> mDyyImgR;
-  std::vector<float> mDxImgG;
-  std::vector<float> mDyImgG;
-  std::vector<float> mDxxImgG;
-  std::vector<float> mDyyImgG;
-  std::vector<float> mDxImgB;
-  std::vector<float> mDyImgB;
-  std::vector<float> mDxxImgB;
-  std::vector<float> mDyyImgB;
+  PoolBuffer mDxImgR;
+  PoolBuffer mDyImgR;
+  PoolBuffer mDxxImgR;
+  PoolBuffer mDyyImgR;
+  PoolBuffer mDxImgG;
+  PoolBuffer mDyImgG;
+  PoolBuffer mDxxImgG;
+  PoolBuffer mDyyImgG;
+  PoolBuffer mDxImgB;
+  PoolBuffer mDyImgB;
+  PoolBuffer mDxxImgB;
+  PoolBuffer mDyyImgB;
 };
\ No newline at end of file
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// File mapped into memory, the pages are read and written by the system as
+// they are used
+class MappedFile {
+ public:
+  MappedFile() = default;
+  // Maps an existing file, read only unless bWritable
+  MappedFile(const std::string& fname, bool bWritable);
+  // Creates, or truncates, a file of size bytes and maps it writable
+  MappedFile(const std::string& fname, std::size_t size);
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  uint8_t* data() { return mData; }
+  const uint8_t* data() const { return mData; }
+  std::size_t size() const { return mSize; }
+  bool writable() const { return mWritable; }
+
+ private:
+  void Map(const std::string& fname, bool bWritable, bool bCreate,
+           std::size_t size);
+
+  uint8_t* mData = nullptr;
+  std::size_t mSize = 0;
+  bool mWritable = false;
+#ifdef _WIN32
+  void* mFile = nullptr;
+  void* mMapping = nullptr;
+#endif
+};
@@ -1,13 +1,21 @@
 #pragma once
 
+#include <cstddef>
+#include <memory>
+#include <mutex>
 #include <vector>
 
+#include "BufferPool.hpp"
 #include "Homography.hpp"
 #include "IBlurImageGenerator.hpp"
+#include "SparseBlurOperator.hpp"
+#include "ThreadPool.hpp"
+#include "WarpMap.hpp"
 
 class MotionBlurImageGenerator : public IBlurImageGenerator {
  public:
-  constexpr static int NumSamples = 30;
+  // Homography samples of a new generator
+  constexpr static int DefaultNumSamples = 30;
 
   MotionBlurImageGenerator();
   ~MotionBlurImageGenerator() override = default;
@@ -21,8 +29,84 @@ class MotionBlurImageGenerator : public IBlurImageGenerator {
                float* BlurImgG, float* BlurImgB, float* outputWeight, int width,
                int height, bool bforward) override;
 
-  void SetBuffer(int width, int height) override;
+  // Available in every parallel mode, the epilogue runs on the tiles of the
+  // blur, or on the rows of the merge of the Samples mode
+  bool blurGrayFused(float* InputImg, float* inputWeight, int iwidth,
+                     int iheight, float* BlurImg, float* outputWeight,
+                     int width, int height, bool bforward,
+                     const BlurEpilogue& aEpilogue) override;
+  bool blurRgbFused(float* InputImgR, float* InputImgG, float* InputImgB,
+                    float* inputWeight, int iwidth, int iheight,
+                    float* BlurImgR, float* BlurImgG, float* BlurImgB,
+                    float* outputWeight, int width, int height, bool bforward,
+                    const BlurEpilogue& aEpilogue) override;
+
+  void SetBuffer(int width, int height, int channels) override;
   void ClearBuffer() override;
+  void SetBufferPool(BufferPool& aPool) override;
+
+  ////////////////////////////////////
+  // These functions are used to set the parallel blur mode
+  ////////////////////////////////////
+  // Rows: every warp is split into row tiles, the result is the same as the
+  // serial path for any thread count.
+  // Samples: each thread warps a contiguous range of the homography samples
+  // into its own buffers, the partial sums are then merged in thread order.
+  // With one thread, or when called from the task of a pool, the serial
+  // path is used.
+  enum class ParallelMode { Rows, Samples };
+
+  void SetNumThreads(int aNumThreads);
+  int GetNumThreads() const;
+  void SetParallelMode(ParallelMode aMode);
+
+  ////////////////////////////////////
+  // These functions are used to cache the warp maps
+  ////////////////////////////////////
+  // The forward and the backward blur build a WarpMap of their samples on
+  // their first call for a size, if the maps fit in aBytes, and the next
+  // blurs only gather the input. Blurs whose map does not fit compute the
+  // positions. A map is rebuilt when the homographies or the sizes change.
+  // Used by the serial and the Rows blurs, 0 (the default) disables them.
+  // Maps are only built with the scalar sampler, the vector samplers compute
+  // the positions about as fast as or faster than a map streams its taps.
+  void SetWarpMapBudget(std::size_t aBytes);
+  std::size_t GetWarpMapBytes() const;
+
+  ////////////////////////////////////
+  // These functions are used to blur with a sparse operator
+  ////////////////////////////////////
+  // The forward blurs without input weights and the backward blurs use a
+  // SparseBlurOperator of the forward samples, assembled on the first call
+  // for a size and rebuilt when the homographies or the sizes change. The
+  // backward blur is then the exact adjoint of the forward one instead of
+  // the blur by the inverse homographies, and ignores its input weights.
+  // Takes precedence over the warp maps and the Samples mode.
+  // Disabled by default.
+  void SetSparseOperator(bool aEnabled);
+  std::size_t GetSparseOperatorBytes() const;
+
+  ////////////////////////////////////
+  // These functions are used to set the number of homography samples
+  ////////////////////////////////////
+  // Sample i is at i / GetNumSamples() of the motion. A new count resamples
+  // the current motion, see Homography::ResampleMotion, the motions set
+  // afterwards have the new count. Every blur warps the input once per
+  // sample.
+  void SetNumSamples(int aNumSamples);
+  int GetNumSamples() const { return static_cast<int>(Hmatrix.size()); }
+  // Largest displacement of a pixel of a width * height image between two
+  // consecutive samples, forward or backward, in pixels
+  float GetSampleSpacing(int width, int height) const;
+  // Adaptive count: the fewest samples, at most aMaxSamples, that keep the
+  // mean spacing along the longest path of a pixel, resampled to them, at
+  // or below aMaxSpacing pixels. Small motions get few samples, large
+  // motions more than the default.
+  int GetAdaptiveNumSamples(int width, int height, float aMaxSpacing = 0.5f,
+                            int aMaxSamples = 256) const;
+  // Resamples the current motion to GetAdaptiveNumSamples, returns the count
+  int SetAdaptiveNumSamples(int width, int height, float aMaxSpacing = 0.5f,
+                            int aMaxSamples = 256);
 
   ////////////////////////////////////
   // These functions are used to set the homography
@@ -37,25 +121,61 @@ class MotionBlurImageGenerator : public IBlurImageGenerator {
                            float dx, float dy);
 
   // These are the homography sequence for Projective motion blur model
-  Homography Hmatrix[NumSamples]{};
-  Homography IHmatrix[NumSamples]{};
+  std::vector<Homography> Hmatrix;
+  std::vector<Homography> IHmatrix;
 
  private:
-  std::vector<float> mWarpImgBuffer;
-  std::vector<float> mWarpImgBufferR;
-  std::vector<float> mWarpImgBufferG;
-  std::vector<float> mWarpImgBufferB;
-  std::vector<float> mWarpWeightBuffer;
+  // Per thread buffers of the parallel blur mode
+  struct WorkerBuffers {
+    PoolBuffer mBlurImgBuffer;
+    PoolBuffer mBlurImgBufferR;
+    PoolBuffer mBlurImgBufferG;
+    PoolBuffer mBlurImgBufferB;
+    PoolBuffer mBlurWeightBuffer;
+  };
+
+  std::unique_ptr<ThreadPool> mThreadPool;
+  ParallelMode mParallelMode = ParallelMode::Rows;
+  std::vector<WorkerBuffers> mWorkerBuffers;
+  BufferPool* mBufferPool = &BufferPool::GetDefault();
+
+  // Backward and forward maps, shared with the blurs that use them
+  std::size_t mWarpMapBudget = 0;
+  mutable std::mutex mWarpMapMutex;
+  std::shared_ptr<const WarpMap> mWarpMaps[2];
+
+  bool mSparseOperatorEnabled = false;
+  mutable std::mutex mSparseOperatorMutex;
+  std::shared_ptr<const SparseBlurOperator> mSparseOperator;
 
   ////////////////////////////////////
   // These functions are used to generate the Projective Motion Blur Images
   ////////////////////////////////////
-  // i: postive forward, negative backward
-  void WarpImageGray(float* InputImg, float* inputWeight, int iwidth,
-                     int iheight, float* OutputImg, float* outputWeight,
-                     int width, int height, int i);
-  void WarpImageRgb(float* InputImgR, float* InputImgG, float* InputImgB,
-                    float* inputWeight, int iwidth, int iheight,
-                    float* OutputImgR, float* OutputImgG, float* OutputImgB,
-                    float* outputWeight, int width, int height, int i);
+  // Homographies of the samples: IHmatrix forward, Hmatrix backward
+  std::vector<const Homography*> GetSampleHomographies(bool bforward) const;
+
+  void blurGrayParallel(float* InputImg, float* inputWeight, int iwidth,
+                        int iheight, float* BlurImg, float* outputWeight,
+                        int width, int height, bool bforward,
+                        const BlurEpilogue& aEpilogue);
+  void blurRgbParallel(float* InputImgR, float* InputImgG, float* InputImgB,
+                       float* inputWeight, int iwidth, int iheight,
+                       float* BlurImgR, float* BlurImgG, float* BlurImgB,
+                       float* outputWeight, int width, int height,
+                       bool bforward, const BlurEpilogue& aEpilogue);
+
+  // Map of the samples, nullptr if the maps are disabled or it does not fit
+  std::shared_ptr<const WarpMap> GetWarpMap(
+      bool bforward, const Homography* const* homographies, int iwidth,
+      int iheight, int width, int height);
+
+  // Operator of the blur, nullptr if it is disabled or the blur is a
+  // forward blur with input weights
+  std::shared_ptr<const SparseBlurOperator> GetSparseOperator(
+      bool bforward, const float* inputWeight, int iwidth, int iheight,
+      int width, int height);
+
+  // Number of threads that get a share of the samples
+  int GetNumWorkers() const;
+  void SetWorkerBuffer(int width, int height, int channels);
 };
\ No newline at end of file
@@ -7,7 +7,7 @@
 // Multiscale version: not very useful...
 class ProjectiveMotionRLMultiScaleGray {
  public:
-  constexpr static int NumSamples = 30;
+  constexpr static int DefaultNumSamples = 30;
 
   ProjectiveMotionRLMultiScaleGray();
   ~ProjectiveMotionRLMultiScaleGray();
@@ -18,9 +18,13 @@ class ProjectiveMotionRLMultiScaleGray {
                                               int Niter = 10, int Nscale = 5,
                                               bool bPoisson = true);
 
+  // Resamples the motion to aNumSamples homographies
+  void SetNumSamples(int aNumSamples);
+  int GetNumSamples() const { return static_cast<int>(Hmatrix.size()); }
+
   // These are the homography sequence for Projective motion blur model
-  Homography Hmatrix[NumSamples]{};
-  Homography IHmatrix[NumSamples]{};
+  std::vector<Homography> Hmatrix;
+  std::vector<Homography> IHmatrix;
 
  private:
   ////////////////////////////////////
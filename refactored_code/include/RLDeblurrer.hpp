@@ -1,12 +1,29 @@
 #pragma once
 
+#include <functional>
+#include <memory>
+#include <span>
+#include <string>
 #include <vector>
 
+#include "BufferPool.hpp"
+#include "DeblurCheckpoint.hpp"
 #include "IBlurImageGenerator.hpp"
 #include "IErrorCalculator.hpp"
 #include "IRegularizer.hpp"
+#include "Image.hpp"
 
 struct DeblurParameters;
+struct DeblurResult;
+
+// One image of a batch, deblurred in place like in the single image call
+struct DeblurBatchImage {
+  Image<const float> BlurImg;
+  Image<float> DeblurImg;
+};
+
+// Gives every image of a batch its own regularizer
+using RegularizerFactory = std::function<std::unique_ptr<IRegularizer>()>;
 
 class RLDeblurrer {
  public:
@@ -18,8 +35,24 @@ class RLDeblurrer {
   ////////////////////////////////////
   // These functions are used to set Buffer for caching
   ////////////////////////////////////
-  void SetBuffer(int width, int height);
+  // Only the buffers of the channel count, 1 or 3, are allocated
+  void SetBuffer(int width, int height, int channels);
   void ClearBuffer();
+  void SetBufferPool(BufferPool& aPool);
+
+  ////////////////////////////////////
+  // These functions are used to checkpoint long runs
+  ////////////////////////////////////
+  // Writes the estimate and the iteration state to fname every interval
+  // iterations (<= 0 only at the end) and at the end of every deblurring
+  // call, an empty fname disables the checkpoints. If fname exists, the
+  // deblurrer resumes from it: the calls it completed return without
+  // iterating, the last of them with its estimate, and the call it was
+  // written in continues from its last iteration. The calls and their
+  // parameters must be those of the run that wrote it.
+  void SetCheckpoint(const std::string& fname, int interval);
+  // Removes the checkpoint file once the run is done
+  void RemoveCheckpoint();
 
   ////////////////////////////////////
   // These functions are deblurring algorithm
@@ -27,30 +60,117 @@ class RLDeblurrer {
   // This is the Basic algorithm
   // DeblurImg: the Input itself is initialization, so you can load
   // yBilateralLap own initialization
-  void deblurGray(float* BlurImg, int iwidth, int iheight, float* DeblurImg,
-                  int width, int height, const DeblurParameters& aParameters,
-                  IRegularizer& regularizer, float lambda);
-  void deblurRgb(float* BlurImgR, float* BlurImgG, float* BlurImgB, int iwidth,
-                 int iheight, float* DeblurImgR, float* DeblurImgG,
-                 float* DeblurImgB, int width, int height,
-                 const DeblurParameters& aParameters, IRegularizer& regularizer,
-                 float lambda);
+  // The iterations stop after Niter or when an early termination criterion
+  // of aParameters is met, the result tells which and after how many
+  DeblurResult deblurGray(float* BlurImg, int iwidth, int iheight,
+                          float* DeblurImg, int width, int height,
+                          const DeblurParameters& aParameters,
+                          IRegularizer& regularizer, float lambda);
+  DeblurResult deblurRgb(float* BlurImgR, float* BlurImgG, float* BlurImgB,
+                         int iwidth, int iheight, float* DeblurImgR,
+                         float* DeblurImgG, float* DeblurImgB, int width,
+                         int height, const DeblurParameters& aParameters,
+                         IRegularizer& regularizer, float lambda);
+
+  // The same for gray or RGB image views. Contiguous planar images are
+  // deblurred in place, others are copied to planes and back.
+  DeblurResult deblur(const Image<const float>& BlurImg,
+                      const Image<float>& DeblurImg,
+                      const DeblurParameters& aParameters,
+                      IRegularizer& regularizer, float lambda);
+  DeblurResult deblur(
+      const Image<const float, ImageLayout::Interleaved>& BlurImg,
+      const Image<float, ImageLayout::Interleaved>& DeblurImg,
+      const DeblurParameters& aParameters, IRegularizer& regularizer,
+      float lambda);
+
+  // Deblurs images that share the motion of the blur generator, numThreads
+  // images at a time (<= 0 selects the hardware concurrency). Each image
+  // runs on one thread with its own buffers and regularizer, the blur
+  // generator and the buffer pool are shared. The results are those of the
+  // single image calls with a Rows mode generator. The error calculator is
+  // not called, peakBufferBytes is the peak of the whole batch.
+  std::vector<DeblurResult> deblurBatch(
+      std::span<const DeblurBatchImage> images,
+      const DeblurParameters& aParameters,
+      const RegularizerFactory& makeRegularizer, float lambda,
+      int numThreads = 0);
 
  private:
+  template <ImageLayout Layout>
+  DeblurResult deblurImage(const Image<const float, Layout>& BlurImg,
+                           const Image<float, Layout>& DeblurImg,
+                           const DeblurParameters& aParameters,
+                           IRegularizer& regularizer, float lambda);
+
+  ////////////////////////////////////
+  // These functions run a blur followed by aEpilogue on its output, fused
+  // when the generator supports it
+  ////////////////////////////////////
+  void blurGray(float* InputImg, float* inputWeight, int iwidth, int iheight,
+                float* BlurImg, float* outputWeight, int width, int height,
+                bool bforward, const BlurEpilogue& aEpilogue);
+  void blurRgb(float* InputImgR, float* InputImgG, float* InputImgB,
+               float* inputWeight, int iwidth, int iheight, float* BlurImgR,
+               float* BlurImgG, float* BlurImgB, float* outputWeight,
+               int width, int height, bool bforward,
+               const BlurEpilogue& aEpilogue);
+
+  ////////////////////////////////////
+  // These functions read and write the checkpoint of a deblurring call. The
+  // planes are the estimate, then the previous estimate and the last step
+  // of the accelerated mode.
+  ////////////////////////////////////
+  // Returns the first iteration of the call, -1 if the checkpoint completed
+  // it. The planes and the step correlation are those of the checkpoint
+  // when the call resumes from it.
+  int ResumeCheckpoint(std::span<float* const> planes, int width,
+                       int height, int channels, double& stepDot,
+                       double& stepNorm);
+  // The state after iteration of the call, 0 once the call is complete
+  void SaveCheckpoint(std::span<float* const> planes, int width, int height,
+                      int channels, int iteration, double stepDot,
+                      double stepNorm);
+
   IBlurImageGenerator& mBlurGenerator;
   IErrorCalculator& mErrorCalculator;
 
-  std::vector<float> mBlurImgBuffer;
-  std::vector<float> mBlurImgBufferR;
-  std::vector<float> mBlurImgBufferG;
-  std::vector<float> mBlurImgBufferB;
+  BufferPool* mBufferPool = &BufferPool::GetDefault();
+
+  // Deblurrer of a batch image, the blur generator buffers and the peak of
+  // the pool belong to the batch
+  bool mInBatch = false;
+
+  PoolBuffer mBlurImgBuffer;
+  PoolBuffer mBlurImgBufferR;
+  PoolBuffer mBlurImgBufferG;
+  PoolBuffer mBlurImgBufferB;
+
+  PoolBuffer mBlurWeightBuffer;
+
+  PoolBuffer mErrorImgBuffer;
+  PoolBuffer mErrorImgBufferR;
+  PoolBuffer mErrorImgBufferG;
+  PoolBuffer mErrorImgBufferB;
+
+  PoolBuffer mErrorWeightBuffer;
 
-  std::vector<float> mBlurWeightBuffer;
+  // Previous estimate and last step of the accelerated mode
+  PoolBuffer mPrevImgBuffer;
+  PoolBuffer mPrevImgBufferR;
+  PoolBuffer mPrevImgBufferG;
+  PoolBuffer mPrevImgBufferB;
 
-  std::vector<float> mErrorImgBuffer;
-  std::vector<float> mErrorImgBufferR;
-  std::vector<float> mErrorImgBufferG;
-  std::vector<float> mErrorImgBufferB;
+  PoolBuffer mStepImgBuffer;
+  PoolBuffer mStepImgBufferR;
+  PoolBuffer mStepImgBufferG;
+  PoolBuffer mStepImgBufferB;
 
-  std::vector<float> mErrorWeightBuffer;
+  std::string mCheckpointName;
+  int mCheckpointInterval = 0;
+  // Deblurring calls since SetCheckpoint
+  int mCheckpointCall = 0;
+  // State of the checkpoint to resume from
+  bool mResume = false;
+  DeblurCheckpointState mResumeState;
 };
\ No newline at end of file
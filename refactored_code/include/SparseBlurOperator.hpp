@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "BilinearSampler.h"
+#include "Homography.hpp"
+#include "IBlurImageGenerator.hpp"
+#include "ThreadPool.hpp"
+
+// Forward blur of the samples of a motion assembled into a sparse matrix.
+// Without input weights the blur is linear in the input,
+//   Blur = A Input,  A = D^-1 W,
+// the row of W of an output pixel holds the bilinear taps of its samples,
+// weighted by 1.01 inside and 0.01 outside the input, and the diagonal D
+// holds the sums of these weights, the output weights of the blur.
+// A is stored in CSR, its duplicate taps merged, together with the CSR of
+// its transpose normalized the same way,
+//   Adjoint = E^-1 A^T,  E = diag(A^T 1),
+// so the backward blur is the exact adjoint of the forward one. It is not
+// the homography backward blur of MotionBlurImageGenerator, which warps
+// with the inverse homographies and weights the input.
+class SparseBlurOperator {
+ public:
+  // The forward blur of an iwidth * iheight input into a width * height
+  // output, with the forward homographies of the samples
+  SparseBlurOperator(const Homography* const* homographies, int numSamples,
+                     int iwidth, int iheight, int width, int height,
+                     ThreadPool* threadPool);
+
+  // Memory of both matrices
+  std::size_t GetBytes() const;
+
+  // Built for these samples and sizes, with the current sampler transform
+  bool Matches(const Homography* const* homographies, int numSamples,
+               int iwidth, int iheight, int width, int height) const;
+
+  std::size_t GetNumNonZeros() const { return mForward.values.size(); }
+
+  // bforward: the forward blur of an iwidth * iheight input, otherwise the
+  // adjoint of a width * height input. The output weights are the diagonal
+  // of the normalization, 0 for the pixels that no value reaches, whose
+  // output is then 0. aEpilogue runs on every finished output row.
+  void blurGray(const float* InputImg, float* BlurImg, float* outputWeight,
+                bool bforward, ThreadPool* threadPool,
+                const BlurEpilogue& aEpilogue) const;
+  void blurRgb(const float* InputImgR, const float* InputImgG,
+               const float* InputImgB, float* BlurImgR, float* BlurImgG,
+               float* BlurImgB, float* outputWeight, bool bforward,
+               ThreadPool* threadPool, const BlurEpilogue& aEpilogue) const;
+
+ private:
+  // Rows normalized by their weights
+  struct Matrix {
+    int width = 0;
+    int height = 0;
+    std::vector<std::size_t> rowStart;
+    std::vector<int> columns;
+    std::vector<float> values;
+    std::vector<float> weights;
+  };
+
+  std::vector<Homography> mHomographies;
+  int mIwidth;
+  int mIheight;
+  int mWidth;
+  int mHeight;
+  SamplerTransform mTransform;
+  int mResyncPixels;
+
+  Matrix mForward;
+  Matrix mAdjoint;
+
+  void Assemble(const Homography* const* homographies, int numSamples,
+                ThreadPool* threadPool);
+  void Transpose();
+};
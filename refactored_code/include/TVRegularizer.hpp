@@ -1,12 +1,16 @@
 #pragma once
 
-#include <vector>
-
+#include "BufferPool.hpp"
 #include "IRegularizer.hpp"
 
 // The lambda in TV regularization is 0.002, but it's un-normalized weight
 // Intensity range is between 0 and 1, so, the actual weight is 0.002f * 255 =
 // 0.51f for normalized weight
+//
+// The term is computed in one sweep over the rows: the normalized gradients
+// of a row only depend on its neighbor rows, so a few rolling row buffers
+// per channel replace the gradient images. applyRegularization* updates the
+// rows in the same sweep and needs no image sized buffer.
 class TVRegularizer : public IRegularizer {
  public:
   ~TVRegularizer() override { ClearBuffer(); }
@@ -14,8 +18,10 @@ class TVRegularizer : public IRegularizer {
   ////////////////////////////////////
   // These functions are used to set Buffer for caching
   ////////////////////////////////////
-  void SetBuffer(int width, int height);
+  // Term images of the channel count, 1 or 3, for the fused regularization
+  void SetBuffer(int width, int height, int channels);
   void ClearBuffer();
+  void SetBufferPool(BufferPool& aPool) override;
 
   ////////////////////////////////////
   // These functions are used to apply regularization
@@ -27,32 +33,35 @@ class TVRegularizer : public IRegularizer {
                               float* DeblurImgB, int width, int height,
                               bool bPoisson, float lambda) override;
 
+  bool computeRegularizationTermGray(float* DeblurImg, int width, int height,
+                                     const float*& TermImg) override;
+
+  bool computeRegularizationTermRgb(float* DeblurImgR, float* DeblurImgG,
+                                    float* DeblurImgB, int width, int height,
+                                    const float*& TermImgR,
+                                    const float*& TermImgG,
+                                    const float*& TermImgB) override;
+
  private:
   ////////////////////////////////////
-  // These functions are used to compute derivatives for regularization
+  // These functions are used to compute the term row by row
   ////////////////////////////////////
-  void ComputeGradientXImageGray(float* Img, int width, int height,
-                                 float* DxImg, bool bflag = true);
-  void ComputeGradientYImageGray(float* Img, int width, int height,
-                                 float* DyImg, bool bflag = true);
-  void ComputeGradientImageGray(float* Img, int width, int height, float* DxImg,
-                                float* DyImg, bool bflag = true);
-
-  std::vector<float> mDxImg;
-  std::vector<float> mDyImg;
-  std::vector<float> mDxxImg;
-  std::vector<float> mDyyImg;
-
-  std::vector<float> mDxImgR;
-  std::vector<float> mDyImgR;
-  std::vector<float> mDxxImgR;
-  std::vector<float> mDyyImgR;
-  std::vector<float> mDxImgG;
-  std::vector<float> mDyImgG;
-  std::vector<float> mDxxImgG;
-  std::vector<float> mDyyImgG;
-  std::vector<float> mDxImgB;
-  std::vector<float> mDyImgB;
-  std::vector<float> mDxxImgB;
-  std::vector<float> mDyyImgB;
+  // Row buffers of the sweep, 3 rows per channel
+  void SetRowBuffer(int width, int channels);
+
+  // Calls applyRow(c, y, TermRow) with the term of row y of Imgs[c], the
+  // rows in order. applyRow may overwrite row y of the image, the rows
+  // above it are no longer read.
+  template <int Channels, typename RowFunc>
+  void SweepTerm(float* const (&Imgs)[Channels], int width, int height,
+                 RowFunc&& applyRow);
+
+  BufferPool* mBufferPool = &BufferPool::GetDefault();
+
+  PoolBuffer mRowBuffer;
+
+  PoolBuffer mTermImg;
+  PoolBuffer mTermImgR;
+  PoolBuffer mTermImgG;
+  PoolBuffer mTermImgB;
 };
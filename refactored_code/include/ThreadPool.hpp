@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent pool of worker threads. The calling thread takes part in every
+// parallelFor, so a pool of N threads starts N - 1 workers.
+class ThreadPool {
+ public:
+  // aNumThreads <= 0 selects std::thread::hardware_concurrency()
+  explicit ThreadPool(int aNumThreads = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  int GetNumThreads() const { return static_cast<int>(mWorkers.size()) + 1; }
+
+  // Calls aTask(i) for every i in [aBegin, aEnd) and returns when all calls
+  // are done. Nested calls from inside a task run serially on the caller.
+  // If a task throws, the tasks not yet started are skipped and the first
+  // exception is rethrown once the running ones are done.
+  void parallelFor(int aBegin, int aEnd, const std::function<void(int)>& aTask);
+
+  // True while the calling thread runs the tasks of a parallelFor of any
+  // pool, its parallelFor calls then run serially
+  static bool IsInsidePool();
+
+ private:
+  void workerLoop();
+  void runTasks();
+
+  std::vector<std::thread> mWorkers;
+
+  // Serializes parallelFor calls coming from different external threads
+  std::mutex mSubmitMutex;
+
+  std::mutex mMutex;
+  std::condition_variable mWakeCondition;
+  std::condition_variable mDoneCondition;
+
+  // Current job, guarded by mMutex except for the atomic counters
+  const std::function<void(int)>* mTask = nullptr;
+  int mEnd = 0;
+  std::atomic<int> mNext{0};
+  int mBusyWorkers = 0;
+  std::exception_ptr mError;
+  unsigned mGeneration = 0;
+  bool mStop = false;
+};
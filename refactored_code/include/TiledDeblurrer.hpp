@@ -0,0 +1,60 @@
+#pragma once
+
+#include "IImageFile.hpp"
+#include "MotionBlurImageGenerator.hpp"
+#include "RLDeblurrer.hpp"
+
+struct DeblurParameters;
+struct DeblurResult;
+
+// Out of core deblurring of images that do not fit in memory. The image is
+// split into tiles whose cores are deblurred with a halo of their
+// neighbours, read from the blurred file, and only the cores are written to
+// the deblurred file. The memory is that of one tile with its halo.
+class TiledDeblurrer {
+ public:
+  // aMotion is the motion of the whole image
+  explicit TiledDeblurrer(const MotionBlurImageGenerator& aMotion);
+
+  ////////////////////////////////////
+  // These functions are used to set the tiles
+  ////////////////////////////////////
+  // Side of the tile cores, 512 by default
+  void SetTileSize(int aTileSize);
+  // The halo is aHaloScale times the footprint of the motion, 1 by default.
+  // Every iteration spreads the blur further, a larger halo brings the
+  // tiles closer to the deblur of the whole image.
+  void SetHaloScale(float aHaloScale);
+
+  // Largest displacement of a pixel of a width * height image by the
+  // samples of aMotion, forward or backward, in pixels
+  static float GetFootprint(const MotionBlurImageGenerator& aMotion,
+                            int width, int height);
+  int GetHalo(int width, int height) const;
+
+  // Generator of the tiles, its threads, warp maps and sparse operator are
+  // used for every tile. Its homographies are replaced by those of the
+  // motion in the coordinates of the tile.
+  MotionBlurImageGenerator& GetTileGenerator() { return mTileMotion; }
+
+  // Deblurs BlurImg into DeblurImg, of the same size and channels. Every
+  // tile starts from its blurred image and gets a regularizer of
+  // makeRegularizer. The result is that of the tile that ran the most
+  // iterations, peakBufferBytes is the peak of all tiles.
+  DeblurResult deblur(IImageFile& BlurImg, IImageFile& DeblurImg,
+                      const DeblurParameters& aParameters,
+                      const RegularizerFactory& makeRegularizer,
+                      float lambda);
+
+ private:
+  const MotionBlurImageGenerator& mMotion;
+  MotionBlurImageGenerator mTileMotion;
+
+  int mTileSize = 512;
+  float mHaloScale = 1.0f;
+
+  // Homographies of the motion for the region of width * height at (x, y)
+  // of an image of imageWidth * imageHeight
+  void SetTileHomographies(int x, int y, int width, int height,
+                           int imageWidth, int imageHeight);
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "BilinearSampler.h"
+#include "Homography.hpp"
+#include "ThreadPool.hpp"
+
+// Taps of every output pixel for every sample of a blur. The homographies of
+// a motion do not change between the iterations, with a map the blurs only
+// gather the input instead of transforming every pixel again.
+class WarpMap {
+ public:
+  // The taps of a row are computed in segments of this width, the width of
+  // the blur tiles, so an Incremental transform resyncs at the same pixels
+  // as the blur that computes the positions
+  static constexpr int kRowSegmentWidth = 1024;
+
+  WarpMap(const Homography* const* homographies, int numSamples, int iwidth,
+          int iheight, int width, int height, ThreadPool* threadPool);
+
+  // Memory of the taps of a map
+  static std::size_t GetBytes(int numSamples, int width, int height);
+  std::size_t GetBytes() const;
+
+  // Built for these samples and sizes, with the current sampler transform
+  bool Matches(const Homography* const* homographies, int numSamples,
+               int iwidth, int iheight, int width, int height) const;
+
+  int GetNumSamples() const { return static_cast<int>(mHomographies.size()); }
+
+  // Taps of the output pixels of sample i, in output pixel order
+  const WarpTap* GetTaps(int i) const {
+    return mTaps.data() + static_cast<std::size_t>(i) * mWidth * mHeight;
+  }
+
+ private:
+  std::vector<Homography> mHomographies;
+  int mIwidth;
+  int mIheight;
+  int mWidth;
+  int mHeight;
+  SamplerTransform mTransform;
+  int mResyncPixels;
+
+  std::vector<WarpTap> mTaps;
+};
@@ -6,11 +6,17 @@
 
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <string>
 #include <vector>
 
+#include "IImageFile.hpp"
+#include "MappedFile.hpp"
+
 // global I/O routines
+// The readers take 8-bit palette, 24-bit and 32-bit files, the writers write
+// 24-bit files
 std::vector<uint8_t> readBMP(const std::string& fname, int& width, int& height);
 void readBMP(const std::string& fname, std::vector<float>& fImg, int& width,
              int& height);
@@ -25,3 +31,50 @@ void writeBMPchannels(const std::string& iname, int width, int height,
                       const std::vector<float>& dataR,
                       const std::vector<float>& dataG,
                       const std::vector<float>& dataB);
+
+// BMP file mapped into memory, accessed by regions or by rows in place.
+// 8-bit palette, 24-bit and 32-bit (BI_RGB or byte aligned BI_BITFIELDS)
+// files are read, the files of a gray palette have 1 channel. Files are
+// created as 8-bit gray or 24-bit. The values are converted as
+// readBMPchannels and writeBMPchannels do.
+class BMPFile : public IImageFile {
+ public:
+  // Maps an existing file, its regions can be written if bWritable
+  explicit BMPFile(const std::string& fname, bool bWritable = false);
+  // Creates a black image of width * height, 8-bit gray for 1 channel,
+  // 24-bit for 3
+  BMPFile(const std::string& fname, int width, int height, int channels = 3);
+
+  int GetWidth() const override { return mWidth; }
+  int GetHeight() const override { return mHeight; }
+  int GetChannels() const override { return mChannels; }
+  int GetBitCount() const { return mBitCount; }
+
+  // Pixels of row y in the format of the file, GetBitCount() / 8 bytes per
+  // pixel. The rows of a writable file can be written.
+  const uint8_t* GetRow(int y) const;
+  uint8_t* GetRow(int y);
+  // (R,G,B) tuples of row y
+  void ReadRowRgb(int y, uint8_t* rgb) const;
+
+  void ReadRegion(int x, int y, const Image<float>& region) override;
+  void WriteRegion(int x, int y, const Image<const float>& region) override;
+
+ private:
+  MappedFile mFile;
+  int mWidth = 0;
+  int mHeight = 0;
+  int mChannels = 3;
+  int mBitCount = 24;
+  std::size_t mOffset = 0;
+  std::size_t mRowBytes = 0;
+  // The rows of a negative height are stored from the top
+  bool mTopDown = false;
+  // Byte of R, G and B in a pixel, or their palette entries for 8 bits
+  int mChannelOffset[3] = {2, 1, 0};
+  uint8_t mPalette[256][3]{};
+  // The gray palette of an 8-bit file maps every index to itself
+  bool mIdentityPalette = false;
+
+  void ParseHeader(const std::string& fname);
+};
@@ -0,0 +1,56 @@
+// -----------------------------------------------------
+// pnm.h
+//
+// header file for the PFM and binary PGM / PPM formats
+// -----------------------------------------------------
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "IImageFile.hpp"
+#include "MappedFile.hpp"
+
+// Sample of a PNM file: 8 or 16-bit integers of PGM / PPM, 32-bit floats
+// of PFM
+enum class PNMSample { Byte, Short, Float };
+
+// PFM, PGM (P5) or PPM (P6) file mapped into memory and accessed by
+// regions. PFM values are stored as they are, in the byte order of the
+// file. PGM / PPM values are divided by the maximum value, and written
+// clamped to [0, 1] and rounded. The rows are indexed as in the BMP files:
+// the PFM rows in the order of the file, the PGM / PPM rows from the
+// bottom, so a converted image keeps its orientation.
+class PNMFile : public IImageFile {
+ public:
+  // Maps an existing file, its regions can be written if bWritable
+  explicit PNMFile(const std::string& fname, bool bWritable = false);
+  // Creates a black image of width * height with 1 (PGM or gray PFM) or 3
+  // (PPM or color PFM) channels. The integer samples use their full range.
+  PNMFile(const std::string& fname, int width, int height, int channels,
+          PNMSample sample);
+
+  int GetWidth() const override { return mWidth; }
+  int GetHeight() const override { return mHeight; }
+  int GetChannels() const override { return mChannels; }
+  PNMSample GetSample() const { return mSample; }
+
+  void ReadRegion(int x, int y, const Image<float>& region) override;
+  void WriteRegion(int x, int y, const Image<const float>& region) override;
+
+ private:
+  MappedFile mFile;
+  int mWidth = 0;
+  int mHeight = 0;
+  int mChannels = 0;
+  PNMSample mSample = PNMSample::Byte;
+  int mMaxValue = 255;
+  // The floats of the file are in the other byte order
+  bool mSwapBytes = false;
+  std::size_t mOffset = 0;
+  std::size_t mRowBytes = 0;
+
+  void ParseHeader(const std::string& fname);
+  std::size_t GetPosition(int x, int y) const;
+};
@@ -1,6 +1,10 @@
 #pragma once
 
+#include <functional>
+
 #include "Homography.hpp"
+#include "ThreadPool.hpp"
+#include "WarpMap.hpp"
 
 void warpImageGray(float* InputImg, float* inputWeight, int iwidth, int iheight,
                    float* OutputImg, float* outputWeight, int width, int height,
@@ -10,4 +14,90 @@ void warpImageRgb(float* InputImgR, float* InputImgG, float* InputImgB,
                   float* inputWeight, int iwidth, int iheight,
                   float* OutputImgR, float* OutputImgG, float* OutputImgB,
                   float* outputWeight, int width, int height,
-                  const Homography& homography);
\ No newline at end of file
+                  const Homography& homography);
+
+// Row-tiled versions, the output rows are split into tiles which are warped
+// on threadPool. The result is the same as the serial version.
+void warpImageGray(float* InputImg, float* inputWeight, int iwidth, int iheight,
+                   float* OutputImg, float* outputWeight, int width, int height,
+                   const Homography& homography, ThreadPool& threadPool);
+
+void warpImageRgb(float* InputImgR, float* InputImgG, float* InputImgB,
+                  float* inputWeight, int iwidth, int iheight,
+                  float* OutputImgR, float* OutputImgG, float* OutputImgB,
+                  float* outputWeight, int width, int height,
+                  const Homography& homography, ThreadPool& threadPool);
+
+// Projective motion blur of the input with the sample homographies: every
+// output pixel is the weighted mean of the numSamples warped values and
+// outputWeight receives the sum of the weights. The output is processed in
+// tiles that go through all the samples before the next tile. The bounding
+// box of the input pixels read for a tile is copied once, so the input is
+// streamed about once per blur and no warped image is stored.
+// epilogue(begin, end) is called on the output pixels [begin, end) of every
+// row segment as soon as it is normalized, the segments of different tiles
+// can be processed concurrently.
+void blurImageGray(float* InputImg, float* inputWeight, int iwidth, int iheight,
+                   float* BlurImg, float* outputWeight, int width, int height,
+                   const Homography* const* homographies, int numSamples,
+                   const std::function<void(int, int)>& epilogue = {});
+
+void blurImageRgb(float* InputImgR, float* InputImgG, float* InputImgB,
+                  float* inputWeight, int iwidth, int iheight, float* BlurImgR,
+                  float* BlurImgG, float* BlurImgB, float* outputWeight,
+                  int width, int height, const Homography* const* homographies,
+                  int numSamples,
+                  const std::function<void(int, int)>& epilogue = {});
+
+// Tiles distributed on threadPool, the result is the same as the serial
+// version
+void blurImageGray(float* InputImg, float* inputWeight, int iwidth, int iheight,
+                   float* BlurImg, float* outputWeight, int width, int height,
+                   const Homography* const* homographies, int numSamples,
+                   ThreadPool& threadPool,
+                   const std::function<void(int, int)>& epilogue = {});
+
+void blurImageRgb(float* InputImgR, float* InputImgG, float* InputImgB,
+                  float* inputWeight, int iwidth, int iheight, float* BlurImgR,
+                  float* BlurImgG, float* BlurImgB, float* outputWeight,
+                  int width, int height, const Homography* const* homographies,
+                  int numSamples, ThreadPool& threadPool,
+                  const std::function<void(int, int)>& epilogue = {});
+
+// Same blurs with the taps of map, which was built for the samples and the
+// sizes of the images. The result is the same as with the homographies.
+void blurImageGray(float* InputImg, float* inputWeight, int iwidth, int iheight,
+                   float* BlurImg, float* outputWeight, int width, int height,
+                   const WarpMap& map,
+                   const std::function<void(int, int)>& epilogue = {});
+
+void blurImageRgb(float* InputImgR, float* InputImgG, float* InputImgB,
+                  float* inputWeight, int iwidth, int iheight, float* BlurImgR,
+                  float* BlurImgG, float* BlurImgB, float* outputWeight,
+                  int width, int height, const WarpMap& map,
+                  const std::function<void(int, int)>& epilogue = {});
+
+void blurImageGray(float* InputImg, float* inputWeight, int iwidth, int iheight,
+                   float* BlurImg, float* outputWeight, int width, int height,
+                   const WarpMap& map, ThreadPool& threadPool,
+                   const std::function<void(int, int)>& epilogue = {});
+
+void blurImageRgb(float* InputImgR, float* InputImgG, float* InputImgB,
+                  float* inputWeight, int iwidth, int iheight, float* BlurImgR,
+                  float* BlurImgG, float* BlurImgB, float* outputWeight,
+                  int width, int height, const WarpMap& map,
+                  ThreadPool& threadPool,
+                  const std::function<void(int, int)>& epilogue = {});
+
+// Adds the weighted samples and their weights to BlurImg and outputWeight
+// without normalizing, for blurs whose samples are split between threads
+void accumulateBlurGray(float* InputImg, float* inputWeight, int iwidth,
+                        int iheight, float* BlurImg, float* outputWeight,
+                        int width, int height,
+                        const Homography* const* homographies, int numSamples);
+
+void accumulateBlurRgb(float* InputImgR, float* InputImgG, float* InputImgB,
+                       float* inputWeight, int iwidth, int iheight,
+                       float* BlurImgR, float* BlurImgG, float* BlurImgB,
+                       float* outputWeight, int width, int height,
+                       const Homography* const* homographies, int numSamples);
@@ -7,18 +7,25 @@ BilateralLaplacianRegularizer::BilateralLaplacianRegularizer() {
   SetBilateralTable();
 }
 
-void BilateralLaplacianRegularizer::SetBuffer(int width, int height) {
+void BilateralLaplacianRegularizer::SetBuffer(int width, int height,
+                                              int channels) {
   const size_t newSize = width * height;
 
-  if (newSize <= mBilateralRegImg.size()) {
-    return;
-  }
+  if (channels == 1) {
+    if (newSize <= mBilateralRegImg.size()) {
+      return;
+    }
 
-  mBilateralRegImg.resize(newSize);
+    mBilateralRegImg.resize(newSize, *mBufferPool);
+  } else {
+    if (newSize <= mBilateralRegImgR.size()) {
+      return;
+    }
 
-  mBilateralRegImgR.resize(newSize);
-  mBilateralRegImgG.resize(newSize);
-  mBilateralRegImgB.resize(newSize);
+    mBilateralRegImgR.resize(newSize, *mBufferPool);
+    mBilateralRegImgG.resize(newSize, *mBufferPool);
+    mBilateralRegImgB.resize(newSize, *mBufferPool);
+  }
 }
 
 void BilateralLaplacianRegularizer::ClearBuffer() {
@@ -29,31 +36,33 @@ void BilateralLaplacianRegularizer::ClearBuffer() {
   mBilateralRegImgB.clear();
 }
 
+void BilateralLaplacianRegularizer::SetBufferPool(BufferPool& aPool) {
+  ClearBuffer();
+  mBufferPool = &aPool;
+}
+
 void BilateralLaplacianRegularizer::applyRegularizationGray(
     float* DeblurImg, int width, int height, bool bPoisson, float lambda) {
-  SetBuffer(width, height);
+  const float* TermImg = nullptr;
+  computeRegularizationTermGray(DeblurImg, width, height, TermImg);
+
+  regularizePlane(DeblurImg, TermImg, width * height, bPoisson, lambda);
+}
 
-  int x = 0, y = 0, index = 0;
+bool BilateralLaplacianRegularizer::computeRegularizationTermGray(
+    float* DeblurImg, int width, int height, const float*& TermImg) {
+  SetBuffer(width, height, 1);
 
   ComputeBilaterRegImageGray(DeblurImg, width, height, mBilateralRegImg.data());
 
-  for (y = 0, index = 0; y < height; y++) {  // Normalize the gradient
-    for (x = 0; x < width; x++, index++) {
-      if (bPoisson) {
-        DeblurImg[index] *= 1.0 / (1.0 + lambda * (mBilateralRegImg[index]));
-      } else {
-        DeblurImg[index] -= lambda * (mBilateralRegImg[index]);
-      }
-    }
-  }
+  TermImg = mBilateralRegImg.data();
+  return true;
 }
 
 void BilateralLaplacianRegularizer::applyRegularizationRgb(
     float* DeblurImgR, float* DeblurImgG, float* DeblurImgB, int width,
     int height, bool bPoisson, float lambda) {
-  SetBuffer(width, height);
-
-  int x = 0, y = 0, index = 0;
+  SetBuffer(width, height, 3);
 
   ComputeBilaterRegImageGray(DeblurImgR, width, height,
                              mBilateralRegImgR.data());
@@ -62,19 +71,12 @@ void BilateralLaplacianRegularizer::applyRegularizationRgb(
   ComputeBilaterRegImageGray(DeblurImgB, width, height,
                              mBilateralRegImgB.data());
 
-  for (y = 0, index = 0; y < height; y++) {
-    for (x = 0; x < width; x++, index++) {
-      if (bPoisson) {
-        DeblurImgR[index] *= 1.0 / (1.0 + lambda * (mBilateralRegImgR[index]));
-        DeblurImgG[index] *= 1.0 / (1.0 + lambda * (mBilateralRegImgG[index]));
-        DeblurImgB[index] *= 1.0 / (1.0 + lambda * (mBilateralRegImgB[index]));
-      } else {
-        DeblurImgR[index] -= lambda * (mBilateralRegImgR[index]);
-        DeblurImgG[index] -= lambda * (mBilateralRegImgG[index]);
-        DeblurImgB[index] -= lambda * (mBilateralRegImgG[index]);
-      }
-    }
-  }
+  regularizePlane(DeblurImgR, mBilateralRegImgR.data(), width * height,
+                  bPoisson, lambda);
+  regularizePlane(DeblurImgG, mBilateralRegImgG.data(), width * height,
+                  bPoisson, lambda);
+  regularizePlane(DeblurImgB, mBilateralRegImgB.data(), width * height,
+                  bPoisson, lambda);
 }
 
 void BilateralLaplacianRegularizer::ComputeBilaterRegImageGray(float* Img,
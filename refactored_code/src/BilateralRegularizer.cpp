@@ -5,18 +5,24 @@
 
 BilateralRegularizer::BilateralRegularizer() { SetBilateralTable(); }
 
-void BilateralRegularizer::SetBuffer(int width, int height) {
+void BilateralRegularizer::SetBuffer(int width, int height, int channels) {
   const size_t newSize = width * height;
 
-  if (newSize <= mBilateralRegImg.size()) {
-    return;
-  }
+  if (channels == 1) {
+    if (newSize <= mBilateralRegImg.size()) {
+      return;
+    }
 
-  mBilateralRegImg.resize(newSize);
+    mBilateralRegImg.resize(newSize, *mBufferPool);
+  } else {
+    if (newSize <= mBilateralRegImgR.size()) {
+      return;
+    }
 
-  mBilateralRegImgR.resize(newSize);
-  mBilateralRegImgG.resize(newSize);
-  mBilateralRegImgB.resize(newSize);
+    mBilateralRegImgR.resize(newSize, *mBufferPool);
+    mBilateralRegImgG.resize(newSize, *mBufferPool);
+    mBilateralRegImgB.resize(newSize, *mBufferPool);
+  }
 }
 
 void BilateralRegularizer::ClearBuffer() {
@@ -27,24 +33,28 @@ void BilateralRegularizer::ClearBuffer() {
   mBilateralRegImgB.clear();
 }
 
+void BilateralRegularizer::SetBufferPool(BufferPool& aPool) {
+  ClearBuffer();
+  mBufferPool = &aPool;
+}
+
 void BilateralRegularizer::applyRegularizationGray(float* DeblurImg, int width,
                                                    int height, bool bPoisson,
                                                    float lambda) {
-  SetBuffer(width, height);
+  const float* TermImg = nullptr;
+  computeRegularizationTermGray(DeblurImg, width, height, TermImg);
+
+  regularizePlane(DeblurImg, TermImg, width * height, bPoisson, lambda);
+}
 
-  int x = 0, y = 0, index = 0;
+bool BilateralRegularizer::computeRegularizationTermGray(
+    float* DeblurImg, int width, int height, const float*& TermImg) {
+  SetBuffer(width, height, 1);
 
   ComputeBilaterRegImageGray(DeblurImg, width, height, mBilateralRegImg.data());
 
-  for (y = 0, index = 0; y < height; y++) {  // Normalize the gradient
-    for (x = 0; x < width; x++, index++) {
-      if (bPoisson) {
-        DeblurImg[index] *= 1.0 / (1.0 + lambda * (mBilateralRegImg[index]));
-      } else {
-        DeblurImg[index] -= lambda * (mBilateralRegImg[index]);
-      }
-    }
-  }
+  TermImg = mBilateralRegImg.data();
+  return true;
 }
 
 void BilateralRegularizer::applyRegularizationRgb(float* DeblurImgR,
@@ -52,9 +62,7 @@ void BilateralRegularizer::applyRegularizationRgb(float* DeblurImgR,
                                                   float* DeblurImgB, int width,
                                                   int height, bool bPoisson,
                                                   float lambda) {
-  SetBuffer(width, height);
-
-  int x = 0, y = 0, index = 0;
+  SetBuffer(width, height, 3);
 
   ComputeBilaterRegImageGray(DeblurImgR, width, height,
                              mBilateralRegImgR.data());
@@ -63,19 +71,12 @@ void BilateralRegularizer::applyRegularizationRgb(float* DeblurImgR,
   ComputeBilaterRegImageGray(DeblurImgB, width, height,
                              mBilateralRegImgB.data());
 
-  for (y = 0, index = 0; y < height; y++) {
-    for (x = 0; x < width; x++, index++) {
-      if (bPoisson) {
-        DeblurImgR[index] *= 1.0 / (1.0 + lambda * (mBilateralRegImgR[index]));
-        DeblurImgG[index] *= 1.0 / (1.0 + lambda * (mBilateralRegImgG[index]));
-        DeblurImgB[index] *= 1.0 / (1.0 + lambda * (mBilateralRegImgB[index]));
-      } else {
-        DeblurImgR[index] -= lambda * (mBilateralRegImgR[index]);
-        DeblurImgG[index] -= lambda * (mBilateralRegImgG[index]);
-        DeblurImgB[index] -= lambda * (mBilateralRegImgG[index]);
-      }
-    }
-  }
+  regularizePlane(DeblurImgR, mBilateralRegImgR.data(), width * height,
+                  bPoisson, lambda);
+  regularizePlane(DeblurImgG, mBilateralRegImgG.data(), width * height,
+                  bPoisson, lambda);
+  regularizePlane(DeblurImgB, mBilateralRegImgB.data(), width * height,
+                  bPoisson, lambda);
 }
 
 void BilateralRegularizer::ComputeBilaterRegImageGray(float* Img, int width,
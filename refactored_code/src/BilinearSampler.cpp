@@ -0,0 +1,1206 @@
+#include "BilinearSampler.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || \
+    defined(_M_IX86)
+#define SAMPLER_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define SAMPLER_NEON 1
+#include <arm_neon.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define SAMPLER_TARGET(isa) __attribute__((target(isa)))
+#else
+#define SAMPLER_TARGET(isa)
+#endif
+
+namespace {
+
+struct RowArgs {
+  const float* input[3];
+  const float* inputWeight;
+  float* output[3];
+  float* outputWeight;
+  int iwidth;
+  int iheight;
+  int width;
+  int height;
+  const Homography* homography;
+  int y;
+  SamplerTransform transform;
+  int resyncPixels;
+  // Adds value * weight and weight to the outputs instead of storing them
+  bool accumulate;
+  // Layout of the input buffers: the input pixel (x, y) is at
+  // y * stride + x - origin. Masked lanes read the window corner
+  // (windowX, windowY).
+  int stride;
+  int origin;
+  float windowX;
+  float windowY;
+};
+
+// Per row constants. The products with the row coordinate are computed once,
+// every kernel evaluates the remaining terms in the order of
+// Homography::Transform so all kernels give the same result.
+struct RowSetup {
+  explicit RowSetup(const RowArgs& a) {
+    const auto& H = a.homography->Hmatrix;
+    h00 = H[0][0];
+    h02 = H[0][2];
+    h10 = H[1][0];
+    h12 = H[1][2];
+    h20 = H[2][0];
+    h22 = H[2][2];
+    fy = a.y - a.height * 0.5f;
+    h01fy = H[0][1] * fy;
+    h11fy = H[1][1] * fy;
+    h21fy = H[2][1] * fy;
+    woffset = a.width * 0.5f;
+    iwoffset = a.iwidth * 0.5f;
+    ihoffset = a.iheight * 0.5f;
+    xLimit = static_cast<float>(a.iwidth - 1);
+    yLimit = static_cast<float>(a.iheight - 1);
+    xClamp = a.iwidth - 1.001f;
+    yClamp = a.iheight - 1.001f;
+
+    incremental = a.transform == SamplerTransform::Incremental;
+    resyncPixels = a.resyncPixels;
+    affine = H[2][0] == 0 && H[2][1] == 0;
+    rz = 1.0f / (h21fy + h22);
+  }
+
+  float h00, h02, h10, h12, h20, h22;
+  float fy, h01fy, h11fy, h21fy;
+  float woffset, iwoffset, ihoffset;
+  float xLimit, yLimit, xClamp, yClamp;
+
+  // SamplerTransform::Incremental: the numerators and the denominator are
+  // stepped along the row and recomputed every resyncPixels pixels. For an
+  // affine homography the denominator is the constant 1 / rz.
+  bool incremental;
+  int resyncPixels;
+  bool affine;
+  float rz;
+};
+
+inline float interpolate(const float* img, int stride, int origin, float x,
+                         float y) {
+  const int ix = (int)(x), iy = (int)(y);
+  const int index = iy * stride + ix - origin;
+  const float fx = x - ix, fy = y - iy;
+  const float w1 = (1.0f - fx) * fy;
+  const float w2 = fx * (1.0f - fy);
+  const float w3 = fx * fy;
+  const float w0 = 1.0f - w1 - w2 - w3;
+
+  return img[index] * w0 + img[index + stride] * w1 + img[index + 1] * w2 +
+         img[index + stride + 1] * w3;
+}
+
+// Numerators and denominator of the projective transform, stepped along a row
+// in SamplerTransform::Incremental mode
+struct RowStep {
+  float nx = 0, ny = 0, nz = 0;
+  int nextExact = 0;
+};
+
+inline void coordsScalar(const RowSetup& s, int x, int xBegin,
+                         RowStep& st, float& fx, float& fy) {
+  if (s.incremental && x != xBegin && x != st.nextExact) {
+    st.nx += s.h00;
+    st.ny += s.h10;
+    st.nz += s.h20;
+  } else {
+    const float px = x - s.woffset;
+    st.nx = s.h00 * px + s.h01fy + s.h02;
+    st.ny = s.h10 * px + s.h11fy + s.h12;
+    st.nz = s.h20 * px + s.h21fy + s.h22;
+    st.nextExact = x + s.resyncPixels;
+  }
+
+  if (!s.incremental) {
+    fx = st.nx / st.nz + s.iwoffset;
+    fy = st.ny / st.nz + s.ihoffset;
+  } else {
+    const float r = s.affine ? s.rz : 1.0f / st.nz;
+    fx = st.nx * r + s.iwoffset;
+    fy = st.ny * r + s.ihoffset;
+  }
+}
+
+// Distance of the interior positions from the clamped bounds, in input
+// pixels. Covers the float error of the positions and the drift of the
+// incremental transform.
+constexpr double kInteriorMargin = 0.05;
+
+// Pixels [xIn0, xIn1) of [xBegin, xEnd) whose positions are inside the
+// clamped bounds [0, xClamp] x [0, yClamp] by kInteriorMargin. Along the row
+// the numerators and the denominator of the homography are linear in x, so
+// with a positive denominator every bound is a half line and the interior
+// is their intersection. The span is aligned to the resync interval, or to
+// the widest vector, from xBegin: the kernels then compute the same
+// positions as over the whole segment. An empty span is at xEnd.
+void interiorSpan(const RowSetup& s, int xBegin, int xEnd, int& xIn0,
+                  int& xIn1) {
+  // N(x) = h x + c of the numerators and the denominator
+  const double hx = s.h00, cx = s.h01fy + s.h02 - s.h00 * s.woffset;
+  const double hy = s.h10, cy = s.h11fy + s.h12 - s.h10 * s.woffset;
+  const double hz = s.h20, cz = s.h21fy + s.h22 - s.h20 * s.woffset;
+
+  double lo = xBegin, hi = xEnd - 1;
+  // Keeps the x where h * x + c >= 0
+  const auto clip = [&lo, &hi](double h, double c) {
+    if (h > 0) {
+      lo = std::max(lo, -c / h);
+    } else if (h < 0) {
+      hi = std::min(hi, -c / h);
+    } else if (c < 0) {
+      hi = lo - 1;
+    }
+  };
+  clip(hz, cz - 1e-6);
+  // bound <= Nx / Nz + offset <= limit, multiplied by Nz > 0
+  const auto clipCoordinate = [&](double h, double c, double offset,
+                                  double limit) {
+    const double low = kInteriorMargin - offset;
+    const double high = limit - kInteriorMargin - offset;
+    clip(h - low * hz, c - low * cz);
+    clip(high * hz - h, high * cz - c);
+  };
+  clipCoordinate(hx, cx, s.iwoffset, s.xClamp);
+  clipCoordinate(hy, cy, s.ihoffset, s.yClamp);
+
+  const int align = s.incremental ? s.resyncPixels : 16;
+  xIn0 = xIn1 = xEnd;
+  if (lo > hi) return;
+  const int first = static_cast<int>(std::ceil(lo)) - xBegin;
+  const int last = static_cast<int>(std::floor(hi)) + 1 - xBegin;
+  const int begin = xBegin + (first + align - 1) / align * align;
+  const int end = xBegin + last / align * align;
+  if (begin < end) {
+    xIn0 = begin;
+    xIn1 = end;
+  }
+}
+
+// Reference implementation, also used for the tails of the vector kernels.
+// Interior: the positions of the pixels are inside the input, see
+// interiorSpan, and are neither tested nor clamped.
+template <int NumPlanes, bool Interior = false>
+void samplePixels(const RowArgs& a, const RowSetup& s, int xBegin, int xEnd) {
+  RowStep step;
+  for (int x = xBegin, index = a.y * a.width + xBegin; x < xEnd;
+       x++, index++) {
+    float fx, fy;
+    coordsScalar(s, x, xBegin, step, fx, fy);
+
+    float weight = 0.01f;
+    if (Interior || (fx >= 0 && fx < s.xLimit && fy >= 0 && fy < s.yLimit)) {
+      if (a.inputWeight) {
+        weight = 0.01f + interpolate(a.inputWeight, a.stride, a.origin, fx, fy);
+      } else {
+        weight = 1.01f;
+      }
+    }
+
+    if constexpr (!Interior) {
+      if (fx < 0) fx = 0;
+      if (fy < 0) fy = 0;
+      if (fx >= s.xClamp) fx = s.xClamp;
+      if (fy >= s.yClamp) fy = s.yClamp;
+    }
+
+    if (a.accumulate) {
+      for (int c = 0; c < NumPlanes; c++) {
+        a.output[c][index] +=
+            interpolate(a.input[c], a.stride, a.origin, fx, fy) * weight;
+      }
+      a.outputWeight[index] += weight;
+    } else {
+      for (int c = 0; c < NumPlanes; c++) {
+        a.output[c][index] =
+            interpolate(a.input[c], a.stride, a.origin, fx, fy);
+      }
+      a.outputWeight[index] = weight;
+    }
+  }
+}
+
+#if SAMPLER_X86
+
+////////////////////////////////////
+// SSE4.1: 4 pixels per step, the taps are loaded one by one
+////////////////////////////////////
+struct RowStepSse41 {
+  __m128 nx{}, ny{}, nz{};
+  int nextExact = 0;
+};
+
+struct Taps4 {
+  alignas(16) int index[4];
+  __m128 w0, w1, w2, w3;
+};
+
+SAMPLER_TARGET("sse4.1")
+inline void tapsSse41(__m128 x, __m128 y, int stride, int origin, Taps4& t) {
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128i ix = _mm_cvttps_epi32(x), iy = _mm_cvttps_epi32(y);
+  const __m128 fx = _mm_sub_ps(x, _mm_cvtepi32_ps(ix));
+  const __m128 fy = _mm_sub_ps(y, _mm_cvtepi32_ps(iy));
+  t.w1 = _mm_mul_ps(_mm_sub_ps(one, fx), fy);
+  t.w2 = _mm_mul_ps(fx, _mm_sub_ps(one, fy));
+  t.w3 = _mm_mul_ps(fx, fy);
+  t.w0 = _mm_sub_ps(_mm_sub_ps(_mm_sub_ps(one, t.w1), t.w2), t.w3);
+  _mm_store_si128(
+      reinterpret_cast<__m128i*>(t.index),
+      _mm_sub_epi32(
+          _mm_add_epi32(_mm_mullo_epi32(iy, _mm_set1_epi32(stride)), ix),
+          _mm_set1_epi32(origin)));
+}
+
+SAMPLER_TARGET("sse4.1")
+inline __m128 gatherSse41(const float* img, const Taps4& t, int offset) {
+  return _mm_setr_ps(img[t.index[0] + offset], img[t.index[1] + offset],
+                     img[t.index[2] + offset], img[t.index[3] + offset]);
+}
+
+SAMPLER_TARGET("sse4.1")
+inline __m128 interpolateSse41(const float* img, const Taps4& t, int width) {
+  const __m128 v0 = _mm_mul_ps(gatherSse41(img, t, 0), t.w0);
+  const __m128 v1 = _mm_mul_ps(gatherSse41(img, t, width), t.w1);
+  const __m128 v2 = _mm_mul_ps(gatherSse41(img, t, 1), t.w2);
+  const __m128 v3 = _mm_mul_ps(gatherSse41(img, t, width + 1), t.w3);
+  return _mm_add_ps(_mm_add_ps(_mm_add_ps(v0, v1), v2), v3);
+}
+
+SAMPLER_TARGET("sse4.1")
+inline void coordsSse41(const RowSetup& s, int x, int xBegin,
+                        RowStepSse41& st, __m128& fx, __m128& fy) {
+  if (s.incremental && x != xBegin && x != st.nextExact) {
+    st.nx = _mm_add_ps(st.nx, _mm_set1_ps(s.h00 * 4));
+    st.ny = _mm_add_ps(st.ny, _mm_set1_ps(s.h10 * 4));
+    st.nz = _mm_add_ps(st.nz, _mm_set1_ps(s.h20 * 4));
+  } else {
+    const __m128 px = _mm_sub_ps(
+        _mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(x),
+                                      _mm_setr_epi32(0, 1, 2, 3))),
+        _mm_set1_ps(s.woffset));
+    st.nx = _mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(_mm_set1_ps(s.h00), px), _mm_set1_ps(s.h01fy)),
+        _mm_set1_ps(s.h02));
+    st.ny = _mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(_mm_set1_ps(s.h10), px), _mm_set1_ps(s.h11fy)),
+        _mm_set1_ps(s.h12));
+    st.nz = _mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(_mm_set1_ps(s.h20), px), _mm_set1_ps(s.h21fy)),
+        _mm_set1_ps(s.h22));
+    st.nextExact = x + s.resyncPixels;
+  }
+
+  if (!s.incremental) {
+    fx = _mm_add_ps(_mm_div_ps(st.nx, st.nz), _mm_set1_ps(s.iwoffset));
+    fy = _mm_add_ps(_mm_div_ps(st.ny, st.nz), _mm_set1_ps(s.ihoffset));
+  } else {
+    const __m128 r = s.affine ? _mm_set1_ps(s.rz)
+                              : _mm_div_ps(_mm_set1_ps(1.0f), st.nz);
+    fx = _mm_add_ps(_mm_mul_ps(st.nx, r), _mm_set1_ps(s.iwoffset));
+    fy = _mm_add_ps(_mm_mul_ps(st.ny, r), _mm_set1_ps(s.ihoffset));
+  }
+}
+
+// Weight of the pixels, the minimum one outside the input, and the taps of
+// their positions clamped to the input
+SAMPLER_TARGET("sse4.1")
+inline __m128 borderTapsSse41(const RowArgs& a, const RowSetup& s, __m128 fx,
+                              __m128 fy, Taps4& taps) {
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 valid = _mm_and_ps(
+      _mm_and_ps(_mm_cmpge_ps(fx, zero),
+                 _mm_cmplt_ps(fx, _mm_set1_ps(s.xLimit))),
+      _mm_and_ps(_mm_cmpge_ps(fy, zero),
+                 _mm_cmplt_ps(fy, _mm_set1_ps(s.yLimit))));
+  __m128 weight;
+  if (a.inputWeight) {
+    tapsSse41(_mm_blendv_ps(_mm_set1_ps(a.windowX), fx, valid),
+              _mm_blendv_ps(_mm_set1_ps(a.windowY), fy, valid), a.stride,
+              a.origin, taps);
+    weight = _mm_add_ps(_mm_set1_ps(0.01f),
+                        interpolateSse41(a.inputWeight, taps, a.stride));
+    weight = _mm_blendv_ps(_mm_set1_ps(0.01f), weight, valid);
+  } else {
+    weight = _mm_blendv_ps(_mm_set1_ps(0.01f), _mm_set1_ps(1.01f), valid);
+  }
+
+  fx = _mm_blendv_ps(fx, zero, _mm_cmplt_ps(fx, zero));
+  fy = _mm_blendv_ps(fy, zero, _mm_cmplt_ps(fy, zero));
+  const __m128 xClamp = _mm_set1_ps(s.xClamp);
+  const __m128 yClamp = _mm_set1_ps(s.yClamp);
+  fx = _mm_blendv_ps(fx, xClamp, _mm_cmpge_ps(fx, xClamp));
+  fy = _mm_blendv_ps(fy, yClamp, _mm_cmpge_ps(fy, yClamp));
+
+  tapsSse41(fx, fy, a.stride, a.origin, taps);
+  return weight;
+}
+
+// Same for pixels inside the input, without bounds tests and clamps. The
+// weight has the taps of the value.
+SAMPLER_TARGET("sse4.1")
+inline __m128 interiorTapsSse41(const RowArgs& a, __m128 fx, __m128 fy,
+                                Taps4& taps) {
+  tapsSse41(fx, fy, a.stride, a.origin, taps);
+  if (!a.inputWeight) return _mm_set1_ps(1.01f);
+  return _mm_add_ps(_mm_set1_ps(0.01f),
+                    interpolateSse41(a.inputWeight, taps, a.stride));
+}
+
+template <int NumPlanes, bool Interior>
+SAMPLER_TARGET("sse4.1")
+void sampleRowSse41(const RowArgs& a, const RowSetup& s, int xBegin,
+                    int xEnd) {
+  RowStepSse41 step;
+  Taps4 taps;
+
+  int x = xBegin;
+  for (; x + 4 <= xEnd; x += 4) {
+    const int index = a.y * a.width + x;
+    __m128 fx, fy;
+    coordsSse41(s, x, xBegin, step, fx, fy);
+
+    __m128 weight = Interior ? interiorTapsSse41(a, fx, fy, taps)
+                             : borderTapsSse41(a, s, fx, fy, taps);
+    if (a.accumulate) {
+      for (int c = 0; c < NumPlanes; c++) {
+        const __m128 value = interpolateSse41(a.input[c], taps, a.stride);
+        _mm_storeu_ps(a.output[c] + index,
+                      _mm_add_ps(_mm_loadu_ps(a.output[c] + index),
+                                 _mm_mul_ps(value, weight)));
+      }
+      weight = _mm_add_ps(_mm_loadu_ps(a.outputWeight + index), weight);
+    } else {
+      for (int c = 0; c < NumPlanes; c++) {
+        _mm_storeu_ps(a.output[c] + index,
+                      interpolateSse41(a.input[c], taps, a.stride));
+      }
+    }
+    _mm_storeu_ps(a.outputWeight + index, weight);
+  }
+
+  samplePixels<NumPlanes, Interior>(a, s, x, xEnd);
+}
+
+////////////////////////////////////
+// AVX2: 8 pixels per step, the taps are gathered
+////////////////////////////////////
+struct RowStepAvx2 {
+  __m256 nx{}, ny{}, nz{};
+  int nextExact = 0;
+};
+
+struct Taps8 {
+  __m256i index;
+  __m256 w0, w1, w2, w3;
+};
+
+SAMPLER_TARGET("avx2")
+inline void tapsAvx2(__m256 x, __m256 y, int stride, int origin, Taps8& t) {
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256i ix = _mm256_cvttps_epi32(x), iy = _mm256_cvttps_epi32(y);
+  const __m256 fx = _mm256_sub_ps(x, _mm256_cvtepi32_ps(ix));
+  const __m256 fy = _mm256_sub_ps(y, _mm256_cvtepi32_ps(iy));
+  t.w1 = _mm256_mul_ps(_mm256_sub_ps(one, fx), fy);
+  t.w2 = _mm256_mul_ps(fx, _mm256_sub_ps(one, fy));
+  t.w3 = _mm256_mul_ps(fx, fy);
+  t.w0 = _mm256_sub_ps(_mm256_sub_ps(_mm256_sub_ps(one, t.w1), t.w2), t.w3);
+  t.index = _mm256_sub_epi32(
+      _mm256_add_epi32(_mm256_mullo_epi32(iy, _mm256_set1_epi32(stride)), ix),
+      _mm256_set1_epi32(origin));
+}
+
+SAMPLER_TARGET("avx2")
+inline __m256 interpolateAvx2(const float* img, const Taps8& t, int width) {
+  const __m256 v0 =
+      _mm256_mul_ps(_mm256_i32gather_ps(img, t.index, 4), t.w0);
+  const __m256 v1 =
+      _mm256_mul_ps(_mm256_i32gather_ps(img + width, t.index, 4), t.w1);
+  const __m256 v2 =
+      _mm256_mul_ps(_mm256_i32gather_ps(img + 1, t.index, 4), t.w2);
+  const __m256 v3 =
+      _mm256_mul_ps(_mm256_i32gather_ps(img + width + 1, t.index, 4), t.w3);
+  return _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(v0, v1), v2), v3);
+}
+
+SAMPLER_TARGET("avx2")
+inline void coordsAvx2(const RowSetup& s, int x, int xBegin,
+                       RowStepAvx2& st, __m256& fx, __m256& fy) {
+  if (s.incremental && x != xBegin && x != st.nextExact) {
+    st.nx = _mm256_add_ps(st.nx, _mm256_set1_ps(s.h00 * 8));
+    st.ny = _mm256_add_ps(st.ny, _mm256_set1_ps(s.h10 * 8));
+    st.nz = _mm256_add_ps(st.nz, _mm256_set1_ps(s.h20 * 8));
+  } else {
+    const __m256 px = _mm256_sub_ps(
+        _mm256_cvtepi32_ps(_mm256_add_epi32(
+            _mm256_set1_epi32(x), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7))),
+        _mm256_set1_ps(s.woffset));
+    st.nx = _mm256_add_ps(
+        _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(s.h00), px),
+                      _mm256_set1_ps(s.h01fy)),
+        _mm256_set1_ps(s.h02));
+    st.ny = _mm256_add_ps(
+        _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(s.h10), px),
+                      _mm256_set1_ps(s.h11fy)),
+        _mm256_set1_ps(s.h12));
+    st.nz = _mm256_add_ps(
+        _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(s.h20), px),
+                      _mm256_set1_ps(s.h21fy)),
+        _mm256_set1_ps(s.h22));
+    st.nextExact = x + s.resyncPixels;
+  }
+
+  if (!s.incremental) {
+    fx = _mm256_add_ps(_mm256_div_ps(st.nx, st.nz), _mm256_set1_ps(s.iwoffset));
+    fy = _mm256_add_ps(_mm256_div_ps(st.ny, st.nz), _mm256_set1_ps(s.ihoffset));
+  } else {
+    const __m256 r = s.affine ? _mm256_set1_ps(s.rz)
+                              : _mm256_div_ps(_mm256_set1_ps(1.0f), st.nz);
+    fx = _mm256_add_ps(_mm256_mul_ps(st.nx, r), _mm256_set1_ps(s.iwoffset));
+    fy = _mm256_add_ps(_mm256_mul_ps(st.ny, r), _mm256_set1_ps(s.ihoffset));
+  }
+}
+
+SAMPLER_TARGET("avx2")
+inline __m256 borderTapsAvx2(const RowArgs& a, const RowSetup& s, __m256 fx,
+                             __m256 fy, Taps8& taps) {
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 valid = _mm256_and_ps(
+      _mm256_and_ps(_mm256_cmp_ps(fx, zero, _CMP_GE_OQ),
+                    _mm256_cmp_ps(fx, _mm256_set1_ps(s.xLimit), _CMP_LT_OQ)),
+      _mm256_and_ps(
+          _mm256_cmp_ps(fy, zero, _CMP_GE_OQ),
+          _mm256_cmp_ps(fy, _mm256_set1_ps(s.yLimit), _CMP_LT_OQ)));
+  __m256 weight;
+  if (a.inputWeight) {
+    tapsAvx2(_mm256_blendv_ps(_mm256_set1_ps(a.windowX), fx, valid),
+             _mm256_blendv_ps(_mm256_set1_ps(a.windowY), fy, valid),
+             a.stride, a.origin, taps);
+    weight = _mm256_add_ps(_mm256_set1_ps(0.01f),
+                           interpolateAvx2(a.inputWeight, taps, a.stride));
+    weight = _mm256_blendv_ps(_mm256_set1_ps(0.01f), weight, valid);
+  } else {
+    weight = _mm256_blendv_ps(_mm256_set1_ps(0.01f), _mm256_set1_ps(1.01f),
+                              valid);
+  }
+
+  fx = _mm256_blendv_ps(fx, zero, _mm256_cmp_ps(fx, zero, _CMP_LT_OQ));
+  fy = _mm256_blendv_ps(fy, zero, _mm256_cmp_ps(fy, zero, _CMP_LT_OQ));
+  const __m256 xClamp = _mm256_set1_ps(s.xClamp);
+  const __m256 yClamp = _mm256_set1_ps(s.yClamp);
+  fx = _mm256_blendv_ps(fx, xClamp, _mm256_cmp_ps(fx, xClamp, _CMP_GE_OQ));
+  fy = _mm256_blendv_ps(fy, yClamp, _mm256_cmp_ps(fy, yClamp, _CMP_GE_OQ));
+
+  tapsAvx2(fx, fy, a.stride, a.origin, taps);
+  return weight;
+}
+
+SAMPLER_TARGET("avx2")
+inline __m256 interiorTapsAvx2(const RowArgs& a, __m256 fx, __m256 fy,
+                               Taps8& taps) {
+  tapsAvx2(fx, fy, a.stride, a.origin, taps);
+  if (!a.inputWeight) return _mm256_set1_ps(1.01f);
+  return _mm256_add_ps(_mm256_set1_ps(0.01f),
+                       interpolateAvx2(a.inputWeight, taps, a.stride));
+}
+
+template <int NumPlanes, bool Interior>
+SAMPLER_TARGET("avx2")
+void sampleRowAvx2(const RowArgs& a, const RowSetup& s, int xBegin,
+                   int xEnd) {
+  RowStepAvx2 step;
+  Taps8 taps;
+
+  int x = xBegin;
+  for (; x + 8 <= xEnd; x += 8) {
+    const int index = a.y * a.width + x;
+    __m256 fx, fy;
+    coordsAvx2(s, x, xBegin, step, fx, fy);
+
+    __m256 weight = Interior ? interiorTapsAvx2(a, fx, fy, taps)
+                             : borderTapsAvx2(a, s, fx, fy, taps);
+    if (a.accumulate) {
+      for (int c = 0; c < NumPlanes; c++) {
+        const __m256 value = interpolateAvx2(a.input[c], taps, a.stride);
+        _mm256_storeu_ps(a.output[c] + index,
+                         _mm256_add_ps(_mm256_loadu_ps(a.output[c] + index),
+                                       _mm256_mul_ps(value, weight)));
+      }
+      weight = _mm256_add_ps(_mm256_loadu_ps(a.outputWeight + index), weight);
+    } else {
+      for (int c = 0; c < NumPlanes; c++) {
+        _mm256_storeu_ps(a.output[c] + index,
+                         interpolateAvx2(a.input[c], taps, a.stride));
+      }
+    }
+    _mm256_storeu_ps(a.outputWeight + index, weight);
+  }
+
+  samplePixels<NumPlanes, Interior>(a, s, x, xEnd);
+}
+
+////////////////////////////////////
+// AVX-512: 16 pixels per step, the taps are gathered
+////////////////////////////////////
+#if defined(__GNUC__) && !defined(__clang__)
+// GCC 12 warns about the _mm512_undefined_* used inside the intrinsics
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+struct RowStepAvx512 {
+  __m512 nx{}, ny{}, nz{};
+  int nextExact = 0;
+};
+
+struct Taps16 {
+  __m512i index;
+  __m512 w0, w1, w2, w3;
+};
+
+SAMPLER_TARGET("avx512f")
+inline void tapsAvx512(__m512 x, __m512 y, int stride, int origin, Taps16& t) {
+  const __m512 one = _mm512_set1_ps(1.0f);
+  const __m512i ix = _mm512_cvttps_epi32(x), iy = _mm512_cvttps_epi32(y);
+  const __m512 fx = _mm512_sub_ps(x, _mm512_cvtepi32_ps(ix));
+  const __m512 fy = _mm512_sub_ps(y, _mm512_cvtepi32_ps(iy));
+  t.w1 = _mm512_mul_ps(_mm512_sub_ps(one, fx), fy);
+  t.w2 = _mm512_mul_ps(fx, _mm512_sub_ps(one, fy));
+  t.w3 = _mm512_mul_ps(fx, fy);
+  t.w0 = _mm512_sub_ps(_mm512_sub_ps(_mm512_sub_ps(one, t.w1), t.w2), t.w3);
+  t.index = _mm512_sub_epi32(
+      _mm512_add_epi32(_mm512_mullo_epi32(iy, _mm512_set1_epi32(stride)), ix),
+      _mm512_set1_epi32(origin));
+}
+
+SAMPLER_TARGET("avx512f")
+inline __m512 interpolateAvx512(const float* img, const Taps16& t, int width) {
+  const __m512 v0 =
+      _mm512_mul_ps(_mm512_i32gather_ps(t.index, img, 4), t.w0);
+  const __m512 v1 =
+      _mm512_mul_ps(_mm512_i32gather_ps(t.index, img + width, 4), t.w1);
+  const __m512 v2 =
+      _mm512_mul_ps(_mm512_i32gather_ps(t.index, img + 1, 4), t.w2);
+  const __m512 v3 =
+      _mm512_mul_ps(_mm512_i32gather_ps(t.index, img + width + 1, 4), t.w3);
+  return _mm512_add_ps(_mm512_add_ps(_mm512_add_ps(v0, v1), v2), v3);
+}
+
+SAMPLER_TARGET("avx512f")
+inline void coordsAvx512(const RowSetup& s, int x, int xBegin,
+                         RowStepAvx512& st, __m512& fx, __m512& fy) {
+  if (s.incremental && x != xBegin && x != st.nextExact) {
+    st.nx = _mm512_add_ps(st.nx, _mm512_set1_ps(s.h00 * 16));
+    st.ny = _mm512_add_ps(st.ny, _mm512_set1_ps(s.h10 * 16));
+    st.nz = _mm512_add_ps(st.nz, _mm512_set1_ps(s.h20 * 16));
+  } else {
+    const __m512 px = _mm512_sub_ps(
+        _mm512_cvtepi32_ps(_mm512_add_epi32(
+            _mm512_set1_epi32(x),
+            _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14,
+                              15))),
+        _mm512_set1_ps(s.woffset));
+    st.nx = _mm512_add_ps(
+        _mm512_add_ps(_mm512_mul_ps(_mm512_set1_ps(s.h00), px),
+                      _mm512_set1_ps(s.h01fy)),
+        _mm512_set1_ps(s.h02));
+    st.ny = _mm512_add_ps(
+        _mm512_add_ps(_mm512_mul_ps(_mm512_set1_ps(s.h10), px),
+                      _mm512_set1_ps(s.h11fy)),
+        _mm512_set1_ps(s.h12));
+    st.nz = _mm512_add_ps(
+        _mm512_add_ps(_mm512_mul_ps(_mm512_set1_ps(s.h20), px),
+                      _mm512_set1_ps(s.h21fy)),
+        _mm512_set1_ps(s.h22));
+    st.nextExact = x + s.resyncPixels;
+  }
+
+  if (!s.incremental) {
+    fx = _mm512_add_ps(_mm512_div_ps(st.nx, st.nz), _mm512_set1_ps(s.iwoffset));
+    fy = _mm512_add_ps(_mm512_div_ps(st.ny, st.nz), _mm512_set1_ps(s.ihoffset));
+  } else {
+    const __m512 r = s.affine ? _mm512_set1_ps(s.rz)
+                              : _mm512_div_ps(_mm512_set1_ps(1.0f), st.nz);
+    fx = _mm512_add_ps(_mm512_mul_ps(st.nx, r), _mm512_set1_ps(s.iwoffset));
+    fy = _mm512_add_ps(_mm512_mul_ps(st.ny, r), _mm512_set1_ps(s.ihoffset));
+  }
+}
+
+SAMPLER_TARGET("avx512f")
+inline __m512 borderTapsAvx512(const RowArgs& a, const RowSetup& s, __m512 fx,
+                               __m512 fy, Taps16& taps) {
+  const __m512 zero = _mm512_setzero_ps();
+  const __mmask16 valid =
+      _mm512_cmp_ps_mask(fx, zero, _CMP_GE_OQ) &
+      _mm512_cmp_ps_mask(fx, _mm512_set1_ps(s.xLimit), _CMP_LT_OQ) &
+      _mm512_cmp_ps_mask(fy, zero, _CMP_GE_OQ) &
+      _mm512_cmp_ps_mask(fy, _mm512_set1_ps(s.yLimit), _CMP_LT_OQ);
+  __m512 weight;
+  if (a.inputWeight) {
+    tapsAvx512(_mm512_mask_blend_ps(valid, _mm512_set1_ps(a.windowX), fx),
+               _mm512_mask_blend_ps(valid, _mm512_set1_ps(a.windowY), fy),
+               a.stride, a.origin, taps);
+    weight = _mm512_add_ps(_mm512_set1_ps(0.01f),
+                           interpolateAvx512(a.inputWeight, taps, a.stride));
+    weight = _mm512_mask_blend_ps(valid, _mm512_set1_ps(0.01f), weight);
+  } else {
+    weight = _mm512_mask_blend_ps(valid, _mm512_set1_ps(0.01f),
+                                  _mm512_set1_ps(1.01f));
+  }
+
+  fx = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(fx, zero, _CMP_LT_OQ), fx,
+                            zero);
+  fy = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(fy, zero, _CMP_LT_OQ), fy,
+                            zero);
+  const __m512 xClamp = _mm512_set1_ps(s.xClamp);
+  const __m512 yClamp = _mm512_set1_ps(s.yClamp);
+  fx = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(fx, xClamp, _CMP_GE_OQ), fx,
+                            xClamp);
+  fy = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(fy, yClamp, _CMP_GE_OQ), fy,
+                            yClamp);
+
+  tapsAvx512(fx, fy, a.stride, a.origin, taps);
+  return weight;
+}
+
+SAMPLER_TARGET("avx512f")
+inline __m512 interiorTapsAvx512(const RowArgs& a, __m512 fx, __m512 fy,
+                                 Taps16& taps) {
+  tapsAvx512(fx, fy, a.stride, a.origin, taps);
+  if (!a.inputWeight) return _mm512_set1_ps(1.01f);
+  return _mm512_add_ps(_mm512_set1_ps(0.01f),
+                       interpolateAvx512(a.inputWeight, taps, a.stride));
+}
+
+template <int NumPlanes, bool Interior>
+SAMPLER_TARGET("avx512f")
+void sampleRowAvx512(const RowArgs& a, const RowSetup& s, int xBegin,
+                     int xEnd) {
+  RowStepAvx512 step;
+  Taps16 taps;
+
+  int x = xBegin;
+  for (; x + 16 <= xEnd; x += 16) {
+    const int index = a.y * a.width + x;
+    __m512 fx, fy;
+    coordsAvx512(s, x, xBegin, step, fx, fy);
+
+    __m512 weight = Interior ? interiorTapsAvx512(a, fx, fy, taps)
+                             : borderTapsAvx512(a, s, fx, fy, taps);
+    if (a.accumulate) {
+      for (int c = 0; c < NumPlanes; c++) {
+        const __m512 value = interpolateAvx512(a.input[c], taps, a.stride);
+        _mm512_storeu_ps(a.output[c] + index,
+                         _mm512_add_ps(_mm512_loadu_ps(a.output[c] + index),
+                                       _mm512_mul_ps(value, weight)));
+      }
+      weight = _mm512_add_ps(_mm512_loadu_ps(a.outputWeight + index), weight);
+    } else {
+      for (int c = 0; c < NumPlanes; c++) {
+        _mm512_storeu_ps(a.output[c] + index,
+                         interpolateAvx512(a.input[c], taps, a.stride));
+      }
+    }
+    _mm512_storeu_ps(a.outputWeight + index, weight);
+  }
+
+  samplePixels<NumPlanes, Interior>(a, s, x, xEnd);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+bool cpuSupports(SamplerIsa isa) {
+#if defined(_MSC_VER) && !defined(__clang__)
+  int info[4];
+  __cpuid(info, 0);
+  const int maxLeaf = info[0];
+  __cpuid(info, 1);
+  const bool sse41 = (info[2] & (1 << 19)) != 0;
+  const bool osxsave = (info[2] & (1 << 27)) != 0;
+  const unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+  int leaf7[4] = {};
+  if (maxLeaf >= 7) {
+    __cpuidex(leaf7, 7, 0);
+  }
+  switch (isa) {
+    case SamplerIsa::Sse41:
+      return sse41;
+    case SamplerIsa::Avx2:
+      return (xcr0 & 0x6) == 0x6 && (leaf7[1] & (1 << 5)) != 0;
+    case SamplerIsa::Avx512:
+      return (xcr0 & 0xe6) == 0xe6 && (leaf7[1] & (1 << 16)) != 0;
+    default:
+      return isa == SamplerIsa::Scalar;
+  }
+#else
+  switch (isa) {
+    case SamplerIsa::Sse41:
+      return __builtin_cpu_supports("sse4.1");
+    case SamplerIsa::Avx2:
+      return __builtin_cpu_supports("avx2");
+    case SamplerIsa::Avx512:
+      return __builtin_cpu_supports("avx512f");
+    default:
+      return isa == SamplerIsa::Scalar;
+  }
+#endif
+}
+
+#elif SAMPLER_NEON
+
+////////////////////////////////////
+// NEON: 4 pixels per step, the taps are loaded one by one
+////////////////////////////////////
+struct RowStepNeon {
+  float32x4_t nx{}, ny{}, nz{};
+  int nextExact = 0;
+};
+
+struct TapsNeon {
+  int index[4];
+  float32x4_t w0, w1, w2, w3;
+};
+
+inline void tapsNeon(float32x4_t x, float32x4_t y, int stride, int origin,
+                     TapsNeon& t) {
+  const float32x4_t one = vdupq_n_f32(1.0f);
+  const int32x4_t ix = vcvtq_s32_f32(x), iy = vcvtq_s32_f32(y);
+  const float32x4_t fx = vsubq_f32(x, vcvtq_f32_s32(ix));
+  const float32x4_t fy = vsubq_f32(y, vcvtq_f32_s32(iy));
+  t.w1 = vmulq_f32(vsubq_f32(one, fx), fy);
+  t.w2 = vmulq_f32(fx, vsubq_f32(one, fy));
+  t.w3 = vmulq_f32(fx, fy);
+  t.w0 = vsubq_f32(vsubq_f32(vsubq_f32(one, t.w1), t.w2), t.w3);
+  vst1q_s32(t.index,
+            vsubq_s32(vaddq_s32(vmulq_s32(iy, vdupq_n_s32(stride)), ix),
+                      vdupq_n_s32(origin)));
+}
+
+inline float32x4_t gatherNeon(const float* img, const TapsNeon& t,
+                              int offset) {
+  float32x4_t v = vdupq_n_f32(img[t.index[0] + offset]);
+  v = vsetq_lane_f32(img[t.index[1] + offset], v, 1);
+  v = vsetq_lane_f32(img[t.index[2] + offset], v, 2);
+  v = vsetq_lane_f32(img[t.index[3] + offset], v, 3);
+  return v;
+}
+
+inline float32x4_t interpolateNeon(const float* img, const TapsNeon& t,
+                                   int width) {
+  const float32x4_t v0 = vmulq_f32(gatherNeon(img, t, 0), t.w0);
+  const float32x4_t v1 = vmulq_f32(gatherNeon(img, t, width), t.w1);
+  const float32x4_t v2 = vmulq_f32(gatherNeon(img, t, 1), t.w2);
+  const float32x4_t v3 = vmulq_f32(gatherNeon(img, t, width + 1), t.w3);
+  return vaddq_f32(vaddq_f32(vaddq_f32(v0, v1), v2), v3);
+}
+
+inline void coordsNeon(const RowSetup& s, int x, int xBegin,
+                       RowStepNeon& st, float32x4_t& fx,
+                       float32x4_t& fy) {
+  if (s.incremental && x != xBegin && x != st.nextExact) {
+    st.nx = vaddq_f32(st.nx, vdupq_n_f32(s.h00 * 4));
+    st.ny = vaddq_f32(st.ny, vdupq_n_f32(s.h10 * 4));
+    st.nz = vaddq_f32(st.nz, vdupq_n_f32(s.h20 * 4));
+  } else {
+    const int32_t laneValues[4] = {0, 1, 2, 3};
+    const float32x4_t px = vsubq_f32(
+        vcvtq_f32_s32(vaddq_s32(vdupq_n_s32(x), vld1q_s32(laneValues))),
+        vdupq_n_f32(s.woffset));
+    st.nx = vaddq_f32(
+        vaddq_f32(vmulq_f32(vdupq_n_f32(s.h00), px), vdupq_n_f32(s.h01fy)),
+        vdupq_n_f32(s.h02));
+    st.ny = vaddq_f32(
+        vaddq_f32(vmulq_f32(vdupq_n_f32(s.h10), px), vdupq_n_f32(s.h11fy)),
+        vdupq_n_f32(s.h12));
+    st.nz = vaddq_f32(
+        vaddq_f32(vmulq_f32(vdupq_n_f32(s.h20), px), vdupq_n_f32(s.h21fy)),
+        vdupq_n_f32(s.h22));
+    st.nextExact = x + s.resyncPixels;
+  }
+
+  if (!s.incremental) {
+    fx = vaddq_f32(vdivq_f32(st.nx, st.nz), vdupq_n_f32(s.iwoffset));
+    fy = vaddq_f32(vdivq_f32(st.ny, st.nz), vdupq_n_f32(s.ihoffset));
+  } else {
+    const float32x4_t r = s.affine ? vdupq_n_f32(s.rz)
+                                   : vdivq_f32(vdupq_n_f32(1.0f), st.nz);
+    fx = vaddq_f32(vmulq_f32(st.nx, r), vdupq_n_f32(s.iwoffset));
+    fy = vaddq_f32(vmulq_f32(st.ny, r), vdupq_n_f32(s.ihoffset));
+  }
+}
+
+inline float32x4_t borderTapsNeon(const RowArgs& a, const RowSetup& s,
+                                  float32x4_t fx, float32x4_t fy,
+                                  TapsNeon& taps) {
+  const float32x4_t zero = vdupq_n_f32(0.0f);
+  const uint32x4_t valid =
+      vandq_u32(vandq_u32(vcgeq_f32(fx, zero),
+                          vcltq_f32(fx, vdupq_n_f32(s.xLimit))),
+                vandq_u32(vcgeq_f32(fy, zero),
+                          vcltq_f32(fy, vdupq_n_f32(s.yLimit))));
+  float32x4_t weight;
+  if (a.inputWeight) {
+    tapsNeon(vbslq_f32(valid, fx, vdupq_n_f32(a.windowX)),
+             vbslq_f32(valid, fy, vdupq_n_f32(a.windowY)), a.stride,
+             a.origin, taps);
+    weight = vaddq_f32(vdupq_n_f32(0.01f),
+                       interpolateNeon(a.inputWeight, taps, a.stride));
+    weight = vbslq_f32(valid, weight, vdupq_n_f32(0.01f));
+  } else {
+    weight = vbslq_f32(valid, vdupq_n_f32(1.01f), vdupq_n_f32(0.01f));
+  }
+
+  fx = vbslq_f32(vcltq_f32(fx, zero), zero, fx);
+  fy = vbslq_f32(vcltq_f32(fy, zero), zero, fy);
+  const float32x4_t xClamp = vdupq_n_f32(s.xClamp);
+  const float32x4_t yClamp = vdupq_n_f32(s.yClamp);
+  fx = vbslq_f32(vcgeq_f32(fx, xClamp), xClamp, fx);
+  fy = vbslq_f32(vcgeq_f32(fy, yClamp), yClamp, fy);
+
+  tapsNeon(fx, fy, a.stride, a.origin, taps);
+  return weight;
+}
+
+inline float32x4_t interiorTapsNeon(const RowArgs& a, float32x4_t fx,
+                                    float32x4_t fy, TapsNeon& taps) {
+  tapsNeon(fx, fy, a.stride, a.origin, taps);
+  if (!a.inputWeight) return vdupq_n_f32(1.01f);
+  return vaddq_f32(vdupq_n_f32(0.01f),
+                   interpolateNeon(a.inputWeight, taps, a.stride));
+}
+
+template <int NumPlanes, bool Interior>
+void sampleRowNeon(const RowArgs& a, const RowSetup& s, int xBegin,
+                   int xEnd) {
+  RowStepNeon step;
+  TapsNeon taps;
+
+  int x = xBegin;
+  for (; x + 4 <= xEnd; x += 4) {
+    const int index = a.y * a.width + x;
+    float32x4_t fx, fy;
+    coordsNeon(s, x, xBegin, step, fx, fy);
+
+    float32x4_t weight = Interior ? interiorTapsNeon(a, fx, fy, taps)
+                                  : borderTapsNeon(a, s, fx, fy, taps);
+    if (a.accumulate) {
+      for (int c = 0; c < NumPlanes; c++) {
+        const float32x4_t value = interpolateNeon(a.input[c], taps, a.stride);
+        vst1q_f32(a.output[c] + index,
+                  vaddq_f32(vld1q_f32(a.output[c] + index),
+                            vmulq_f32(value, weight)));
+      }
+      weight = vaddq_f32(vld1q_f32(a.outputWeight + index), weight);
+    } else {
+      for (int c = 0; c < NumPlanes; c++) {
+        vst1q_f32(a.output[c] + index,
+                  interpolateNeon(a.input[c], taps, a.stride));
+      }
+    }
+    vst1q_f32(a.outputWeight + index, weight);
+  }
+
+  samplePixels<NumPlanes, Interior>(a, s, x, xEnd);
+}
+
+bool cpuSupports(SamplerIsa isa) {
+  return isa == SamplerIsa::Scalar || isa == SamplerIsa::Neon;
+}
+
+#else
+
+bool cpuSupports(SamplerIsa isa) { return isa == SamplerIsa::Scalar; }
+
+#endif
+
+// AVX-512 is not picked automatically, the kernel is bound by the gathers
+// and runs no faster than AVX2 at a lower clock
+SamplerIsa bestSamplerIsa() {
+  for (const auto isa :
+       {SamplerIsa::Avx2, SamplerIsa::Sse41, SamplerIsa::Neon}) {
+    if (cpuSupports(isa)) {
+      return isa;
+    }
+  }
+  return SamplerIsa::Scalar;
+}
+
+std::atomic<SamplerIsa>& selectedSamplerIsa() {
+  static std::atomic<SamplerIsa> isa{bestSamplerIsa()};
+  return isa;
+}
+
+std::atomic<SamplerTransform> gSamplerTransform{SamplerTransform::Exact};
+std::atomic<int> gResyncPixels{kDefaultResyncPixels};
+
+// Bilinear sample of a tap, the arithmetic of interpolate
+inline float interpolateTap(const float* img, int stride, int index, float fx,
+                            float fy) {
+  const float w1 = (1.0f - fx) * fy;
+  const float w2 = fx * (1.0f - fy);
+  const float w3 = fx * fy;
+  const float w0 = 1.0f - w1 - w2 - w3;
+
+  return img[index] * w0 + img[index + stride] * w1 + img[index + 1] * w2 +
+         img[index + stride + 1] * w3;
+}
+
+template <int NumPlanes>
+void accumulateTaps(const float* const* input, const float* inputWeight,
+                    int iwidth, int iheight, const WarpTap* taps,
+                    float* const* output, float* outputWeight, int count) {
+  // Fractions of the clamped last column and row
+  const float xClamp = iwidth - 1.001f, yClamp = iheight - 1.001f;
+  const float xClampFraction = xClamp - (int)(xClamp);
+  const float yClampFraction = yClamp - (int)(yClamp);
+
+  for (int i = 0; i < count; i++) {
+    const WarpTap& tap = taps[i];
+    const bool inside = tap.index >= 0;
+    const int index = inside ? tap.index : ~tap.index;
+    float fx = tap.fx, fy = tap.fy;
+
+    float weight = 0.01f;
+    if (inside) {
+      if (inputWeight) {
+        weight = 0.01f + interpolateTap(inputWeight, iwidth, index,
+                                        std::abs(fx), std::abs(fy));
+      } else {
+        weight = 1.01f;
+      }
+      if (fx < 0) fx = xClampFraction;
+      if (fy < 0) fy = yClampFraction;
+    }
+
+    for (int c = 0; c < NumPlanes; c++) {
+      output[c][i] += interpolateTap(input[c], iwidth, index, fx, fy) * weight;
+    }
+    outputWeight[i] += weight;
+  }
+}
+
+template <int NumPlanes, bool Interior>
+void sampleSpan(const RowArgs& a, const RowSetup& s, SamplerIsa isa,
+                int xBegin, int xEnd) {
+  if (xBegin >= xEnd) return;
+  switch (isa) {
+#if SAMPLER_X86
+    case SamplerIsa::Sse41:
+      sampleRowSse41<NumPlanes, Interior>(a, s, xBegin, xEnd);
+      return;
+    case SamplerIsa::Avx2:
+      sampleRowAvx2<NumPlanes, Interior>(a, s, xBegin, xEnd);
+      return;
+    case SamplerIsa::Avx512:
+      sampleRowAvx512<NumPlanes, Interior>(a, s, xBegin, xEnd);
+      return;
+#elif SAMPLER_NEON
+    case SamplerIsa::Neon:
+      sampleRowNeon<NumPlanes, Interior>(a, s, xBegin, xEnd);
+      return;
+#endif
+    default:
+      samplePixels<NumPlanes, Interior>(a, s, xBegin, xEnd);
+      return;
+  }
+}
+
+// The row is split into a left border, an interior and a right border span,
+// only the border spans test and clamp the positions
+template <int NumPlanes>
+void sampleRow(const RowArgs& a, int xBegin, int xEnd) {
+  const RowSetup s(a);
+  const SamplerIsa isa = selectedSamplerIsa().load(std::memory_order_relaxed);
+  int xIn0, xIn1;
+  interiorSpan(s, xBegin, xEnd, xIn0, xIn1);
+  sampleSpan<NumPlanes, false>(a, s, isa, xBegin, xIn0);
+  sampleSpan<NumPlanes, true>(a, s, isa, xIn0, xIn1);
+  sampleSpan<NumPlanes, false>(a, s, isa, xIn1, xEnd);
+}
+
+RowArgs rowArgs(std::array<const float*, 3> input, const float* inputWeight,
+                int iwidth, int iheight, std::array<float*, 3> output,
+                float* outputWeight, int width, int height,
+                const Homography& homography, int y, bool accumulate,
+                const SamplerWindow* window) {
+  const SamplerWindow full{0, 0, iwidth};
+  const SamplerWindow& w = window ? *window : full;
+  return RowArgs{{input[0], input[1], input[2]},
+                 inputWeight,
+                 {output[0], output[1], output[2]},
+                 outputWeight,
+                 iwidth,
+                 iheight,
+                 width,
+                 height,
+                 &homography,
+                 y,
+                 gSamplerTransform.load(std::memory_order_relaxed),
+                 gResyncPixels.load(std::memory_order_relaxed),
+                 accumulate,
+                 w.stride,
+                 w.y0 * w.stride + w.x0,
+                 static_cast<float>(w.x0),
+                 static_cast<float>(w.y0)};
+}
+
+}  // namespace
+
+void sampleRowGray(const float* InputImg, const float* inputWeight, int iwidth,
+                   int iheight, float* OutputImg, float* outputWeight,
+                   int width, int height, const Homography& homography, int y,
+                   int xBegin, int xEnd) {
+  sampleRow<1>(rowArgs({InputImg, nullptr, nullptr}, inputWeight, iwidth,
+                       iheight, {OutputImg, nullptr, nullptr}, outputWeight,
+                       width, height, homography, y, false, nullptr),
+               xBegin, xEnd);
+}
+
+void sampleRowRgb(const float* InputImgR, const float* InputImgG,
+                  const float* InputImgB, const float* inputWeight, int iwidth,
+                  int iheight, float* OutputImgR, float* OutputImgG,
+                  float* OutputImgB, float* outputWeight, int width,
+                  int height, const Homography& homography, int y, int xBegin,
+                  int xEnd) {
+  sampleRow<3>(rowArgs({InputImgR, InputImgG, InputImgB}, inputWeight, iwidth,
+                       iheight, {OutputImgR, OutputImgG, OutputImgB},
+                       outputWeight, width, height, homography, y, false,
+                       nullptr),
+               xBegin, xEnd);
+}
+
+void accumulateRowGray(const float* InputImg, const float* inputWeight,
+                       int iwidth, int iheight, float* BlurImg,
+                       float* outputWeight, int width, int height,
+                       const Homography& homography, int y, int xBegin,
+                       int xEnd, const SamplerWindow* window) {
+  sampleRow<1>(rowArgs({InputImg, nullptr, nullptr}, inputWeight, iwidth,
+                       iheight, {BlurImg, nullptr, nullptr}, outputWeight,
+                       width, height, homography, y, true, window),
+               xBegin, xEnd);
+}
+
+void accumulateRowRgb(const float* InputImgR, const float* InputImgG,
+                      const float* InputImgB, const float* inputWeight,
+                      int iwidth, int iheight, float* BlurImgR,
+                      float* BlurImgG, float* BlurImgB, float* outputWeight,
+                      int width, int height, const Homography& homography,
+                      int y, int xBegin, int xEnd,
+                      const SamplerWindow* window) {
+  sampleRow<3>(rowArgs({InputImgR, InputImgG, InputImgB}, inputWeight, iwidth,
+                       iheight, {BlurImgR, BlurImgG, BlurImgB}, outputWeight,
+                       width, height, homography, y, true, window),
+               xBegin, xEnd);
+}
+
+void computeWarpTaps(int iwidth, int iheight, int width, int height,
+                     const Homography& homography, int y, int xBegin,
+                     int xEnd, WarpTap* taps) {
+  const RowArgs a = rowArgs({nullptr, nullptr, nullptr}, nullptr, iwidth,
+                            iheight, {nullptr, nullptr, nullptr}, nullptr,
+                            width, height, homography, y, true, nullptr);
+  const RowSetup s(a);
+
+  // The positions and clamps of samplePixels, which samples the weight
+  // before clamping. A clamp of an inside position keeps its integer part.
+  RowStep step;
+  for (int x = xBegin; x < xEnd; x++) {
+    float fx, fy;
+    coordsScalar(s, x, xBegin, step, fx, fy);
+    const bool inside = fx >= 0 && fx < s.xLimit && fy >= 0 && fy < s.yLimit;
+    const float wx = fx, wy = fy;
+
+    if (fx < 0) fx = 0;
+    if (fy < 0) fy = 0;
+    if (fx >= s.xClamp) fx = s.xClamp;
+    if (fy >= s.yClamp) fy = s.yClamp;
+
+    const int ix = (int)(fx), iy = (int)(fy);
+    const int index = iy * iwidth + ix;
+    if (inside) {
+      *taps++ = WarpTap{index, wx != fx ? -(wx - ix) : fx - ix,
+                        wy != fy ? -(wy - iy) : fy - iy};
+    } else {
+      *taps++ = WarpTap{~index, fx - ix, fy - iy};
+    }
+  }
+}
+
+void accumulateTapsGray(const float* InputImg, const float* inputWeight,
+                        int iwidth, int iheight, const WarpTap* taps,
+                        float* BlurImg, float* outputWeight, int count) {
+  const float* input[1] = {InputImg};
+  float* output[1] = {BlurImg};
+  accumulateTaps<1>(input, inputWeight, iwidth, iheight, taps, output,
+                    outputWeight, count);
+}
+
+void accumulateTapsRgb(const float* InputImgR, const float* InputImgG,
+                       const float* InputImgB, const float* inputWeight,
+                       int iwidth, int iheight, const WarpTap* taps,
+                       float* BlurImgR, float* BlurImgG, float* BlurImgB,
+                       float* outputWeight, int count) {
+  const float* input[3] = {InputImgR, InputImgG, InputImgB};
+  float* output[3] = {BlurImgR, BlurImgG, BlurImgB};
+  accumulateTaps<3>(input, inputWeight, iwidth, iheight, taps, output,
+                    outputWeight, count);
+}
+
+SamplerIsa getSamplerIsa() { return selectedSamplerIsa().load(); }
+
+const char* getSamplerIsaName(SamplerIsa isa) {
+  switch (isa) {
+    case SamplerIsa::Sse41:
+      return "sse4.1";
+    case SamplerIsa::Avx2:
+      return "avx2";
+    case SamplerIsa::Avx512:
+      return "avx512";
+    case SamplerIsa::Neon:
+      return "neon";
+    default:
+      return "scalar";
+  }
+}
+
+bool setSamplerIsa(SamplerIsa isa) {
+  if (!isSamplerIsaSupported(isa)) {
+    return false;
+  }
+  selectedSamplerIsa().store(isa);
+  return true;
+}
+
+bool isSamplerIsaSupported(SamplerIsa isa) { return cpuSupports(isa); }
+
+void setSamplerTransform(SamplerTransform transform, int resyncPixels) {
+  // Keep the resync points on vector boundaries of every kernel
+  constexpr int kMaxLanes = 16;
+  resyncPixels = std::max(resyncPixels, kMaxLanes);
+  resyncPixels = (resyncPixels + kMaxLanes - 1) / kMaxLanes * kMaxLanes;
+
+  gResyncPixels.store(resyncPixels);
+  gSamplerTransform.store(transform);
+}
+
+SamplerTransform getSamplerTransform() { return gSamplerTransform.load(); }
+
+int getSamplerResyncPixels() { return gResyncPixels.load(); }
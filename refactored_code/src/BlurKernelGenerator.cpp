@@ -203,6 +203,7 @@ void BlurKernelGenerator::blurRgb(float* InputImgR, float* InputImgG,
                                   bool bforward) {}
 
 void BlurKernelGenerator::SetBuffer([[maybe_unused]] int width,
-                                    [[maybe_unused]] int height) {}
+                                    [[maybe_unused]] int height,
+                                    [[maybe_unused]] int channels) {}
 
 void BlurKernelGenerator::ClearBuffer() {}
\ No newline at end of file
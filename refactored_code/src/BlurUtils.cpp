@@ -2,9 +2,7 @@
 
 #include <cstdio>
 
-#include "bitmap.h"
-
-static constexpr auto fileExtension = ".bmp";
+#include "ImageIO.hpp"
 
 void generateMotionBlurredImage(std::vector<float> (&aInitialImage)[3],
                                 std::vector<float>& aInputWeight,
@@ -13,7 +11,8 @@ void generateMotionBlurredImage(std::vector<float> (&aInitialImage)[3],
                                 const std::string& aPrefix,
                                 IBlurImageGenerator& aBlurGenerator,
                                 IErrorCalculator& aErrorCalculator,
-                                std::vector<float> (&aBlurredImage)[3]) {
+                                std::vector<float> (&aBlurredImage)[3],
+                                const std::string& aExtension) {
   printf("Generate Motion Blurred Image\n");
   aBlurGenerator.blurGray(aInitialImage[0].data(), aInputWeight.data(), aWidth,
                           aHeight, aBlurredImage[0].data(),
@@ -30,17 +29,18 @@ void generateMotionBlurredImage(std::vector<float> (&aInitialImage)[3],
         aBlurredImage[0].data(), aBlurredImage[1].data(),
         aBlurredImage[2].data(), aWidth, aHeight);
     const std::string fname =
-        aPrefix + "_blur_" + std::to_string(RMSError * 255.0f) + fileExtension;
+        aPrefix + "_blur_" + std::to_string(RMSError * 255.0f) + aExtension;
     printf("Save Blurred Image to: %s\n", fname.c_str());
-    writeBMPchannels(fname, aBlurWidth, aBlurHeight, aBlurredImage[0],
-                     aBlurredImage[1], aBlurredImage[2]);
+    writeImageChannels(fname, aBlurWidth, aBlurHeight, aBlurredImage[0],
+                       aBlurredImage[1], aBlurredImage[2]);
   }
 }
 
 void addNoiseToImage(std::vector<float> (&bImg)[3], int width, int height,
                      int blurWidth, int blurHeight, const std::string& prefix,
                      INoiseGenerator& noiseGenerator,
-                     IErrorCalculator& errorCalculator) {
+                     IErrorCalculator& errorCalculator,
+                     const std::string& extension) {
   noiseGenerator.addNoiseGray(bImg[0].data(), width, height, bImg[0].data());
   noiseGenerator.addNoiseGray(bImg[1].data(), width, height, bImg[1].data());
   noiseGenerator.addNoiseGray(bImg[2].data(), width, height, bImg[2].data());
@@ -49,8 +49,9 @@ void addNoiseToImage(std::vector<float> (&bImg)[3], int width, int height,
     const float RMSError = errorCalculator.calculateErrorRgb(
         bImg[0].data(), bImg[1].data(), bImg[2].data(), width, height);
     const std::string fname =
-        prefix + std::to_string(RMSError * 255.0f) + fileExtension;
+        prefix + std::to_string(RMSError * 255.0f) + extension;
     printf("Save Blurred Image to: %s\n", fname.c_str());
-    writeBMPchannels(fname, blurWidth, blurHeight, bImg[0], bImg[1], bImg[2]);
+    writeImageChannels(fname, blurWidth, blurHeight, bImg[0], bImg[1],
+                       bImg[2]);
   }
 }
\ No newline at end of file
@@ -0,0 +1,153 @@
+#include "BufferPool.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <utility>
+
+namespace {
+
+constexpr std::size_t kFrameAlignment = 64;
+constexpr std::size_t kFrameFloats = kFrameAlignment / sizeof(float);
+// A free frame is only reused for requests of at least 1 / kMaxReuseRatio of
+// its capacity, a small buffer does not pin a large frame
+constexpr std::size_t kMaxReuseRatio = 2;
+
+}  // namespace
+
+BufferPool::~BufferPool() {
+  for (auto& frame : mFrames) {
+    ::operator delete[](frame.data, std::align_val_t(kFrameAlignment));
+  }
+}
+
+BufferPool& BufferPool::GetDefault() {
+  static BufferPool pool;
+  return pool;
+}
+
+float* BufferPool::Acquire(std::size_t size, std::size_t& capacity) {
+  std::lock_guard lock(mMutex);
+
+  Frame* best = nullptr;
+  for (auto& frame : mFrames) {
+    if (!frame.inUse && frame.capacity >= size &&
+        frame.capacity <= kMaxReuseRatio * size &&
+        (!best || frame.capacity < best->capacity)) {
+      best = &frame;
+    }
+  }
+
+  if (!best) {
+    Frame frame;
+    frame.capacity = (size + kFrameFloats - 1) / kFrameFloats * kFrameFloats;
+    frame.data = static_cast<float*>(::operator new[](
+        frame.capacity * sizeof(float), std::align_val_t(kFrameAlignment)));
+    mBytesReserved += frame.capacity * sizeof(float);
+    mFrames.push_back(frame);
+    best = &mFrames.back();
+  }
+
+  best->inUse = true;
+  mBytesInUse += best->capacity * sizeof(float);
+  mPeakBytesInUse = std::max(mPeakBytesInUse, mBytesInUse);
+
+  std::memset(best->data, 0, size * sizeof(float));
+  capacity = best->capacity;
+  return best->data;
+}
+
+void BufferPool::Release(float* frame) {
+  std::lock_guard lock(mMutex);
+
+  for (auto& poolFrame : mFrames) {
+    if (poolFrame.data == frame) {
+      poolFrame.inUse = false;
+      mBytesInUse -= poolFrame.capacity * sizeof(float);
+      return;
+    }
+  }
+}
+
+void BufferPool::Trim() {
+  std::lock_guard lock(mMutex);
+
+  std::erase_if(mFrames, [this](const Frame& frame) {
+    if (frame.inUse) return false;
+    ::operator delete[](frame.data, std::align_val_t(kFrameAlignment));
+    mBytesReserved -= frame.capacity * sizeof(float);
+    return true;
+  });
+}
+
+std::size_t BufferPool::GetBytesInUse() const {
+  std::lock_guard lock(mMutex);
+  return mBytesInUse;
+}
+
+std::size_t BufferPool::GetPeakBytesInUse() const {
+  std::lock_guard lock(mMutex);
+  return mPeakBytesInUse;
+}
+
+std::size_t BufferPool::GetBytesReserved() const {
+  std::lock_guard lock(mMutex);
+  return mBytesReserved;
+}
+
+void BufferPool::ResetPeak() {
+  std::lock_guard lock(mMutex);
+  mPeakBytesInUse = mBytesInUse;
+}
+
+PoolBuffer::PoolBuffer(PoolBuffer&& other) noexcept
+    : mPool(std::exchange(other.mPool, nullptr)),
+      mData(std::exchange(other.mData, nullptr)),
+      mSize(std::exchange(other.mSize, 0)),
+      mCapacity(std::exchange(other.mCapacity, 0)) {}
+
+PoolBuffer& PoolBuffer::operator=(PoolBuffer&& other) noexcept {
+  if (this != &other) {
+    clear();
+    mPool = std::exchange(other.mPool, nullptr);
+    mData = std::exchange(other.mData, nullptr);
+    mSize = std::exchange(other.mSize, 0);
+    mCapacity = std::exchange(other.mCapacity, 0);
+  }
+  return *this;
+}
+
+void PoolBuffer::resize(std::size_t size, BufferPool& pool) {
+  if (size <= mSize) {
+    mSize = size;
+    if (size == 0) clear();
+    return;
+  }
+
+  if (size <= mCapacity && &pool == mPool) {
+    std::memset(mData + mSize, 0, (size - mSize) * sizeof(float));
+    mSize = size;
+    return;
+  }
+
+  std::size_t capacity = 0;
+  float* data = pool.Acquire(size, capacity);
+  if (mData) {
+    std::memcpy(data, mData, mSize * sizeof(float));
+    mPool->Release(mData);
+  }
+  mPool = &pool;
+  mData = data;
+  mSize = size;
+  mCapacity = capacity;
+}
+
+void PoolBuffer::clear() {
+  if (mData) {
+    mPool->Release(mData);
+  }
+  mPool = nullptr;
+  mData = nullptr;
+  mSize = 0;
+  mCapacity = 0;
+}
@@ -0,0 +1,110 @@
+#include "DeblurCheckpoint.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+namespace {
+
+constexpr char kMagic[4] = {'R', 'L', 'C', 'K'};
+constexpr uint32_t kVersion = 1;
+
+// Fixed size header, in the byte order of the host
+struct CheckpointHeader {
+  char magic[4];
+  uint32_t version;
+  int32_t call;
+  int32_t iteration;
+  int32_t width;
+  int32_t height;
+  int32_t channels;
+  int32_t numPlanes;
+  double stepDot;
+  double stepNorm;
+};
+
+std::size_t planeBytes(const DeblurCheckpointState& state) {
+  return std::size_t(state.width) * state.height * sizeof(float);
+}
+
+}  // namespace
+
+bool readCheckpointState(const std::string& fname,
+                         DeblurCheckpointState& state) {
+  std::ifstream file(fname, std::ios::binary | std::ios::ate);
+  if (!file) {
+    return false;
+  }
+  const auto size = static_cast<std::size_t>(file.tellg());
+  file.seekg(0);
+
+  CheckpointHeader header{};
+  file.read(reinterpret_cast<char*>(&header), sizeof(header));
+  if (!file || std::string(header.magic, 4) != std::string(kMagic, 4) ||
+      header.version != kVersion) {
+    throw std::runtime_error(fname + " is not a deblurring checkpoint");
+  }
+
+  state.call = header.call;
+  state.iteration = header.iteration;
+  state.width = header.width;
+  state.height = header.height;
+  state.channels = header.channels;
+  state.numPlanes = header.numPlanes;
+  state.stepDot = header.stepDot;
+  state.stepNorm = header.stepNorm;
+  if (size != sizeof(header) + state.numPlanes * planeBytes(state)) {
+    throw std::runtime_error("The checkpoint " + fname + " is truncated");
+  }
+  return true;
+}
+
+void readCheckpointPlanes(const std::string& fname,
+                          const DeblurCheckpointState& state,
+                          std::span<float* const> planes) {
+  std::ifstream file(fname, std::ios::binary);
+  file.seekg(sizeof(CheckpointHeader));
+  const std::size_t numPlanes =
+      std::min(planes.size(), std::size_t(state.numPlanes));
+  for (std::size_t i = 0; i < numPlanes; i++) {
+    file.read(reinterpret_cast<char*>(planes[i]), planeBytes(state));
+  }
+  if (!file) {
+    throw std::runtime_error("Cannot read the checkpoint " + fname);
+  }
+}
+
+void writeCheckpoint(const std::string& fname,
+                     const DeblurCheckpointState& state,
+                     std::span<const float* const> planes) {
+  CheckpointHeader header{};
+  std::copy(std::begin(kMagic), std::end(kMagic), header.magic);
+  header.version = kVersion;
+  header.call = state.call;
+  header.iteration = state.iteration;
+  header.width = state.width;
+  header.height = state.height;
+  header.channels = state.channels;
+  header.numPlanes = state.numPlanes;
+  header.stepDot = state.stepDot;
+  header.stepNorm = state.stepNorm;
+
+  // Written aside and renamed, which replaces the previous checkpoint at
+  // once
+  const std::string tmpName = fname + ".tmp";
+  {
+    std::ofstream file(tmpName, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (int i = 0; i < state.numPlanes; i++) {
+      file.write(reinterpret_cast<const char*>(planes[i]), planeBytes(state));
+    }
+    file.flush();
+    if (!file) {
+      throw std::runtime_error("Cannot write the checkpoint " + tmpName);
+    }
+  }
+  std::filesystem::rename(tmpName, fname);
+}
@@ -9,4 +9,22 @@ void EmptyRegularizer::applyRegularizationRgb(
     [[maybe_unused]] float* DeblurImgR, [[maybe_unused]] float* DeblurImgG,
     [[maybe_unused]] float* DeblurImgB, [[maybe_unused]] int width,
     [[maybe_unused]] int height, [[maybe_unused]] bool bPoisson,
-    [[maybe_unused]] float lambda) {}
\ No newline at end of file
+    [[maybe_unused]] float lambda) {}
+
+bool EmptyRegularizer::computeRegularizationTermGray(
+    [[maybe_unused]] float* DeblurImg, [[maybe_unused]] int width,
+    [[maybe_unused]] int height, const float*& TermImg) {
+  TermImg = nullptr;
+  return true;
+}
+
+bool EmptyRegularizer::computeRegularizationTermRgb(
+    [[maybe_unused]] float* DeblurImgR, [[maybe_unused]] float* DeblurImgG,
+    [[maybe_unused]] float* DeblurImgB, [[maybe_unused]] int width,
+    [[maybe_unused]] int height, const float*& TermImgR,
+    const float*& TermImgG, const float*& TermImgB) {
+  TermImgR = nullptr;
+  TermImgG = nullptr;
+  TermImgB = nullptr;
+  return true;
+}
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include "Homography.hpp"
 
+#include <algorithm>
+
 #include "svdcmp.h"
 
 void Homography::ComputeHomography(const double (&correspondants)[4][4]) {
@@ -832,4 +834,25 @@ void Homography::ComputeRTHomography(
   Hmatrix[2][0] = 0.0f;
   Hmatrix[2][1] = 0.0f;
   Hmatrix[2][2] = 1.0f;
+}
+
+std::vector<Homography> Homography::ResampleMotion(
+    const std::vector<Homography>& samples, int numSamples) {
+  const int oldSamples = static_cast<int>(samples.size());
+  std::vector<Homography> resampled(numSamples);
+  for (int j = 0; j < numSamples; j++) {
+    // Position of the new sample among the old ones
+    const double s = double(j) * oldSamples / numSamples;
+    const int i = std::min(static_cast<int>(s), std::max(oldSamples - 2, 0));
+    const double t = oldSamples > 1 ? s - i : 0.0;
+    const auto& H0 = samples[i].Hmatrix;
+    const auto& H1 = samples[std::min(i + 1, oldSamples - 1)].Hmatrix;
+    for (int r = 0; r < 3; r++) {
+      for (int c = 0; c < 3; c++) {
+        resampled[j].Hmatrix[r][c] =
+            static_cast<float>((1.0 - t) * H0[r][c] + t * H1[r][c]);
+      }
+    }
+  }
+  return resampled;
 }
\ No newline at end of file
@@ -0,0 +1,120 @@
+#include "ImageIO.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+#include <stdexcept>
+
+#include "bitmap.h"
+#include "pnm.h"
+
+namespace {
+
+constexpr const char* kImageExtensions[] = {".bmp", ".pfm", ".pgm", ".ppm"};
+
+// Lower case extension of fname, which must be supported
+std::string lowerExtension(const std::string& fname) {
+  std::string extension = getImageExtension(fname);
+  if (extension.empty()) {
+    throw std::runtime_error("Unsupported image format of " + fname);
+  }
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  return extension;
+}
+
+}  // namespace
+
+std::string getImageExtension(const std::string& fname) {
+  for (const std::string extension : kImageExtensions) {
+    if (fname.size() > extension.size() &&
+        std::equal(extension.begin(), extension.end(),
+                   fname.end() - extension.size(),
+                   [](char a, char b) {
+                     return a == std::tolower(static_cast<unsigned char>(b));
+                   })) {
+      return fname.substr(fname.size() - extension.size());
+    }
+  }
+  return {};
+}
+
+std::unique_ptr<IImageFile> openImageFile(const std::string& fname,
+                                          bool bWritable) {
+  if (lowerExtension(fname) == ".bmp") {
+    return std::make_unique<BMPFile>(fname, bWritable);
+  }
+  return std::make_unique<PNMFile>(fname, bWritable);
+}
+
+std::unique_ptr<IImageFile> createImageFile(const std::string& fname,
+                                            int width, int height,
+                                            int channels) {
+  const std::string extension = lowerExtension(fname);
+  if (extension == ".bmp") {
+    return std::make_unique<BMPFile>(fname, width, height, channels);
+  }
+  if (extension == ".pfm") {
+    return std::make_unique<PNMFile>(fname, width, height, channels,
+                                     PNMSample::Float);
+  }
+  if (channels != (extension == ".pgm" ? 1 : 3)) {
+    throw std::invalid_argument("A PGM file has 1 channel, a PPM file 3");
+  }
+  return std::make_unique<PNMFile>(fname, width, height, channels,
+                                   PNMSample::Short);
+}
+
+void readImageChannels(const std::string& fname, std::vector<float>& fImgR,
+                       std::vector<float>& fImgG, std::vector<float>& fImgB,
+                       int& width, int& height) {
+  std::cout << "readImage fname " << fname << '\n';
+  fImgR.clear();
+  fImgG.clear();
+  fImgB.clear();
+  try {
+    const auto file = openImageFile(fname);
+    width = file->GetWidth();
+    height = file->GetHeight();
+    fImgR.resize(std::size_t(width) * height);
+    fImgG.resize(std::size_t(width) * height);
+    fImgB.resize(std::size_t(width) * height);
+
+    if (file->GetChannels() == 1) {
+      file->ReadRegion(0, 0, Image<float>(fImgR.data(), width, height));
+      fImgG = fImgR;
+      fImgB = fImgR;
+    } else {
+      file->ReadRegion(0, 0,
+                       Image<float>(fImgR.data(), fImgG.data(), fImgB.data(),
+                                    width, height));
+    }
+  } catch (const std::runtime_error& error) {
+    std::cout << error.what() << '\n';
+    fImgR.clear();
+    fImgG.clear();
+    fImgB.clear();
+    return;
+  }
+
+  std::cout << "readImage " << width << " " << height << '\n';
+}
+
+void writeImageChannels(const std::string& iname, int width, int height,
+                        const std::vector<float>& dataR,
+                        const std::vector<float>& dataG,
+                        const std::vector<float>& dataB) {
+  try {
+    const bool gray = lowerExtension(iname) == ".pgm";
+    const auto file = createImageFile(iname, width, height, gray ? 1 : 3);
+    if (gray) {
+      file->WriteRegion(0, 0, Image<const float>(dataR.data(), width, height));
+    } else {
+      file->WriteRegion(0, 0,
+                        Image<const float>(dataR.data(), dataG.data(),
+                                           dataB.data(), width, height));
+    }
+  } catch (const std::exception& error) {
+    std::cout << error.what() << '\n';
+  }
+}
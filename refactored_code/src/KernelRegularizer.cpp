@@ -2,7 +2,8 @@
 
 KernelRegularizer::KernelRegularizer() {}
 
-void KernelRegularizer::SetBuffer(int width, int height) {}
+void KernelRegularizer::SetBuffer(int width, int height,
+                                  [[maybe_unused]] int channels) {}
 
 void KernelRegularizer::ClearBuffer() {}
 
@@ -35,30 +35,36 @@ void LaplacianRegularizer::SetSpsTable() {
   }
 }
 
-void LaplacianRegularizer::SetBuffer(int width, int height) {
+void LaplacianRegularizer::SetBuffer(int width, int height, int channels) {
   const size_t newSize = width * height;
 
-  if (newSize <= mDxImg.size()) {
-    return;
-  }
+  if (channels == 1) {
+    if (newSize <= mDxImg.size()) {
+      return;
+    }
 
-  mDxImg.resize(newSize);
-  mDyImg.resize(newSize);
-  mDxxImg.resize(newSize);
-  mDyyImg.resize(newSize);
-
-  mDxImgR.resize(newSize);
-  mDyImgR.resize(newSize);
-  mDxxImgR.resize(newSize);
-  mDyyImgR.resize(newSize);
-  mDxImgG.resize(newSize);
-  mDyImgG.resize(newSize);
-  mDxxImgG.resize(newSize);
-  mDyyImgG.resize(newSize);
-  mDxImgB.resize(newSize);
-  mDyImgB.resize(newSize);
-  mDxxImgB.resize(newSize);
-  mDyyImgB.resize(newSize);
+    mDxImg.resize(newSize, *mBufferPool);
+    mDyImg.resize(newSize, *mBufferPool);
+    mDxxImg.resize(newSize, *mBufferPool);
+    mDyyImg.resize(newSize, *mBufferPool);
+  } else {
+    if (newSize <= mDxImgR.size()) {
+      return;
+    }
+
+    mDxImgR.resize(newSize, *mBufferPool);
+    mDyImgR.resize(newSize, *mBufferPool);
+    mDxxImgR.resize(newSize, *mBufferPool);
+    mDyyImgR.resize(newSize, *mBufferPool);
+    mDxImgG.resize(newSize, *mBufferPool);
+    mDyImgG.resize(newSize, *mBufferPool);
+    mDxxImgG.resize(newSize, *mBufferPool);
+    mDyyImgG.resize(newSize, *mBufferPool);
+    mDxImgB.resize(newSize, *mBufferPool);
+    mDyImgB.resize(newSize, *mBufferPool);
+    mDxxImgB.resize(newSize, *mBufferPool);
+    mDyyImgB.resize(newSize, *mBufferPool);
+  }
 }
 
 void LaplacianRegularizer::ClearBuffer() {
@@ -81,6 +87,11 @@ void LaplacianRegularizer::ClearBuffer() {
   mDyyImgB.clear();
 }
 
+void LaplacianRegularizer::SetBufferPool(BufferPool& aPool) {
+  ClearBuffer();
+  mBufferPool = &aPool;
+}
+
 void LaplacianRegularizer::ComputeGradientImageGray(float* Img, int width,
                                                     int height, float* DxImg,
                                                     float* DyImg, bool bflag) {
@@ -163,9 +174,35 @@ void LaplacianRegularizer::ComputeGradientYImageGray(float* Img, int width,
 void LaplacianRegularizer::applyRegularizationGray(float* DeblurImg, int width,
                                                    int height, bool bPoisson,
                                                    float lambda) {
-  SetBuffer(width, height);
+  const float* TermImg = nullptr;
+  computeRegularizationTermGray(DeblurImg, width, height, TermImg);
 
-  int x = 0, y = 0, index = 0;
+  regularizePlane(DeblurImg, TermImg, width * height, bPoisson, lambda,
+                  true);
+}
+
+void LaplacianRegularizer::applyRegularizationRgb(float* DeblurImgR,
+                                                  float* DeblurImgG,
+                                                  float* DeblurImgB, int width,
+                                                  int height, bool bPoisson,
+                                                  float lambda) {
+  const float *TermImgR = nullptr, *TermImgG = nullptr, *TermImgB = nullptr;
+  computeRegularizationTermRgb(DeblurImgR, DeblurImgG, DeblurImgB, width,
+                               height, TermImgR, TermImgG, TermImgB);
+
+  regularizePlane(DeblurImgR, TermImgR, width * height, bPoisson, lambda,
+                  true);
+  regularizePlane(DeblurImgG, TermImgG, width * height, bPoisson, lambda,
+                  true);
+  regularizePlane(DeblurImgB, TermImgB, width * height, bPoisson, lambda,
+                  true);
+}
+
+bool LaplacianRegularizer::computeRegularizationTermGray(
+    float* DeblurImg, int width, int height, const float*& TermImg) {
+  SetBuffer(width, height, 1);
+
+  int index = 0;
   float Wx = NAN, Wy = NAN;
 
   ComputeGradientImageGray(DeblurImg, width, height, mDxImg.data(),
@@ -175,30 +212,24 @@ void LaplacianRegularizer::applyRegularizationGray(float* DeblurImg, int width,
   ComputeGradientYImageGray(mDyImg.data(), width, height, mDyyImg.data(),
                             false);
 
-  for (y = 0, index = 0; y < height; y++) {  // Normalize the gradient
-    for (x = 0; x < width; x++, index++) {
-      Wx = getSpsWeight(mDxImg[index]);
-      Wy = getSpsWeight(mDyImg[index]);
-      if (bPoisson) {
-        DeblurImg[index] *=
-            1.0 / (1.0 + lambda * (Wx * mDxxImg[index] + Wy * mDyyImg[index]));
-      } else {
-        DeblurImg[index] -=
-            lambda * (Wx * mDxxImg[index] + Wy * mDyyImg[index]);
-      }
-      if (std::isnan(DeblurImg[index])) DeblurImg[index] = 0;
-    }
+  // The term is the second derivatives weighted by the sparse prior
+  for (index = 0; index < width * height; index++) {
+    Wx = getSpsWeight(mDxImg[index]);
+    Wy = getSpsWeight(mDyImg[index]);
+    mDxxImg[index] = Wx * mDxxImg[index] + Wy * mDyyImg[index];
   }
+
+  TermImg = mDxxImg.data();
+  return true;
 }
 
-void LaplacianRegularizer::applyRegularizationRgb(float* DeblurImgR,
-                                                  float* DeblurImgG,
-                                                  float* DeblurImgB, int width,
-                                                  int height, bool bPoisson,
-                                                  float lambda) {
-  SetBuffer(width, height);
+bool LaplacianRegularizer::computeRegularizationTermRgb(
+    float* DeblurImgR, float* DeblurImgG, float* DeblurImgB, int width,
+    int height, const float*& TermImgR, const float*& TermImgG,
+    const float*& TermImgB) {
+  SetBuffer(width, height, 3);
 
-  int x = 0, y = 0, index = 0;
+  int index = 0;
   float WxR = NAN, WyR = NAN, WxG = NAN, WyG = NAN, WxB = NAN, WyB = NAN;
 
   ComputeGradientImageGray(DeblurImgR, width, height, mDxImgR.data(),
@@ -221,37 +252,21 @@ void LaplacianRegularizer::applyRegularizationRgb(float* DeblurImgR,
   ComputeGradientYImageGray(mDyImgB.data(), width, height, mDyyImgB.data(),
                             false);
 
-  for (y = 0, index = 0; y < height; y++) {  // Normalize the gradient
-    for (x = 0; x < width; x++, index++) {
-      WxR = getSpsWeight(mDxImgR[index]);
-      WyR = getSpsWeight(mDyImgR[index]);
-      WxG = getSpsWeight(mDxImgG[index]);
-      WyG = getSpsWeight(mDyImgG[index]);
-      WxB = getSpsWeight(mDxImgB[index]);
-      WyB = getSpsWeight(mDyImgB[index]);
-
-      if (bPoisson) {
-        DeblurImgR[index] *=
-            1.0 /
-            (1.0 + lambda * (WxR * mDxxImgR[index] + WyR * mDyyImgR[index]));
-        DeblurImgG[index] *=
-            1.0 /
-            (1.0 + lambda * (WxG * mDxxImgG[index] + WyG * mDyyImgG[index]));
-        DeblurImgB[index] *=
-            1.0 /
-            (1.0 + lambda * (WxB * mDxxImgB[index] + WyB * mDyyImgB[index]));
-      } else {
-        DeblurImgR[index] -=
-            lambda * (WxR * mDxxImgR[index] + WyR * mDyyImgR[index]);
-        DeblurImgG[index] -=
-            lambda * (WxG * mDxxImgG[index] + WyG * mDyyImgG[index]);
-        DeblurImgB[index] -=
-            lambda * (WxB * mDxxImgB[index] + WyB * mDyyImgB[index]);
-      }
+  for (index = 0; index < width * height; index++) {
+    WxR = getSpsWeight(mDxImgR[index]);
+    WyR = getSpsWeight(mDyImgR[index]);
+    WxG = getSpsWeight(mDxImgG[index]);
+    WyG = getSpsWeight(mDyImgG[index]);
+    WxB = getSpsWeight(mDxImgB[index]);
+    WyB = getSpsWeight(mDyImgB[index]);
 
-      if (std::isnan(DeblurImgR[index])) DeblurImgR[index] = 0;
-      if (std::isnan(DeblurImgG[index])) DeblurImgG[index] = 0;
-      if (std::isnan(DeblurImgB[index])) DeblurImgB[index] = 0;
-    }
+    mDxxImgR[index] = WxR * mDxxImgR[index] + WyR * mDyyImgR[index];
+    mDxxImgG[index] = WxG * mDxxImgG[index] + WyG * mDyyImgG[index];
+    mDxxImgB[index] = WxB * mDxxImgB[index] + WyB * mDyyImgB[index];
   }
-}
\ No newline at end of file
+
+  TermImgR = mDxxImgR.data();
+  TermImgG = mDxxImgG.data();
+  TermImgB = mDxxImgB.data();
+  return true;
+}
@@ -0,0 +1,116 @@
+#include "MappedFile.hpp"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string& fname, bool bWritable) {
+  Map(fname, bWritable, false, 0);
+}
+
+MappedFile::MappedFile(const std::string& fname, std::size_t size) {
+  Map(fname, true, true, size);
+}
+
+#ifdef _WIN32
+
+void MappedFile::Map(const std::string& fname, bool bWritable, bool bCreate,
+                     std::size_t size) {
+  const DWORD access = bWritable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ;
+  HANDLE file =
+      CreateFileA(fname.c_str(), access, FILE_SHARE_READ, nullptr,
+                  bCreate ? CREATE_ALWAYS : OPEN_EXISTING,
+                  FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    throw std::runtime_error("Cannot open " + fname);
+  }
+
+  if (!bCreate) {
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(file, &fileSize);
+    size = static_cast<std::size_t>(fileSize.QuadPart);
+  }
+  const DWORD sizeHigh = static_cast<DWORD>(uint64_t(size) >> 32);
+  const DWORD sizeLow = static_cast<DWORD>(size);
+  HANDLE mapping =
+      size ? CreateFileMappingA(file, nullptr,
+                                bWritable ? PAGE_READWRITE : PAGE_READONLY,
+                                sizeHigh, sizeLow, nullptr)
+           : nullptr;
+  void* data = mapping ? MapViewOfFile(mapping,
+                                       bWritable ? FILE_MAP_WRITE
+                                                 : FILE_MAP_READ,
+                                       0, 0, size)
+                       : nullptr;
+  if (!data) {
+    if (mapping) CloseHandle(mapping);
+    CloseHandle(file);
+    throw std::runtime_error("Cannot map " + fname);
+  }
+
+  mFile = file;
+  mMapping = mapping;
+  mData = static_cast<uint8_t*>(data);
+  mSize = size;
+  mWritable = bWritable;
+}
+
+MappedFile::~MappedFile() {
+  if (mData) UnmapViewOfFile(mData);
+  if (mMapping) CloseHandle(mMapping);
+  if (mFile) CloseHandle(mFile);
+}
+
+#else
+
+void MappedFile::Map(const std::string& fname, bool bWritable, bool bCreate,
+                     std::size_t size) {
+  const int flags = bCreate ? O_RDWR | O_CREAT | O_TRUNC
+                    : bWritable ? O_RDWR
+                                : O_RDONLY;
+  const int fd = open(fname.c_str(), flags, 0644);
+  if (fd < 0) {
+    throw std::runtime_error("Cannot open " + fname);
+  }
+
+  bool mapped = false;
+  void* data = nullptr;
+  if (bCreate) {
+    mapped = ftruncate(fd, static_cast<off_t>(size)) == 0;
+  } else {
+    struct stat status;
+    mapped = fstat(fd, &status) == 0;
+    size = static_cast<std::size_t>(status.st_size);
+  }
+  if (mapped && size > 0) {
+    data = mmap(nullptr, size, bWritable ? PROT_READ | PROT_WRITE : PROT_READ,
+                MAP_SHARED, fd, 0);
+    mapped = data != MAP_FAILED;
+  } else {
+    mapped = false;
+  }
+  // The mapping keeps the file open
+  close(fd);
+  if (!mapped) {
+    throw std::runtime_error("Cannot map " + fname);
+  }
+
+  mData = static_cast<uint8_t*>(data);
+  mSize = size;
+  mWritable = bWritable;
+}
+
+MappedFile::~MappedFile() {
+  if (mData) munmap(mData, mSize);
+}
+
+#endif
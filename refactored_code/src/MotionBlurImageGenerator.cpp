@@ -1,12 +1,58 @@
 #include "MotionBlurImageGenerator.hpp"
 
+#include <algorithm>
 #include <cmath>
 #include <cstring>
+#include <stdexcept>
+#include <utility>
 
+#include "BilinearSampler.h"
 #include "warping.h"
 
-MotionBlurImageGenerator::MotionBlurImageGenerator() {
-  for (int i = 0; i < NumSamples; i++) {
+namespace {
+
+// Points every kBorderStep pixels along the border of a width * height
+// image, where the steps of an affine motion are the largest
+std::vector<std::pair<float, float>> borderPoints(int width, int height) {
+  constexpr int kBorderStep = 64;
+  std::vector<std::pair<float, float>> points;
+  for (int x = 0; x <= width; x += kBorderStep) {
+    points.emplace_back(x, 0);
+    points.emplace_back(x, height);
+  }
+  for (int y = 0; y <= height; y += kBorderStep) {
+    points.emplace_back(0, y);
+    points.emplace_back(width, y);
+  }
+  points.emplace_back(width, height);
+  return points;
+}
+
+// Total and largest displacement of (x, y) between consecutive samples, in
+// the coordinates of the samplers, centered on the image
+std::pair<float, float> pathSteps(const std::vector<Homography>& samples,
+                                  float x, float y, int width, int height) {
+  float total = 0.0f, largest = 0.0f;
+  float prevX = 0.0f, prevY = 0.0f;
+  for (std::size_t i = 0; i < samples.size(); i++) {
+    float fx = x - width * 0.5f, fy = y - height * 0.5f;
+    samples[i].Transform(fx, fy);
+    if (i > 0) {
+      const float step = std::hypot(fx - prevX, fy - prevY);
+      total += step;
+      largest = std::max(largest, step);
+    }
+    prevX = fx;
+    prevY = fy;
+  }
+  return {total, largest};
+}
+
+}  // namespace
+
+MotionBlurImageGenerator::MotionBlurImageGenerator()
+    : Hmatrix(DefaultNumSamples), IHmatrix(DefaultNumSamples) {
+  for (int i = 0; i < DefaultNumSamples; i++) {
     Hmatrix[i].Hmatrix[0][0] = 1;
     Hmatrix[i].Hmatrix[0][1] = 0;
     Hmatrix[i].Hmatrix[0][2] = 0;
@@ -28,67 +74,22 @@ MotionBlurImageGenerator::MotionBlurImageGenerator() {
   }
 }
 
-void MotionBlurImageGenerator::WarpImageGray(float* InputImg,
-                                             float* inputWeight, int iwidth,
-                                             int iheight, float* OutputImg,
-                                             float* outputWeight, int width,
-                                             int height, int i) {
-  if (i >= 0 && i < NumSamples) {
-    warpImageGray(InputImg, inputWeight, iwidth, iheight, OutputImg,
-                  outputWeight, width, height, IHmatrix[i]);
-  } else if (i < 0 && i > -NumSamples) {
-    warpImageGray(InputImg, inputWeight, iwidth, iheight, OutputImg,
-                  outputWeight, width, height, Hmatrix[-i]);
-  }
-}
-
-void MotionBlurImageGenerator::WarpImageRgb(
-    float* InputImgR, float* InputImgG, float* InputImgB, float* inputWeight,
-    int iwidth, int iheight, float* OutputImgR, float* OutputImgG,
-    float* OutputImgB, float* outputWeight, int width, int height, int i) {
-  if (i >= 0 && i < NumSamples) {
-    warpImageRgb(InputImgR, InputImgG, InputImgB, inputWeight, iwidth, iheight,
-                 OutputImgR, OutputImgG, OutputImgB, outputWeight, width,
-                 height, IHmatrix[i]);
-  } else if (i < 0 && i > -NumSamples) {
-    warpImageRgb(InputImgR, InputImgG, InputImgB, inputWeight, iwidth, iheight,
-                 OutputImgR, OutputImgG, OutputImgB, outputWeight, width,
-                 height, Hmatrix[-i]);
+std::vector<const Homography*>
+MotionBlurImageGenerator::GetSampleHomographies(bool bforward) const {
+  // Backward blur uses the homographies, except for the first sample
+  std::vector<const Homography*> homographies(GetNumSamples());
+  for (int i = 0; i < GetNumSamples(); i++) {
+    homographies[i] = bforward || i == 0 ? &IHmatrix[i] : &Hmatrix[i];
   }
+  return homographies;
 }
 
 void MotionBlurImageGenerator::blurGray(float* InputImg, float* inputWeight,
                                         int iwidth, int iheight, float* BlurImg,
                                         float* outputWeight, int width,
                                         int height, bool bforward) {
-  int i = 0, index = 0, totalpixel = width * height;
-
-  // TODO: Preinitialization, Gray only, check size
-  if (mWarpImgBuffer.empty()) {
-    SetBuffer(width, height);
-  }
-
-  memset(BlurImg, 0, totalpixel * sizeof(float));
-  memset(outputWeight, 0, totalpixel * sizeof(float));
-  for (i = 0; i < NumSamples; i++) {
-    if (bforward) {
-      WarpImageGray(InputImg, inputWeight, iwidth, iheight,
-                    mWarpImgBuffer.data(), mWarpWeightBuffer.data(), width,
-                    height, i);
-    } else {
-      WarpImageGray(InputImg, inputWeight, iwidth, iheight,
-                    mWarpImgBuffer.data(), mWarpWeightBuffer.data(), width,
-                    height, -i);
-    }
-    for (index = 0; index < totalpixel; index++) {
-      BlurImg[index] += mWarpImgBuffer[index] * mWarpWeightBuffer[index];
-      outputWeight[index] += mWarpWeightBuffer[index];
-    }
-  }
-
-  for (index = 0; index < totalpixel; index++) {
-    BlurImg[index] /= outputWeight[index];
-  }
+  blurGrayFused(InputImg, inputWeight, iwidth, iheight, BlurImg, outputWeight,
+                width, height, bforward, {});
 }
 
 void MotionBlurImageGenerator::blurRgb(float* InputImgR, float* InputImgG,
@@ -97,47 +98,198 @@ void MotionBlurImageGenerator::blurRgb(float* InputImgR, float* InputImgG,
                                        float* BlurImgG, float* BlurImgB,
                                        float* outputWeight, int width,
                                        int height, bool bforward) {
-  int i = 0, index = 0, totalpixel = width * height;
-
-  // TODO: Preinitialization, RGB only, chesk size
-  if (mWarpImgBuffer.empty()) {
-    SetBuffer(width, height);
-  }
-
-  memset(BlurImgR, 0, totalpixel * sizeof(float));
-  memset(BlurImgG, 0, totalpixel * sizeof(float));
-  memset(BlurImgB, 0, totalpixel * sizeof(float));
-  memset(outputWeight, 0, totalpixel * sizeof(float));
-  for (i = 0; i < NumSamples; i++) {
-    if (bforward) {
-      WarpImageRgb(InputImgR, InputImgG, InputImgB, inputWeight, iwidth,
-                   iheight, mWarpImgBufferR.data(), mWarpImgBufferG.data(),
-                   mWarpImgBufferB.data(), mWarpWeightBuffer.data(), width,
-                   height, i);
-    } else {
-      WarpImageRgb(InputImgR, InputImgG, InputImgB, inputWeight, iwidth,
-                   iheight, mWarpImgBufferR.data(), mWarpImgBufferG.data(),
-                   mWarpImgBufferB.data(), mWarpWeightBuffer.data(), width,
-                   height, -i);
-    }
+  blurRgbFused(InputImgR, InputImgG, InputImgB, inputWeight, iwidth, iheight,
+               BlurImgR, BlurImgG, BlurImgB, outputWeight, width, height,
+               bforward, {});
+}
 
-    for (index = 0; index < totalpixel; index++) {
-      BlurImgR[index] += mWarpImgBufferR[index] * mWarpWeightBuffer[index];
-      BlurImgG[index] += mWarpImgBufferG[index] * mWarpWeightBuffer[index];
-      BlurImgB[index] += mWarpImgBufferB[index] * mWarpWeightBuffer[index];
-      outputWeight[index] += mWarpWeightBuffer[index];
-    }
+bool MotionBlurImageGenerator::blurGrayFused(
+    float* InputImg, float* inputWeight, int iwidth, int iheight,
+    float* BlurImg, float* outputWeight, int width, int height, bool bforward,
+    const BlurEpilogue& aEpilogue) {
+  if (const auto op = GetSparseOperator(bforward, inputWeight, iwidth, iheight,
+                                        width, height)) {
+    op->blurGray(InputImg, BlurImg, outputWeight, bforward, mThreadPool.get(),
+                 aEpilogue);
+    return true;
+  }
+
+  if (mThreadPool && mParallelMode == ParallelMode::Samples &&
+      !ThreadPool::IsInsidePool()) {
+    blurGrayParallel(InputImg, inputWeight, iwidth, iheight, BlurImg,
+                     outputWeight, width, height, bforward, aEpilogue);
+    return true;
+  }
+
+  const auto homographies = GetSampleHomographies(bforward);
+  const auto map =
+      GetWarpMap(bforward, homographies.data(), iwidth, iheight, width, height);
+
+  if (map && mThreadPool) {
+    blurImageGray(InputImg, inputWeight, iwidth, iheight, BlurImg,
+                  outputWeight, width, height, *map, *mThreadPool, aEpilogue);
+  } else if (map) {
+    blurImageGray(InputImg, inputWeight, iwidth, iheight, BlurImg,
+                  outputWeight, width, height, *map, aEpilogue);
+  } else if (mThreadPool) {
+    blurImageGray(InputImg, inputWeight, iwidth, iheight, BlurImg,
+                  outputWeight, width, height, homographies.data(),
+                  GetNumSamples(), *mThreadPool, aEpilogue);
+  } else {
+    blurImageGray(InputImg, inputWeight, iwidth, iheight, BlurImg,
+                  outputWeight, width, height, homographies.data(),
+                  GetNumSamples(), aEpilogue);
+  }
+  return true;
+}
+
+bool MotionBlurImageGenerator::blurRgbFused(
+    float* InputImgR, float* InputImgG, float* InputImgB, float* inputWeight,
+    int iwidth, int iheight, float* BlurImgR, float* BlurImgG, float* BlurImgB,
+    float* outputWeight, int width, int height, bool bforward,
+    const BlurEpilogue& aEpilogue) {
+  if (const auto op = GetSparseOperator(bforward, inputWeight, iwidth, iheight,
+                                        width, height)) {
+    op->blurRgb(InputImgR, InputImgG, InputImgB, BlurImgR, BlurImgG, BlurImgB,
+                outputWeight, bforward, mThreadPool.get(), aEpilogue);
+    return true;
+  }
+
+  if (mThreadPool && mParallelMode == ParallelMode::Samples &&
+      !ThreadPool::IsInsidePool()) {
+    blurRgbParallel(InputImgR, InputImgG, InputImgB, inputWeight, iwidth,
+                    iheight, BlurImgR, BlurImgG, BlurImgB, outputWeight, width,
+                    height, bforward, aEpilogue);
+    return true;
+  }
+
+  const auto homographies = GetSampleHomographies(bforward);
+  const auto map =
+      GetWarpMap(bforward, homographies.data(), iwidth, iheight, width, height);
+
+  if (map && mThreadPool) {
+    blurImageRgb(InputImgR, InputImgG, InputImgB, inputWeight, iwidth, iheight,
+                 BlurImgR, BlurImgG, BlurImgB, outputWeight, width, height,
+                 *map, *mThreadPool, aEpilogue);
+  } else if (map) {
+    blurImageRgb(InputImgR, InputImgG, InputImgB, inputWeight, iwidth, iheight,
+                 BlurImgR, BlurImgG, BlurImgB, outputWeight, width, height,
+                 *map, aEpilogue);
+  } else if (mThreadPool) {
+    blurImageRgb(InputImgR, InputImgG, InputImgB, inputWeight, iwidth, iheight,
+                 BlurImgR, BlurImgG, BlurImgB, outputWeight, width, height,
+                 homographies.data(), GetNumSamples(), *mThreadPool, aEpilogue);
+  } else {
+    blurImageRgb(InputImgR, InputImgG, InputImgB, inputWeight, iwidth, iheight,
+                 BlurImgR, BlurImgG, BlurImgB, outputWeight, width, height,
+                 homographies.data(), GetNumSamples(), aEpilogue);
+  }
+  return true;
+}
+
+void MotionBlurImageGenerator::blurGrayParallel(
+    float* InputImg, float* inputWeight, int iwidth, int iheight,
+    float* BlurImg, float* outputWeight, int width, int height, bool bforward,
+    const BlurEpilogue& aEpilogue) {
+  const int totalpixel = width * height;
+  const int numWorkers = GetNumWorkers();
+
+  if (mWorkerBuffers.size() < std::size_t(numWorkers) ||
+      mWorkerBuffers[0].mBlurImgBuffer.size() < std::size_t(totalpixel)) {
+    SetBuffer(width, height, 1);
   }
 
-  for (index = 0; index < totalpixel; index++) {
-    BlurImgR[index] /= outputWeight[index];
-    BlurImgG[index] /= outputWeight[index];
-    BlurImgB[index] /= outputWeight[index];
+  const auto homographies = GetSampleHomographies(bforward);
+
+  mThreadPool->parallelFor(0, numWorkers, [&](int worker) {
+    auto& buffers = mWorkerBuffers[worker];
+    memset(buffers.mBlurImgBuffer.data(), 0, totalpixel * sizeof(float));
+    memset(buffers.mBlurWeightBuffer.data(), 0, totalpixel * sizeof(float));
+
+    const int first = worker * GetNumSamples() / numWorkers;
+    const int last = (worker + 1) * GetNumSamples() / numWorkers;
+    accumulateBlurGray(InputImg, inputWeight, iwidth, iheight,
+                       buffers.mBlurImgBuffer.data(),
+                       buffers.mBlurWeightBuffer.data(), width, height,
+                       homographies.data() + first, last - first);
+  });
+
+  // Merge the partial sums in worker order, so the result does not depend on
+  // the scheduling
+  mThreadPool->parallelFor(0, height, [&](int y) {
+    for (int index = y * width; index < (y + 1) * width; index++) {
+      BlurImg[index] = mWorkerBuffers[0].mBlurImgBuffer[index];
+      outputWeight[index] = mWorkerBuffers[0].mBlurWeightBuffer[index];
+      for (int worker = 1; worker < numWorkers; worker++) {
+        BlurImg[index] += mWorkerBuffers[worker].mBlurImgBuffer[index];
+        outputWeight[index] += mWorkerBuffers[worker].mBlurWeightBuffer[index];
+      }
+      BlurImg[index] /= outputWeight[index];
+    }
+    if (aEpilogue) {
+      aEpilogue(y * width, (y + 1) * width);
+    }
+  });
+}
+
+void MotionBlurImageGenerator::blurRgbParallel(
+    float* InputImgR, float* InputImgG, float* InputImgB, float* inputWeight,
+    int iwidth, int iheight, float* BlurImgR, float* BlurImgG, float* BlurImgB,
+    float* outputWeight, int width, int height, bool bforward,
+    const BlurEpilogue& aEpilogue) {
+  const int totalpixel = width * height;
+  const int numWorkers = GetNumWorkers();
+
+  if (mWorkerBuffers.size() < std::size_t(numWorkers) ||
+      mWorkerBuffers[0].mBlurImgBufferR.size() < std::size_t(totalpixel)) {
+    SetBuffer(width, height, 3);
   }
+
+  const auto homographies = GetSampleHomographies(bforward);
+
+  mThreadPool->parallelFor(0, numWorkers, [&](int worker) {
+    auto& buffers = mWorkerBuffers[worker];
+    memset(buffers.mBlurImgBufferR.data(), 0, totalpixel * sizeof(float));
+    memset(buffers.mBlurImgBufferG.data(), 0, totalpixel * sizeof(float));
+    memset(buffers.mBlurImgBufferB.data(), 0, totalpixel * sizeof(float));
+    memset(buffers.mBlurWeightBuffer.data(), 0, totalpixel * sizeof(float));
+
+    const int first = worker * GetNumSamples() / numWorkers;
+    const int last = (worker + 1) * GetNumSamples() / numWorkers;
+    accumulateBlurRgb(InputImgR, InputImgG, InputImgB, inputWeight, iwidth,
+                      iheight, buffers.mBlurImgBufferR.data(),
+                      buffers.mBlurImgBufferG.data(),
+                      buffers.mBlurImgBufferB.data(),
+                      buffers.mBlurWeightBuffer.data(), width, height,
+                      homographies.data() + first, last - first);
+  });
+
+  // Merge the partial sums in worker order, so the result does not depend on
+  // the scheduling
+  mThreadPool->parallelFor(0, height, [&](int y) {
+    for (int index = y * width; index < (y + 1) * width; index++) {
+      BlurImgR[index] = mWorkerBuffers[0].mBlurImgBufferR[index];
+      BlurImgG[index] = mWorkerBuffers[0].mBlurImgBufferG[index];
+      BlurImgB[index] = mWorkerBuffers[0].mBlurImgBufferB[index];
+      outputWeight[index] = mWorkerBuffers[0].mBlurWeightBuffer[index];
+      for (int worker = 1; worker < numWorkers; worker++) {
+        BlurImgR[index] += mWorkerBuffers[worker].mBlurImgBufferR[index];
+        BlurImgG[index] += mWorkerBuffers[worker].mBlurImgBufferG[index];
+        BlurImgB[index] += mWorkerBuffers[worker].mBlurImgBufferB[index];
+        outputWeight[index] += mWorkerBuffers[worker].mBlurWeightBuffer[index];
+      }
+      BlurImgR[index] /= outputWeight[index];
+      BlurImgG[index] /= outputWeight[index];
+      BlurImgB[index] /= outputWeight[index];
+    }
+    if (aEpilogue) {
+      aEpilogue(y * width, (y + 1) * width);
+    }
+  });
 }
 
 void MotionBlurImageGenerator::SetHomography(Homography H, int i) {
-  if (i >= 0 && i < NumSamples) {
+  if (i >= 0 && i < GetNumSamples()) {
     memcpy(Hmatrix[i].Hmatrix[0], H.Hmatrix[0], 3 * sizeof(float));
     memcpy(Hmatrix[i].Hmatrix[1], H.Hmatrix[1], 3 * sizeof(float));
     memcpy(Hmatrix[i].Hmatrix[2], H.Hmatrix[2], 3 * sizeof(float));
@@ -146,10 +298,67 @@ void MotionBlurImageGenerator::SetHomography(Homography H, int i) {
   }
 }
 
+void MotionBlurImageGenerator::SetNumSamples(int aNumSamples) {
+  if (aNumSamples <= 0) {
+    throw std::invalid_argument("The number of samples must be positive");
+  }
+  if (aNumSamples == GetNumSamples()) {
+    return;
+  }
+
+  Hmatrix = Homography::ResampleMotion(Hmatrix, aNumSamples);
+  IHmatrix.resize(aNumSamples);
+  for (int i = 0; i < aNumSamples; i++) {
+    Homography::MatrixInverse(Hmatrix[i].Hmatrix, IHmatrix[i].Hmatrix);
+  }
+  // The samples are shared by at most as many workers
+  ClearBuffer();
+}
+
+float MotionBlurImageGenerator::GetSampleSpacing(int width, int height) const {
+  float spacing = 0.0f;
+  for (const auto* samples : {&Hmatrix, &IHmatrix}) {
+    for (const auto& [x, y] : borderPoints(width, height)) {
+      spacing = std::max(spacing,
+                         pathSteps(*samples, x, y, width, height).second);
+    }
+  }
+  return spacing;
+}
+
+int MotionBlurImageGenerator::GetAdaptiveNumSamples(int width, int height,
+                                                    float aMaxSpacing,
+                                                    int aMaxSamples) const {
+  if (GetNumSamples() < 2) {
+    return GetNumSamples();
+  }
+  // Length of the longest path of a border point over the exposure. The
+  // samples cover it with GetNumSamples() steps, the last one continuing
+  // the motion past the last sample, so the path gets one mean step more.
+  float length = 0.0f;
+  for (const auto* samples : {&Hmatrix, &IHmatrix}) {
+    for (const auto& [x, y] : borderPoints(width, height)) {
+      length = std::max(length,
+                        pathSteps(*samples, x, y, width, height).first);
+    }
+  }
+  length *= float(GetNumSamples()) / (GetNumSamples() - 1);
+  const int numSamples = static_cast<int>(std::ceil(length / aMaxSpacing));
+  return std::clamp(numSamples, 1, aMaxSamples);
+}
+
+int MotionBlurImageGenerator::SetAdaptiveNumSamples(int width, int height,
+                                                    float aMaxSpacing,
+                                                    int aMaxSamples) {
+  SetNumSamples(
+      GetAdaptiveNumSamples(width, height, aMaxSpacing, aMaxSamples));
+  return GetNumSamples();
+}
+
 void MotionBlurImageGenerator::SetGlobalRotation(float degree) {
   int i = 0;
-  float deltadegree = (degree * M_PI / 180.0f) / NumSamples;
-  for (i = 0; i < NumSamples; i++) {
+  float deltadegree = (degree * M_PI / 180.0f) / GetNumSamples();
+  for (i = 0; i < GetNumSamples(); i++) {
     Hmatrix[i].Hmatrix[0][0] = cos(deltadegree * i);
     Hmatrix[i].Hmatrix[0][1] = sin(deltadegree * i);
     Hmatrix[i].Hmatrix[0][2] = 0;
@@ -172,8 +381,8 @@ void MotionBlurImageGenerator::SetGlobalRotation(float degree) {
 }
 void MotionBlurImageGenerator::SetGlobalScaling(float scalefactor) {
   int i = 0;
-  float deltascale = (scalefactor - 1.0f) / NumSamples;
-  for (i = 0; i < NumSamples; i++) {
+  float deltascale = (scalefactor - 1.0f) / GetNumSamples();
+  for (i = 0; i < GetNumSamples(); i++) {
     Hmatrix[i].Hmatrix[0][0] = 1.0f + i * deltascale;
     Hmatrix[i].Hmatrix[0][1] = 0;
     Hmatrix[i].Hmatrix[0][2] = 0;
@@ -196,9 +405,9 @@ void MotionBlurImageGenerator::SetGlobalScaling(float scalefactor) {
 }
 void MotionBlurImageGenerator::SetGlobalTranslation(float dx, float dy) {
   int i = 0;
-  float deltadx = dx / NumSamples;
-  float deltady = dy / NumSamples;
-  for (i = 0; i < NumSamples; i++) {
+  float deltadx = dx / GetNumSamples();
+  float deltady = dy / GetNumSamples();
+  for (i = 0; i < GetNumSamples(); i++) {
     Hmatrix[i].Hmatrix[0][0] = 1;
     Hmatrix[i].Hmatrix[0][1] = 0;
     Hmatrix[i].Hmatrix[0][2] = i * deltadx;
@@ -222,9 +431,9 @@ void MotionBlurImageGenerator::SetGlobalTranslation(float dx, float dy) {
 
 void MotionBlurImageGenerator::SetGlobalPerspective(float px, float py) {
   int i = 0;
-  float deltapx = px / NumSamples;
-  float deltapy = py / NumSamples;
-  for (i = 0; i < NumSamples; i++) {
+  float deltapx = px / GetNumSamples();
+  float deltapy = py / GetNumSamples();
+  for (i = 0; i < GetNumSamples(); i++) {
     Hmatrix[i].Hmatrix[0][0] = 1;
     Hmatrix[i].Hmatrix[0][1] = 0;
     Hmatrix[i].Hmatrix[0][2] = 0;
@@ -251,13 +460,13 @@ void MotionBlurImageGenerator::SetGlobalParameters(float degree,
                                                    float py, float dx,
                                                    float dy) {
   int i = 0;
-  float deltadegree = (degree * M_PI / 180.0f) / NumSamples;
-  float deltascale = (scalefactor - 1.0f) / NumSamples;
-  float deltapx = px / NumSamples;
-  float deltapy = py / NumSamples;
-  float deltadx = dx / NumSamples;
-  float deltady = dy / NumSamples;
-  for (i = 0; i < NumSamples; i++) {
+  float deltadegree = (degree * M_PI / 180.0f) / GetNumSamples();
+  float deltascale = (scalefactor - 1.0f) / GetNumSamples();
+  float deltapx = px / GetNumSamples();
+  float deltapy = py / GetNumSamples();
+  float deltadx = dx / GetNumSamples();
+  float deltady = dy / GetNumSamples();
+  for (i = 0; i < GetNumSamples(); i++) {
     Hmatrix[i].Hmatrix[0][0] = cos(deltadegree * i) * (1.0f + i * deltascale);
     Hmatrix[i].Hmatrix[0][1] = sin(deltadegree * i);
     Hmatrix[i].Hmatrix[0][2] = i * deltadx;
@@ -272,18 +481,144 @@ void MotionBlurImageGenerator::SetGlobalParameters(float degree,
   }
 }
 
-void MotionBlurImageGenerator::SetBuffer(int width, int height) {
-  mWarpImgBuffer.resize(width * height);
-  mWarpImgBufferR.resize(width * height);
-  mWarpImgBufferG.resize(width * height);
-  mWarpImgBufferB.resize(width * height);
-  mWarpWeightBuffer.resize(width * height);
+void MotionBlurImageGenerator::SetBuffer(int width, int height,
+                                         int channels) {
+  // The blur accumulates directly into its outputs, only the parallel
+  // samples mode needs partial sums
+  if (mThreadPool && mParallelMode == ParallelMode::Samples) {
+    SetWorkerBuffer(width, height, channels);
+  }
+}
+
+void MotionBlurImageGenerator::ClearBuffer() { mWorkerBuffers.clear(); }
+
+void MotionBlurImageGenerator::SetBufferPool(BufferPool& aPool) {
+  ClearBuffer();
+  mBufferPool = &aPool;
+}
+
+void MotionBlurImageGenerator::SetNumThreads(int aNumThreads) {
+  ClearBuffer();
+
+  if (aNumThreads > 1) {
+    mThreadPool = std::make_unique<ThreadPool>(aNumThreads);
+  } else {
+    mThreadPool.reset();
+  }
+}
+
+int MotionBlurImageGenerator::GetNumThreads() const {
+  return mThreadPool ? mThreadPool->GetNumThreads() : 1;
+}
+
+void MotionBlurImageGenerator::SetParallelMode(ParallelMode aMode) {
+  ClearBuffer();
+  mParallelMode = aMode;
 }
 
-void MotionBlurImageGenerator::ClearBuffer() {
-  mWarpImgBuffer.clear();
-  mWarpImgBufferR.clear();
-  mWarpImgBufferG.clear();
-  mWarpImgBufferB.clear();
-  mWarpWeightBuffer.clear();
+void MotionBlurImageGenerator::SetWarpMapBudget(std::size_t aBytes) {
+  std::lock_guard lock(mWarpMapMutex);
+  mWarpMapBudget = aBytes;
+  mWarpMaps[0].reset();
+  mWarpMaps[1].reset();
+}
+
+std::size_t MotionBlurImageGenerator::GetWarpMapBytes() const {
+  std::lock_guard lock(mWarpMapMutex);
+  std::size_t bytes = 0;
+  for (const auto& map : mWarpMaps) {
+    if (map) bytes += map->GetBytes();
+  }
+  return bytes;
+}
+
+std::shared_ptr<const WarpMap> MotionBlurImageGenerator::GetWarpMap(
+    bool bforward, const Homography* const* homographies, int iwidth,
+    int iheight, int width, int height) {
+  std::lock_guard lock(mWarpMapMutex);
+  // The taps are the positions of the scalar sampler, gathered one pixel at
+  // a time from a map streamed from memory. The vector samplers compute the
+  // positions about as fast or faster, and their Incremental positions are
+  // not the scalar ones.
+  if (mWarpMapBudget == 0 || getSamplerIsa() != SamplerIsa::Scalar) {
+    return nullptr;
+  }
+
+  auto& map = mWarpMaps[bforward ? 1 : 0];
+  if (map && map->Matches(homographies, GetNumSamples(), iwidth, iheight,
+                          width, height)) {
+    return map;
+  }
+
+  // A map of other samples or sizes is replaced, if the new one fits
+  map.reset();
+  const auto& otherMap = mWarpMaps[bforward ? 0 : 1];
+  const std::size_t otherBytes = otherMap ? otherMap->GetBytes() : 0;
+  if (otherBytes + WarpMap::GetBytes(GetNumSamples(), width, height) >
+      mWarpMapBudget) {
+    return nullptr;
+  }
+
+  map = std::make_shared<const WarpMap>(homographies, GetNumSamples(),
+                                        iwidth, iheight, width, height,
+                                        mThreadPool.get());
+  return map;
+}
+
+void MotionBlurImageGenerator::SetSparseOperator(bool aEnabled) {
+  std::lock_guard lock(mSparseOperatorMutex);
+  mSparseOperatorEnabled = aEnabled;
+  mSparseOperator.reset();
+}
+
+std::size_t MotionBlurImageGenerator::GetSparseOperatorBytes() const {
+  std::lock_guard lock(mSparseOperatorMutex);
+  return mSparseOperator ? mSparseOperator->GetBytes() : 0;
+}
+
+std::shared_ptr<const SparseBlurOperator>
+MotionBlurImageGenerator::GetSparseOperator(bool bforward,
+                                            const float* inputWeight,
+                                            int iwidth, int iheight, int width,
+                                            int height) {
+  std::lock_guard lock(mSparseOperatorMutex);
+  if (!mSparseOperatorEnabled || (bforward && inputWeight)) {
+    return nullptr;
+  }
+
+  // The operator is the forward blur, the backward blur is its adjoint
+  if (!bforward) {
+    std::swap(iwidth, width);
+    std::swap(iheight, height);
+  }
+  const auto homographies = GetSampleHomographies(true);
+
+  if (!mSparseOperator ||
+      !mSparseOperator->Matches(homographies.data(), GetNumSamples(), iwidth,
+                                iheight, width, height)) {
+    mSparseOperator.reset();
+    mSparseOperator = std::make_shared<const SparseBlurOperator>(
+        homographies.data(), GetNumSamples(), iwidth, iheight, width, height,
+        mThreadPool.get());
+  }
+  return mSparseOperator;
+}
+
+int MotionBlurImageGenerator::GetNumWorkers() const {
+  return std::min(GetNumThreads(), GetNumSamples());
+}
+
+void MotionBlurImageGenerator::SetWorkerBuffer(int width, int height,
+                                               int channels) {
+  mWorkerBuffers.resize(GetNumWorkers());
+  for (auto& buffers : mWorkerBuffers) {
+    if (channels == 1) {
+      buffers.mBlurImgBuffer.resize(width * height, *mBufferPool);
+    } else {
+      buffers.mBlurImgBufferR.resize(width * height, *mBufferPool);
+      buffers.mBlurImgBufferG.resize(width * height, *mBufferPool);
+      buffers.mBlurImgBufferB.resize(width * height, *mBufferPool);
+    }
+    buffers.mBlurWeightBuffer.resize(width * height, *mBufferPool);
+  }
 }
\ No newline at end of file
@@ -43,11 +43,10 @@ bool setBlur(int aBlurType, MotionBlurImageGenerator& aBlurGenerator) {
       printf("Translational motion example blurring\n");
       // Testing case for translational motion
       {
+        const int numSamples = aBlurGenerator.GetNumSamples();
         float deltadx = 0.8f;
-        for (int i = 0; i < MotionBlurImageGenerator::NumSamples; i++) {
-          float dy =
-              5.0f *
-              sin((float)(i) / MotionBlurImageGenerator::NumSamples * 2 * M_PI);
+        for (int i = 0; i < numSamples; i++) {
+          float dy = 5.0f * sin((float)(i) / numSamples * 2 * M_PI);
           aBlurGenerator.Hmatrix[i].Hmatrix[0][0] = 1;
           aBlurGenerator.Hmatrix[i].Hmatrix[0][1] = 0;
           aBlurGenerator.Hmatrix[i].Hmatrix[0][2] = i * deltadx;
@@ -71,16 +70,14 @@ bool setBlur(int aBlurType, MotionBlurImageGenerator& aBlurGenerator) {
       printf("Case 1-4 example blurring\n");
       // Adjust the parameters for generating test case 1-15
       {
+        const int numSamples = aBlurGenerator.GetNumSamples();
         float deltadx = 0.8f;
-        float deltascaling = 0.2f / MotionBlurImageGenerator::NumSamples;
-        float deltapx = 0.001f / MotionBlurImageGenerator::NumSamples;
-        float deltapy = 0.001f / MotionBlurImageGenerator::NumSamples;
-        float deltadegree =
-            (10.0f * M_PI / 180.0f) / MotionBlurImageGenerator::NumSamples;
-        for (int i = 0; i < MotionBlurImageGenerator::NumSamples; i++) {
-          float dy =
-              5.0f *
-              sin((float)(i) / MotionBlurImageGenerator::NumSamples * 2 * M_PI);
+        float deltascaling = 0.2f / numSamples;
+        float deltapx = 0.001f / numSamples;
+        float deltapy = 0.001f / numSamples;
+        float deltadegree = (10.0f * M_PI / 180.0f) / numSamples;
+        for (int i = 0; i < numSamples; i++) {
+          float dy = 5.0f * sin((float)(i) / numSamples * 2 * M_PI);
           aBlurGenerator.Hmatrix[i].Hmatrix[0][0] =
               (1 + i * deltascaling) * cos(deltadegree * i);
           aBlurGenerator.Hmatrix[i].Hmatrix[0][1] = sin(deltadegree * i);
@@ -4,12 +4,14 @@
 #include <cmath>
 #include <cstdio>
 #include <cstring>
+#include <stdexcept>
 
 #include "BicubicInterpolation.h"
 #include "warping.h"
 
-ProjectiveMotionRLMultiScaleGray::ProjectiveMotionRLMultiScaleGray() {
-  for (int i = 0; i < NumSamples; i++) {
+ProjectiveMotionRLMultiScaleGray::ProjectiveMotionRLMultiScaleGray()
+    : Hmatrix(DefaultNumSamples), IHmatrix(DefaultNumSamples) {
+  for (int i = 0; i < DefaultNumSamples; i++) {
     Hmatrix[i].Hmatrix[0][0] = 1;
     Hmatrix[i].Hmatrix[0][1] = 0;
     Hmatrix[i].Hmatrix[0][2] = 0;
@@ -35,6 +37,17 @@ ProjectiveMotionRLMultiScaleGray::~ProjectiveMotionRLMultiScaleGray() {
   ClearBuffer();
 }
 
+void ProjectiveMotionRLMultiScaleGray::SetNumSamples(int aNumSamples) {
+  if (aNumSamples <= 0) {
+    throw std::invalid_argument("The number of samples must be positive");
+  }
+  Hmatrix = Homography::ResampleMotion(Hmatrix, aNumSamples);
+  IHmatrix.resize(aNumSamples);
+  for (int i = 0; i < aNumSamples; i++) {
+    Homography::MatrixInverse(Hmatrix[i].Hmatrix, IHmatrix[i].Hmatrix);
+  }
+}
+
 void ProjectiveMotionRLMultiScaleGray::GenerateMotionBlurImgGray(
     float* InputImg, float* inputWeight, int iwidth, int iheight,
     float* BlurImg, float* outputWeight, int width, int height, bool bforward) {
@@ -46,7 +59,7 @@ void ProjectiveMotionRLMultiScaleGray::GenerateMotionBlurImgGray(
 
   memset(BlurImg, 0, totalpixel * sizeof(float));
   memset(outputWeight, 0, totalpixel * sizeof(float));
-  for (i = 0; i < NumSamples; i++) {
+  for (i = 0; i < GetNumSamples(); i++) {
     if (bforward) {
       WarpImageGray(InputImg, inputWeight, iwidth, iheight,
                     mWarpImgBuffer.data(), mWarpWeightBuffer.data(), width,
@@ -72,9 +85,9 @@ void ProjectiveMotionRLMultiScaleGray::ProjectiveMotionRLDeblurMultiScaleGray(
     int height, int Niter, int Nscale, bool bPoisson) {
   int i = 0, iscale = 0, x = 0, y = 0, index = 0, itr = 0;
   float* InputWeight = nullptr;
-  float HFactor[NumSamples];
+  std::vector<float> HFactor(GetNumSamples());
   float ScaleFactor = sqrt(2.0f);
-  for (i = 0; i < NumSamples; i++) {
+  for (i = 0; i < GetNumSamples(); i++) {
     HFactor[i] = Hmatrix[i].Hmatrix[2][2];
   }
 
@@ -90,7 +103,7 @@ void ProjectiveMotionRLMultiScaleGray::ProjectiveMotionRLDeblurMultiScaleGray(
     printf("Level %d: %d %d\n", iscale, bwidth, bheight);
     float bfactw = (float)(iwidth - 1) / (float)(bwidth - 1),
           bfacth = (float)(iheight - 1) / (float)(bheight - 1);
-    for (i = 0; i < NumSamples; i++) {
+    for (i = 0; i < GetNumSamples(); i++) {
       Hmatrix[i].Hmatrix[2][2] = HFactor[i] * powfactor;
       Hmatrix[i].MatrixInverse(Hmatrix[i].Hmatrix, IHmatrix[i].Hmatrix);
     }
@@ -136,10 +149,10 @@ void ProjectiveMotionRLMultiScaleGray::ProjectiveMotionRLDeblurMultiScaleGray(
 void ProjectiveMotionRLMultiScaleGray::WarpImageGray(
     float* InputImg, float* inputWeight, int iwidth, int iheight,
     float* OutputImg, float* outputWeight, int width, int height, int i) {
-  if (i >= 0 && i < NumSamples) {
+  if (i >= 0 && i < GetNumSamples()) {
     warpImageGray(InputImg, inputWeight, iwidth, iheight, OutputImg,
                   outputWeight, width, height, IHmatrix[i]);
-  } else if (i < 0 && i > -NumSamples) {
+  } else if (i < 0 && i > -GetNumSamples()) {
     warpImageGray(InputImg, inputWeight, iwidth, iheight, OutputImg,
                   outputWeight, width, height, Hmatrix[-i]);
   }
@@ -1,36 +1,334 @@
 #include "RLDeblurrer.hpp"
 
 #include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
 
 #include "DeblurParameters.hpp"
+#include "ThreadPool.hpp"
+
+namespace {
+
+// Error calculator of the batch images, which have no ground truth
+class NoErrorCalculator : public IErrorCalculator {
+ public:
+  float calculateErrorGray(float*, int, int) override { return 0.0f; }
+  float calculateErrorRgb(float*, float*, float*, int, int) override {
+    return 0.0f;
+  }
+};
+
+template <int Channels>
+using Planes = std::array<float*, Channels>;
+template <int Channels>
+using ConstPlanes = std::array<const float*, Channels>;
+
+// Ratio (Poisson) or difference between the observed and the blurred value
+template <bool Poisson>
+float ratioPixel(float observed, float blurred) {
+  if constexpr (Poisson) {
+    return observed / (blurred > 0.001f ? blurred : 0.001f);
+  } else {
+    return observed - blurred;
+  }
+}
+
+// Regularized and updated value of a deblurred pixel, term is ignored if the
+// regularization was already applied
+template <bool Poisson, bool Regularized>
+float updatePixel(float value, float error, float term, float lambda) {
+  if constexpr (Regularized) {
+    value = IRegularizer::regularizePixel<Poisson>(value, term, lambda);
+    if (std::isnan(value)) value = 0;
+  }
+  if constexpr (Poisson) {
+    value *= error;
+  } else {
+    value += error;
+  }
+  return std::clamp(value, 0.0f, 1.0f);
+}
+
+// Ratio sweep of the pixels [begin, end): the blurred estimate in Ratio is
+// replaced by its ratio to Observed. Returns the sum of the squared
+// residuals if bResidual.
+template <bool Poisson, int Channels>
+double ratioSweep(const ConstPlanes<Channels>& Observed,
+                  const Planes<Channels>& Ratio, bool bResidual, int begin,
+                  int end) {
+  double residualSum = 0.0;
+  for (int index = begin; index < end; index++) {
+    if (bResidual) {
+      float pixelSum = 0.0f;
+      for (int c = 0; c < Channels; c++) {
+        const float residual = Observed[c][index] - Ratio[c][index];
+        pixelSum += residual * residual;
+      }
+      residualSum += pixelSum;
+    }
+    for (int c = 0; c < Channels; c++) {
+      Ratio[c][index] =
+          ratioPixel<Poisson>(Observed[c][index], Ratio[c][index]);
+    }
+  }
+  return residualSum;
+}
+
+template <int Channels>
+using RatioKernel = double (*)(const ConstPlanes<Channels>&,
+                               const Planes<Channels>&, bool, int, int);
+
+template <int Channels>
+RatioKernel<Channels> selectRatioKernel(bool bPoisson) {
+  return bPoisson ? ratioSweep<true, Channels> : ratioSweep<false, Channels>;
+}
+
+// Planes of the update sweep. Term is only read by the regularized kernels,
+// Step is nullptr outside of the accelerated mode.
+template <int Channels>
+struct UpdatePlanes {
+  Planes<Channels> Deblur;
+  ConstPlanes<Channels> Error;
+  ConstPlanes<Channels> Term;
+  Planes<Channels> Step;
+};
+
+struct UpdateSums {
+  double changeSum = 0.0;
+  double normSum = 0.0;
+  double stepDot = 0.0;
+  double stepNorm = 0.0;
+};
+
+// Stores the step of a pixel, returns its product with the previous step
+float recordStep(float value, float predicted, float& step, double& stepNorm) {
+  const float newStep = value - predicted;
+  const float dot = newStep * step;
+  stepNorm += step * step;
+  step = newStep;
+  return dot;
+}
+
+// Update sweep of the pixels [begin, end), the change sums are accumulated
+// if bChange and the steps if Step is set
+template <bool Poisson, bool Regularized, int Channels>
+void updateSweep(const UpdatePlanes<Channels>& planes, float lambda,
+                 bool bChange, int begin, int end, UpdateSums& sums) {
+  const bool bStep = planes.Step[0] != nullptr;
+  for (int index = begin; index < end; index++) {
+    float previous[Channels];
+    for (int c = 0; c < Channels; c++) {
+      float* DeblurImg = planes.Deblur[c];
+      previous[c] = DeblurImg[index];
+      DeblurImg[index] = updatePixel<Poisson, Regularized>(
+          DeblurImg[index], planes.Error[c][index],
+          Regularized ? planes.Term[c][index] : 0.0f, lambda);
+    }
+    if (bChange) {
+      float changeSum = 0.0f, normSum = 0.0f;
+      for (int c = 0; c < Channels; c++) {
+        const float value = planes.Deblur[c][index];
+        const float change = value - previous[c];
+        changeSum += change * change;
+        normSum += value * value;
+      }
+      sums.changeSum += changeSum;
+      sums.normSum += normSum;
+    }
+    if (bStep) {
+      for (int c = 0; c < Channels; c++) {
+        sums.stepDot += recordStep(planes.Deblur[c][index], previous[c],
+                                   planes.Step[c][index], sums.stepNorm);
+      }
+    }
+  }
+}
+
+template <int Channels>
+using UpdateKernel = void (*)(const UpdatePlanes<Channels>&, float, bool, int,
+                              int, UpdateSums&);
+
+template <int Channels>
+UpdateKernel<Channels> selectUpdateKernel(bool bPoisson, bool bRegularized) {
+  if (bPoisson) {
+    return bRegularized ? updateSweep<true, true, Channels>
+                        : updateSweep<true, false, Channels>;
+  }
+  return bRegularized ? updateSweep<false, true, Channels>
+                      : updateSweep<false, false, Channels>;
+}
+
+// Partial sums of the output segments of a blur, keyed by the first pixel of
+// their segment. The segments can finish in any order, the total adds the
+// partials in pixel order so it does not depend on the threads.
+template <int N>
+class SegmentSums {
+ public:
+  using Sums = std::array<double, N>;
+
+  void reset() { mPartials.clear(); }
+
+  void add(int begin, const Sums& sums) {
+    std::lock_guard lock(mMutex);
+    mPartials.emplace_back(begin, sums);
+  }
+
+  // Called once the blur is done
+  Sums total() {
+    std::sort(mPartials.begin(), mPartials.end(),
+              [](const auto& a, const auto& b) { return a.first < b.first; });
+    Sums sums{};
+    for (const auto& partial : mPartials) {
+      for (int i = 0; i < N; i++) {
+        sums[i] += partial.second[i];
+      }
+    }
+    return sums;
+  }
+
+ private:
+  std::mutex mMutex;
+  std::vector<std::pair<int, Sums>> mPartials;
+};
+
+// Early termination of the iterations. The sums are accumulated by the
+// ratio and update sweeps, which can run concurrently on several tiles.
+class ConvergenceMonitor {
+ public:
+  ConvergenceMonitor(const DeblurParameters& aParameters, int numValues)
+      : mParameters(aParameters),
+        mNumValues(numValues),
+        mStart(std::chrono::steady_clock::now()) {}
+
+  bool checkResidual() const { return mParameters.residualThreshold > 0; }
+  bool checkChange() const { return mParameters.relativeChangeThreshold > 0; }
+
+  void reset() {
+    mResidualSums.reset();
+    mChangeSums.reset();
+  }
+
+  // begin is the first pixel of the segment of the sums
+  void addResidual(int begin, double residualSum) {
+    mResidualSums.add(begin, {residualSum});
+  }
+
+  void addChange(int begin, double changeSum, double normSum) {
+    mChangeSums.add(begin, {changeSum, normSum});
+  }
+
+  // Checked after every iteration, returns true and the reason to stop
+  bool stop(DeblurStopReason& reason) {
+    if (checkChange()) {
+      const double threshold = mParameters.relativeChangeThreshold;
+      const auto [changeSum, normSum] = mChangeSums.total();
+      if (changeSum <= threshold * threshold * normSum) {
+        reason = DeblurStopReason::RelativeChange;
+        return true;
+      }
+    }
+    if (checkResidual()) {
+      if (std::sqrt(mResidualSums.total()[0] / mNumValues) <
+          mParameters.residualThreshold) {
+        reason = DeblurStopReason::Residual;
+        return true;
+      }
+    }
+    if (mParameters.maxSeconds > 0) {
+      const std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - mStart;
+      if (elapsed.count() >= mParameters.maxSeconds) {
+        reason = DeblurStopReason::TimeBudget;
+        return true;
+      }
+    }
+    return false;
+  }
+
+ private:
+  const DeblurParameters& mParameters;
+  const int mNumValues;
+  const std::chrono::steady_clock::time_point mStart;
+
+  SegmentSums<1> mResidualSums;
+  SegmentSums<2> mChangeSums;
+};
+
+// Biggs-Andrews vector extrapolation. Every iteration starts from the
+// prediction y = x + alpha * (x - x_prev) and alpha is the correlation of
+// the last two steps g = RL(y) - y, accumulated by the update sweep.
+class Extrapolation {
+ public:
+  void reset() { mStepSums.reset(); }
+
+  // begin is the first pixel of the segment of the sums
+  void addSteps(int begin, double stepDot, double stepNorm) {
+    mStepSums.add(begin, {stepDot, stepNorm});
+  }
+
+  double stepDot() { return mStepSums.total()[0]; }
+  double stepNorm() { return mStepSums.total()[1]; }
+
+  // Prediction weight of the next iteration, 0 until two steps are known
+  float alpha() {
+    const auto [stepDot, stepNorm] = mStepSums.total();
+    if (stepNorm <= 0.0) return 0.0f;
+    return std::clamp(static_cast<float>(stepDot / stepNorm), 0.0f, 1.0f);
+  }
+
+ private:
+  SegmentSums<2> mStepSums;
+};
+
+// Replaces Img by the prediction and keeps the current estimate in PrevImg
+void predictPixels(float* Img, float* PrevImg, int size, float alpha) {
+  for (int index = 0; index < size; index++) {
+    const float value = Img[index];
+    Img[index] =
+        std::clamp(value + alpha * (value - PrevImg[index]), 0.0f, 1.0f);
+    PrevImg[index] = value;
+  }
+}
+
+}  // namespace
 
 RLDeblurrer::RLDeblurrer(IBlurImageGenerator& aBlurGenerator,
                          IErrorCalculator& aErrorCalculator)
     : mBlurGenerator(aBlurGenerator), mErrorCalculator(aErrorCalculator) {}
 
-void RLDeblurrer::SetBuffer(int width, int height) {
-  mBlurGenerator.SetBuffer(width, height);
+void RLDeblurrer::SetBuffer(int width, int height, int channels) {
+  if (!mInBatch) mBlurGenerator.SetBuffer(width, height, channels);
 
   const std::size_t newSize = width * height;
 
-  if (newSize <= mBlurImgBuffer.size()) {
-    return;
+  if (channels == 1) {
+    if (newSize > mBlurImgBuffer.size()) {
+      mBlurImgBuffer.resize(newSize, *mBufferPool);
+      mErrorImgBuffer.resize(newSize, *mBufferPool);
+    }
+  } else if (newSize > mBlurImgBufferR.size()) {
+    mBlurImgBufferR.resize(newSize, *mBufferPool);
+    mBlurImgBufferG.resize(newSize, *mBufferPool);
+    mBlurImgBufferB.resize(newSize, *mBufferPool);
+    mErrorImgBufferR.resize(newSize, *mBufferPool);
+    mErrorImgBufferG.resize(newSize, *mBufferPool);
+    mErrorImgBufferB.resize(newSize, *mBufferPool);
   }
 
-  mBlurImgBuffer.resize(newSize);
-  mBlurImgBufferR.resize(newSize);
-  mBlurImgBufferG.resize(newSize);
-  mBlurImgBufferB.resize(newSize);
-  mBlurWeightBuffer.resize(newSize);
-  mErrorImgBuffer.resize(newSize);
-  mErrorImgBufferR.resize(newSize);
-  mErrorImgBufferG.resize(newSize);
-  mErrorImgBufferB.resize(newSize);
-  mErrorWeightBuffer.resize(newSize);
+  if (newSize > mBlurWeightBuffer.size()) {
+    mBlurWeightBuffer.resize(newSize, *mBufferPool);
+    mErrorWeightBuffer.resize(newSize, *mBufferPool);
+  }
 }
 
 void RLDeblurrer::ClearBuffer() {
-  mBlurGenerator.ClearBuffer();
+  if (!mInBatch) mBlurGenerator.ClearBuffer();
 
   mBlurImgBuffer.clear();
   mBlurImgBufferR.clear();
@@ -45,139 +343,422 @@ void RLDeblurrer::ClearBuffer() {
   mErrorImgBufferB.clear();
 
   mErrorWeightBuffer.clear();
+
+  mPrevImgBuffer.clear();
+  mPrevImgBufferR.clear();
+  mPrevImgBufferG.clear();
+  mPrevImgBufferB.clear();
+
+  mStepImgBuffer.clear();
+  mStepImgBufferR.clear();
+  mStepImgBufferG.clear();
+  mStepImgBufferB.clear();
 }
 
-void RLDeblurrer::deblurGray(float* BlurImg, int iwidth, int iheight,
-                             float* DeblurImg, int width, int height,
-                             const DeblurParameters& aParameters,
-                             IRegularizer& regularizer, float lambda) {
-  int x = 0, y = 0, index = 0, itr = 0;
-  float* InputWeight = nullptr;
+void RLDeblurrer::SetBufferPool(BufferPool& aPool) {
+  ClearBuffer();
+  mBufferPool = &aPool;
+}
+
+void RLDeblurrer::SetCheckpoint(const std::string& fname, int interval) {
+  mCheckpointName = fname;
+  mCheckpointInterval = interval;
+  mCheckpointCall = 0;
+  mResume = !fname.empty() && readCheckpointState(fname, mResumeState);
+}
+
+void RLDeblurrer::RemoveCheckpoint() {
+  if (!mCheckpointName.empty()) {
+    std::remove(mCheckpointName.c_str());
+  }
+  mResume = false;
+}
+
+int RLDeblurrer::ResumeCheckpoint(std::span<float* const> planes, int width,
+                                  int height, int channels, double& stepDot,
+                                  double& stepNorm) {
+  if (mCheckpointName.empty()) return 0;
+  const int call = mCheckpointCall++;
+  if (!mResume) return 0;
 
-  std::vector<float> DeltaImg(iwidth * iheight);
+  // A checkpoint of iteration 0 holds the result of the previous call
+  const DeblurCheckpointState& state = mResumeState;
+  const int resumeCall = state.iteration > 0 ? state.call : state.call - 1;
+  if (call < resumeCall) return -1;
+
+  if (state.width != width || state.height != height ||
+      state.channels != channels) {
+    throw std::runtime_error("The checkpoint " + mCheckpointName +
+                             " does not match the deblurring call");
+  }
+  mResume = false;
+  if (state.iteration == 0) {
+    readCheckpointPlanes(mCheckpointName, state, planes.first(channels));
+    return -1;
+  }
+  readCheckpointPlanes(mCheckpointName, state, planes);
+  stepDot = state.stepDot;
+  stepNorm = state.stepNorm;
+  return state.iteration;
+}
+
+void RLDeblurrer::SaveCheckpoint(std::span<float* const> planes, int width,
+                                 int height, int channels, int iteration,
+                                 double stepDot, double stepNorm) {
+  if (mCheckpointName.empty()) return;
+
+  DeblurCheckpointState state;
+  // mCheckpointCall already counts the call
+  state.call = iteration > 0 ? mCheckpointCall - 1 : mCheckpointCall;
+  state.iteration = iteration;
+  state.width = width;
+  state.height = height;
+  state.channels = channels;
+  state.numPlanes = static_cast<int>(iteration > 0 ? planes.size() : channels);
+  state.stepDot = stepDot;
+  state.stepNorm = stepNorm;
+  const std::vector<const float*> constPlanes(planes.begin(), planes.end());
+  writeCheckpoint(mCheckpointName, state, constPlanes);
+}
+
+void RLDeblurrer::blurGray(float* InputImg, float* inputWeight, int iwidth,
+                           int iheight, float* BlurImg, float* outputWeight,
+                           int width, int height, bool bforward,
+                           const BlurEpilogue& aEpilogue) {
+  if (!mBlurGenerator.blurGrayFused(InputImg, inputWeight, iwidth, iheight,
+                                    BlurImg, outputWeight, width, height,
+                                    bforward, aEpilogue)) {
+    mBlurGenerator.blurGray(InputImg, inputWeight, iwidth, iheight, BlurImg,
+                            outputWeight, width, height, bforward);
+    aEpilogue(0, width * height);
+  }
+}
+
+void RLDeblurrer::blurRgb(float* InputImgR, float* InputImgG, float* InputImgB,
+                          float* inputWeight, int iwidth, int iheight,
+                          float* BlurImgR, float* BlurImgG, float* BlurImgB,
+                          float* outputWeight, int width, int height,
+                          bool bforward, const BlurEpilogue& aEpilogue) {
+  if (!mBlurGenerator.blurRgbFused(InputImgR, InputImgG, InputImgB,
+                                   inputWeight, iwidth, iheight, BlurImgR,
+                                   BlurImgG, BlurImgB, outputWeight, width,
+                                   height, bforward, aEpilogue)) {
+    mBlurGenerator.blurRgb(InputImgR, InputImgG, InputImgB, inputWeight,
+                           iwidth, iheight, BlurImgR, BlurImgG, BlurImgB,
+                           outputWeight, width, height, bforward);
+    aEpilogue(0, width * height);
+  }
+}
+
+DeblurResult RLDeblurrer::deblurGray(float* BlurImg, int iwidth, int iheight,
+                                     float* DeblurImg, int width, int height,
+                                     const DeblurParameters& aParameters,
+                                     IRegularizer& regularizer, float lambda) {
+  int itr = 0;
+  float* InputWeight = nullptr;
+  const bool bPoisson = aParameters.bPoisson;
+  DeblurResult result;
+  ConvergenceMonitor monitor(aParameters, iwidth * iheight);
+  Extrapolation extrapolation;
 
   ClearBuffer();
+  if (!mInBatch) mBufferPool->ResetPeak();
   if (width * height >= iwidth * iheight)
-    SetBuffer(width, height);
+    SetBuffer(width, height, 1);
   else
-    SetBuffer(iwidth, iheight);
-
-  for (itr = 0; itr < aParameters.Niter; itr++) {
-    mBlurGenerator.blurGray(DeblurImg, InputWeight, width, height,
-                            mBlurImgBuffer.data(), mBlurWeightBuffer.data(),
-                            iwidth, iheight, true);
-    for (y = 0, index = 0; y < iheight; y++) {
-      for (x = 0; x < iwidth; x++, index++) {
-        if (aParameters.bPoisson) {
-          if (mBlurImgBuffer[index] > 0.001f) {
-            DeltaImg[index] = BlurImg[index] / mBlurImgBuffer[index];
-          } else {
-            DeltaImg[index] = BlurImg[index] / 0.001f;
-          }
-        } else {
-          DeltaImg[index] = BlurImg[index] - mBlurImgBuffer[index];
-        }
-      }
+    SetBuffer(iwidth, iheight, 1);
+
+  if (aParameters.bAccelerated) {
+    mPrevImgBuffer.resize(width * height, *mBufferPool);
+    mStepImgBuffer.resize(width * height, *mBufferPool);
+  }
+  float* StepImg = aParameters.bAccelerated ? mStepImgBuffer.data() : nullptr;
+
+  float* const planes[] = {DeblurImg, mPrevImgBuffer.data(), StepImg};
+  const std::span<float* const> checkpointPlanes(
+      planes, aParameters.bAccelerated ? 3 : 1);
+  double stepDot = 0.0, stepNorm = 0.0;
+  const int firstItr = ResumeCheckpoint(checkpointPlanes, width, height, 1,
+                                        stepDot, stepNorm);
+  if (firstItr < 0) {
+    result.peakBufferBytes = mBufferPool->GetPeakBytesInUse();
+    return result;
+  }
+  extrapolation.addSteps(0, stepDot, stepNorm);
+
+  // The ratio replaces the blurred image as soon as a tile is blurred. The
+  // sweeps are specialized on the noise model, selected once per call, and
+  // on the regularization, selected every iteration.
+  float* RatioImg = mBlurImgBuffer.data();
+  const RatioKernel<1> ratioKernel = selectRatioKernel<1>(bPoisson);
+  const BlurEpilogue ratio = [&](int begin, int end) {
+    const double residualSum = ratioKernel({BlurImg}, {RatioImg},
+                                           monitor.checkResidual(), begin, end);
+    if (monitor.checkResidual()) monitor.addResidual(begin, residualSum);
+  };
+
+  // The regularization term is computed before the backward blur, which
+  // does not read the deblurred image, and applied with the update
+  UpdatePlanes<1> updatePlanes = {
+      {DeblurImg}, {mErrorImgBuffer.data()}, {}, {StepImg}};
+  UpdateKernel<1> updateKernel = nullptr;
+  const BlurEpilogue update = [&](int begin, int end) {
+    UpdateSums sums;
+    updateKernel(updatePlanes, lambda, monitor.checkChange(), begin, end,
+                 sums);
+    if (monitor.checkChange()) {
+      monitor.addChange(begin, sums.changeSum, sums.normSum);
     }
-    mBlurGenerator.blurGray(DeltaImg.data(), mBlurWeightBuffer.data(), iwidth,
-                            iheight, mErrorImgBuffer.data(),
-                            mErrorWeightBuffer.data(), width, height, false);
-
-    regularizer.applyRegularizationGray(DeblurImg, width, height,
-                                        aParameters.bPoisson, lambda);
-
-    for (y = 0, index = 0; y < height; y++) {
-      for (x = 0; x < width; x++, index++) {
-        if (aParameters.bPoisson) {
-          DeblurImg[index] *= mErrorImgBuffer[index];
-        } else {
-          DeblurImg[index] += mErrorImgBuffer[index];
-        }
-        DeblurImg[index] = std::clamp(DeblurImg[index], 0.0f, 1.0f);
-      }
+    if (StepImg) extrapolation.addSteps(begin, sums.stepDot, sums.stepNorm);
+  };
+
+  for (itr = firstItr; itr < aParameters.Niter; itr++) {
+    monitor.reset();
+    if (aParameters.bAccelerated) {
+      predictPixels(DeblurImg, mPrevImgBuffer.data(), width * height,
+                    extrapolation.alpha());
+      extrapolation.reset();
     }
+    blurGray(DeblurImg, InputWeight, width, height, RatioImg,
+             mBlurWeightBuffer.data(), iwidth, iheight, true, ratio);
+
+    const float* TermImg = nullptr;
+    if (!regularizer.computeRegularizationTermGray(DeblurImg, width, height,
+                                                   TermImg)) {
+      regularizer.applyRegularizationGray(DeblurImg, width, height, bPoisson,
+                                          lambda);
+    }
+    updatePlanes.Term = {TermImg};
+    updateKernel = selectUpdateKernel<1>(bPoisson, TermImg != nullptr);
+
+    blurGray(RatioImg, mBlurWeightBuffer.data(), iwidth, iheight,
+             mErrorImgBuffer.data(), mErrorWeightBuffer.data(), width, height,
+             false, update);
 
     mErrorCalculator.calculateErrorGray(DeblurImg, width, height);
+
+    if (monitor.stop(result.reason)) {
+      itr++;
+      break;
+    }
+    if (mCheckpointInterval > 0 && (itr + 1) % mCheckpointInterval == 0 &&
+        itr + 1 < aParameters.Niter) {
+      SaveCheckpoint(checkpointPlanes, width, height, 1, itr + 1,
+                     extrapolation.stepDot(), extrapolation.stepNorm());
+    }
   }
+  SaveCheckpoint(checkpointPlanes, width, height, 1, 0, 0.0, 0.0);
+
+  result.iterations = itr;
+  result.peakBufferBytes = mBufferPool->GetPeakBytesInUse();
+  // The buffers of the deblurrer stay for the next call, the frames other
+  // components released are freed
+  if (!mInBatch) mBufferPool->Trim();
+  return result;
 }
 
-void RLDeblurrer::deblurRgb(float* BlurImgR, float* BlurImgG, float* BlurImgB,
-                            int iwidth, int iheight, float* DeblurImgR,
-                            float* DeblurImgG, float* DeblurImgB, int width,
-                            int height, const DeblurParameters& aParameters,
-                            IRegularizer& regularizer, float lambda) {
-  int x = 0, y = 0, index = 0, itr = 0;
+DeblurResult RLDeblurrer::deblurRgb(float* BlurImgR, float* BlurImgG,
+                                    float* BlurImgB, int iwidth, int iheight,
+                                    float* DeblurImgR, float* DeblurImgG,
+                                    float* DeblurImgB, int width, int height,
+                                    const DeblurParameters& aParameters,
+                                    IRegularizer& regularizer, float lambda) {
+  int itr = 0;
   float* InputWeight = nullptr;
-
-  std::vector<float> DeltaImgR(iwidth * iheight);
-  std::vector<float> DeltaImgG(iwidth * iheight);
-  std::vector<float> DeltaImgB(iwidth * iheight);
+  const bool bPoisson = aParameters.bPoisson;
+  DeblurResult result;
+  ConvergenceMonitor monitor(aParameters, 3 * iwidth * iheight);
+  Extrapolation extrapolation;
 
   ClearBuffer();
+  if (!mInBatch) mBufferPool->ResetPeak();
   if (width * height >= iwidth * iheight)
-    SetBuffer(width, height);
+    SetBuffer(width, height, 3);
   else
-    SetBuffer(iwidth, iheight);
-
-  for (itr = 0; itr < aParameters.Niter; itr++) {
-    mBlurGenerator.blurRgb(DeblurImgR, DeblurImgG, DeblurImgB, InputWeight,
-                           width, height, mBlurImgBufferR.data(),
-                           mBlurImgBufferG.data(), mBlurImgBufferB.data(),
-                           mBlurWeightBuffer.data(), iwidth, iheight, true);
-    for (y = 0, index = 0; y < iheight; y++) {
-      for (x = 0; x < iwidth; x++, index++) {
-        if (aParameters.bPoisson) {
-          if (mBlurImgBufferR[index] > 0.001f) {
-            DeltaImgR[index] = BlurImgR[index] / mBlurImgBufferR[index];
-          } else {
-            DeltaImgR[index] = BlurImgR[index] / 0.001f;
-          }
-          if (mBlurImgBufferG[index] > 0.001f) {
-            DeltaImgG[index] = BlurImgG[index] / mBlurImgBufferG[index];
-          } else {
-            DeltaImgG[index] = BlurImgG[index] / 0.001f;
-          }
-          if (mBlurImgBufferB[index] > 0.001f) {
-            DeltaImgB[index] = BlurImgB[index] / mBlurImgBufferB[index];
-          } else {
-            DeltaImgB[index] = BlurImgB[index] / 0.001f;
-          }
-        } else {
-          DeltaImgR[index] = BlurImgR[index] - mBlurImgBufferR[index];
-          DeltaImgG[index] = BlurImgG[index] - mBlurImgBufferG[index];
-          DeltaImgB[index] = BlurImgB[index] - mBlurImgBufferB[index];
-        }
-      }
+    SetBuffer(iwidth, iheight, 3);
+
+  if (aParameters.bAccelerated) {
+    mPrevImgBufferR.resize(width * height, *mBufferPool);
+    mPrevImgBufferG.resize(width * height, *mBufferPool);
+    mPrevImgBufferB.resize(width * height, *mBufferPool);
+    mStepImgBufferR.resize(width * height, *mBufferPool);
+    mStepImgBufferG.resize(width * height, *mBufferPool);
+    mStepImgBufferB.resize(width * height, *mBufferPool);
+  }
+  float* StepImgR =
+      aParameters.bAccelerated ? mStepImgBufferR.data() : nullptr;
+  float* StepImgG = mStepImgBufferG.data();
+  float* StepImgB = mStepImgBufferB.data();
+
+  float* const planes[] = {DeblurImgR,
+                           DeblurImgG,
+                           DeblurImgB,
+                           mPrevImgBufferR.data(),
+                           mPrevImgBufferG.data(),
+                           mPrevImgBufferB.data(),
+                           StepImgR,
+                           StepImgG,
+                           StepImgB};
+  const std::span<float* const> checkpointPlanes(
+      planes, aParameters.bAccelerated ? 9 : 3);
+  double stepDot = 0.0, stepNorm = 0.0;
+  const int firstItr = ResumeCheckpoint(checkpointPlanes, width, height, 3,
+                                        stepDot, stepNorm);
+  if (firstItr < 0) {
+    result.peakBufferBytes = mBufferPool->GetPeakBytesInUse();
+    return result;
+  }
+  extrapolation.addSteps(0, stepDot, stepNorm);
+
+  const Planes<3> RatioImg = {mBlurImgBufferR.data(), mBlurImgBufferG.data(),
+                              mBlurImgBufferB.data()};
+  const RatioKernel<3> ratioKernel = selectRatioKernel<3>(bPoisson);
+  const BlurEpilogue ratio = [&](int begin, int end) {
+    const double residualSum =
+        ratioKernel({BlurImgR, BlurImgG, BlurImgB}, RatioImg,
+                    monitor.checkResidual(), begin, end);
+    if (monitor.checkResidual()) monitor.addResidual(begin, residualSum);
+  };
+
+  UpdatePlanes<3> updatePlanes = {
+      {DeblurImgR, DeblurImgG, DeblurImgB},
+      {mErrorImgBufferR.data(), mErrorImgBufferG.data(),
+       mErrorImgBufferB.data()},
+      {},
+      {StepImgR, StepImgG, StepImgB}};
+  UpdateKernel<3> updateKernel = nullptr;
+  const BlurEpilogue update = [&](int begin, int end) {
+    UpdateSums sums;
+    updateKernel(updatePlanes, lambda, monitor.checkChange(), begin, end,
+                 sums);
+    if (monitor.checkChange()) {
+      monitor.addChange(begin, sums.changeSum, sums.normSum);
     }
-    mBlurGenerator.blurRgb(DeltaImgR.data(), DeltaImgG.data(), DeltaImgB.data(),
-                           mBlurWeightBuffer.data(), iwidth, iheight,
-                           mErrorImgBufferR.data(), mErrorImgBufferG.data(),
-                           mErrorImgBufferB.data(), mErrorWeightBuffer.data(),
-                           width, height, false);
-
-    regularizer.applyRegularizationRgb(DeblurImgR, DeblurImgG, DeblurImgB,
-                                       width, height, aParameters.bPoisson,
-                                       lambda);
-
-    for (y = 0, index = 0; y < height; y++) {
-      for (x = 0; x < width; x++, index++) {
-        if (aParameters.bPoisson) {
-          DeblurImgR[index] *= mErrorImgBufferR[index];
-          DeblurImgG[index] *= mErrorImgBufferG[index];
-          DeblurImgB[index] *= mErrorImgBufferB[index];
-        } else {
-          DeblurImgR[index] += mErrorImgBufferR[index];
-          DeblurImgG[index] += mErrorImgBufferG[index];
-          DeblurImgB[index] += mErrorImgBufferB[index];
-        }
-
-        DeblurImgR[index] = std::clamp(DeblurImgR[index], 0.0f, 1.0f);
-        DeblurImgG[index] = std::clamp(DeblurImgG[index], 0.0f, 1.0f);
-        DeblurImgB[index] = std::clamp(DeblurImgB[index], 0.0f, 1.0f);
-      }
+    if (StepImgR) extrapolation.addSteps(begin, sums.stepDot, sums.stepNorm);
+  };
+
+  for (itr = firstItr; itr < aParameters.Niter; itr++) {
+    monitor.reset();
+    if (aParameters.bAccelerated) {
+      const float alpha = extrapolation.alpha();
+      predictPixels(DeblurImgR, mPrevImgBufferR.data(), width * height, alpha);
+      predictPixels(DeblurImgG, mPrevImgBufferG.data(), width * height, alpha);
+      predictPixels(DeblurImgB, mPrevImgBufferB.data(), width * height, alpha);
+      extrapolation.reset();
     }
+    blurRgb(DeblurImgR, DeblurImgG, DeblurImgB, InputWeight, width, height,
+            RatioImg[0], RatioImg[1], RatioImg[2], mBlurWeightBuffer.data(),
+            iwidth, iheight, true, ratio);
+
+    const float *TermImgR = nullptr, *TermImgG = nullptr, *TermImgB = nullptr;
+    if (!regularizer.computeRegularizationTermRgb(DeblurImgR, DeblurImgG,
+                                                  DeblurImgB, width, height,
+                                                  TermImgR, TermImgG,
+                                                  TermImgB)) {
+      regularizer.applyRegularizationRgb(DeblurImgR, DeblurImgG, DeblurImgB,
+                                         width, height, bPoisson, lambda);
+    }
+    updatePlanes.Term = {TermImgR, TermImgG, TermImgB};
+    updateKernel = selectUpdateKernel<3>(bPoisson, TermImgR != nullptr);
+
+    blurRgb(RatioImg[0], RatioImg[1], RatioImg[2], mBlurWeightBuffer.data(),
+            iwidth, iheight, mErrorImgBufferR.data(), mErrorImgBufferG.data(),
+            mErrorImgBufferB.data(), mErrorWeightBuffer.data(), width, height,
+            false, update);
 
     mErrorCalculator.calculateErrorRgb(DeblurImgR, DeblurImgG, DeblurImgB,
                                        width, height);
+
+    if (monitor.stop(result.reason)) {
+      itr++;
+      break;
+    }
+    if (mCheckpointInterval > 0 && (itr + 1) % mCheckpointInterval == 0 &&
+        itr + 1 < aParameters.Niter) {
+      SaveCheckpoint(checkpointPlanes, width, height, 3, itr + 1,
+                     extrapolation.stepDot(), extrapolation.stepNorm());
+    }
+  }
+  SaveCheckpoint(checkpointPlanes, width, height, 3, 0, 0.0, 0.0);
+
+  result.iterations = itr;
+  result.peakBufferBytes = mBufferPool->GetPeakBytesInUse();
+  // The buffers of the deblurrer stay for the next call, the frames other
+  // components released are freed
+  if (!mInBatch) mBufferPool->Trim();
+  return result;
+}
+
+DeblurResult RLDeblurrer::deblur(const Image<const float>& BlurImg,
+                                 const Image<float>& DeblurImg,
+                                 const DeblurParameters& aParameters,
+                                 IRegularizer& regularizer, float lambda) {
+  return deblurImage(BlurImg, DeblurImg, aParameters, regularizer, lambda);
+}
+
+DeblurResult RLDeblurrer::deblur(
+    const Image<const float, ImageLayout::Interleaved>& BlurImg,
+    const Image<float, ImageLayout::Interleaved>& DeblurImg,
+    const DeblurParameters& aParameters, IRegularizer& regularizer,
+    float lambda) {
+  return deblurImage(BlurImg, DeblurImg, aParameters, regularizer, lambda);
+}
+
+std::vector<DeblurResult> RLDeblurrer::deblurBatch(
+    std::span<const DeblurBatchImage> images,
+    const DeblurParameters& aParameters,
+    const RegularizerFactory& makeRegularizer, float lambda, int numThreads) {
+  std::vector<DeblurResult> results(images.size());
+
+  ClearBuffer();
+  mBufferPool->ResetPeak();
+
+  // The blurs of the tasks run serially, the images are the parallel work
+  ThreadPool threadPool(numThreads);
+  threadPool.parallelFor(0, static_cast<int>(images.size()), [&](int i) {
+    NoErrorCalculator errorCalculator;
+    RLDeblurrer deblurrer(mBlurGenerator, errorCalculator);
+    deblurrer.mBufferPool = mBufferPool;
+    deblurrer.mInBatch = true;
+
+    const std::unique_ptr<IRegularizer> regularizer = makeRegularizer();
+    regularizer->SetBufferPool(*mBufferPool);
+
+    results[i] = deblurrer.deblur(images[i].BlurImg, images[i].DeblurImg,
+                                  aParameters, *regularizer, lambda);
+  });
+
+  for (auto& result : results) {
+    result.peakBufferBytes = mBufferPool->GetPeakBytesInUse();
   }
+  // The frames of the tasks are free once they are done
+  ClearBuffer();
+  mBufferPool->Trim();
+  return results;
+}
+
+template <ImageLayout Layout>
+DeblurResult RLDeblurrer::deblurImage(const Image<const float, Layout>& BlurImg,
+                                      const Image<float, Layout>& DeblurImg,
+                                      const DeblurParameters& aParameters,
+                                      IRegularizer& regularizer,
+                                      float lambda) {
+  // The copies of non contiguous views count in the peak of the pool
+  const ImagePlanes<const float, Layout> blurred{BlurImg, *mBufferPool};
+  const ImagePlanes<float, Layout> deblurred{DeblurImg, *mBufferPool};
+
+  DeblurResult result;
+  if (BlurImg.channels() == 1) {
+    result = deblurGray(blurred[0], BlurImg.width(), BlurImg.height(),
+                        deblurred[0], DeblurImg.width(), DeblurImg.height(),
+                        aParameters, regularizer, lambda);
+  } else {
+    result = deblurRgb(blurred[0], blurred[1], blurred[2], BlurImg.width(),
+                       BlurImg.height(), deblurred[0], deblurred[1],
+                       deblurred[2], DeblurImg.width(), DeblurImg.height(),
+                       aParameters, regularizer, lambda);
+  }
+
+  deblurred.writeBack();
+  return result;
 }
@@ -0,0 +1,248 @@
+#include "SparseBlurOperator.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+struct Entry {
+  int column;
+  float value;
+};
+
+template <typename Matrix, int NumPlanes>
+void multiplyRows(const Matrix& m, const float* const* input,
+                  float* const* output, float* outputWeight, int y) {
+  for (int index = y * m.width; index < (y + 1) * m.width; index++) {
+    float sum[NumPlanes]{};
+    for (std::size_t k = m.rowStart[index]; k < m.rowStart[index + 1]; k++) {
+      const int column = m.columns[k];
+      const float value = m.values[k];
+      for (int c = 0; c < NumPlanes; c++) {
+        sum[c] += value * input[c][column];
+      }
+    }
+    for (int c = 0; c < NumPlanes; c++) {
+      output[c][index] = sum[c];
+    }
+    outputWeight[index] = m.weights[index];
+  }
+}
+
+template <int NumPlanes, typename Matrix>
+void multiply(const Matrix& m, const float* const* input, float* const* output,
+              float* outputWeight, ThreadPool* threadPool,
+              const BlurEpilogue& aEpilogue) {
+  const auto multiplyRow = [&](int y) {
+    multiplyRows<Matrix, NumPlanes>(m, input, output, outputWeight, y);
+    if (aEpilogue) {
+      aEpilogue(y * m.width, (y + 1) * m.width);
+    }
+  };
+  if (threadPool) {
+    threadPool->parallelFor(0, m.height, multiplyRow);
+  } else {
+    for (int y = 0; y < m.height; y++) {
+      multiplyRow(y);
+    }
+  }
+}
+
+}  // namespace
+
+SparseBlurOperator::SparseBlurOperator(const Homography* const* homographies,
+                                       int numSamples, int iwidth,
+                                       int iheight, int width, int height,
+                                       ThreadPool* threadPool)
+    : mIwidth(iwidth),
+      mIheight(iheight),
+      mWidth(width),
+      mHeight(height),
+      mTransform(getSamplerTransform()),
+      mResyncPixels(getSamplerResyncPixels()) {
+  for (int i = 0; i < numSamples; i++) {
+    mHomographies.push_back(*homographies[i]);
+  }
+  Assemble(homographies, numSamples, threadPool);
+  Transpose();
+}
+
+void SparseBlurOperator::Assemble(const Homography* const* homographies,
+                                  int numSamples, ThreadPool* threadPool) {
+  mForward.width = mWidth;
+  mForward.height = mHeight;
+  mForward.rowStart.assign(std::size_t(mWidth) * mHeight + 1, 0);
+  mForward.weights.resize(std::size_t(mWidth) * mHeight);
+
+  // Fractions of the clamped last column and row, as accumulateTaps
+  const float xClamp = mIwidth - 1.001f, yClamp = mIheight - 1.001f;
+  const float xClampFraction = xClamp - (int)(xClamp);
+  const float yClampFraction = yClamp - (int)(yClamp);
+
+  // The rows of every output row are assembled apart, then concatenated
+  std::vector<std::vector<Entry>> rowEntries(mHeight);
+  const auto assembleRow = [&](int y) {
+    std::vector<WarpTap> taps(std::size_t(numSamples) * mWidth);
+    for (int i = 0; i < numSamples; i++) {
+      computeWarpTaps(mIwidth, mIheight, mWidth, mHeight, *homographies[i], y,
+                      0, mWidth, taps.data() + std::size_t(i) * mWidth);
+    }
+
+    auto& entries = rowEntries[y];
+    std::vector<Entry> pixel;
+    for (int x = 0; x < mWidth; x++) {
+      pixel.clear();
+      float weightSum = 0.0f;
+      for (int i = 0; i < numSamples; i++) {
+        const WarpTap& tap = taps[std::size_t(i) * mWidth + x];
+        const bool inside = tap.index >= 0;
+        const int index = inside ? tap.index : ~tap.index;
+        float fx = tap.fx, fy = tap.fy;
+        const float weight = inside ? 1.01f : 0.01f;
+        if (inside) {
+          if (fx < 0) fx = xClampFraction;
+          if (fy < 0) fy = yClampFraction;
+        }
+
+        // The weights of interpolateTap
+        const float w1 = (1.0f - fx) * fy;
+        const float w2 = fx * (1.0f - fy);
+        const float w3 = fx * fy;
+        const float w0 = 1.0f - w1 - w2 - w3;
+        pixel.push_back({index, w0 * weight});
+        pixel.push_back({index + mIwidth, w1 * weight});
+        pixel.push_back({index + 1, w2 * weight});
+        pixel.push_back({index + mIwidth + 1, w3 * weight});
+        weightSum += weight;
+      }
+
+      std::sort(pixel.begin(), pixel.end(),
+                [](const Entry& a, const Entry& b) {
+                  return a.column < b.column;
+                });
+      std::size_t count = 0;
+      for (std::size_t k = 0; k < pixel.size();) {
+        Entry merged = pixel[k++];
+        while (k < pixel.size() && pixel[k].column == merged.column) {
+          merged.value += pixel[k++].value;
+        }
+        if (merged.value != 0.0f) {
+          entries.push_back({merged.column, merged.value / weightSum});
+          count++;
+        }
+      }
+
+      const int row = y * mWidth + x;
+      mForward.rowStart[row + 1] = count;
+      mForward.weights[row] = weightSum;
+    }
+  };
+  if (threadPool) {
+    threadPool->parallelFor(0, mHeight, assembleRow);
+  } else {
+    for (int y = 0; y < mHeight; y++) {
+      assembleRow(y);
+    }
+  }
+
+  for (std::size_t row = 0; row + 1 < mForward.rowStart.size(); row++) {
+    mForward.rowStart[row + 1] += mForward.rowStart[row];
+  }
+  mForward.columns.resize(mForward.rowStart.back());
+  mForward.values.resize(mForward.rowStart.back());
+  for (int y = 0; y < mHeight; y++) {
+    std::size_t k = mForward.rowStart[std::size_t(y) * mWidth];
+    for (const Entry& entry : rowEntries[y]) {
+      mForward.columns[k] = entry.column;
+      mForward.values[k] = entry.value;
+      k++;
+    }
+    std::vector<Entry>().swap(rowEntries[y]);
+  }
+}
+
+void SparseBlurOperator::Transpose() {
+  const std::size_t numColumns = std::size_t(mIwidth) * mIheight;
+  mAdjoint.width = mIwidth;
+  mAdjoint.height = mIheight;
+  mAdjoint.rowStart.assign(numColumns + 1, 0);
+  mAdjoint.weights.assign(numColumns, 0.0f);
+  mAdjoint.columns.resize(mForward.columns.size());
+  mAdjoint.values.resize(mForward.values.size());
+
+  // The column sums of A are the normalization of the adjoint
+  for (std::size_t k = 0; k < mForward.columns.size(); k++) {
+    mAdjoint.rowStart[mForward.columns[k] + 1]++;
+    mAdjoint.weights[mForward.columns[k]] += mForward.values[k];
+  }
+  for (std::size_t row = 0; row < numColumns; row++) {
+    mAdjoint.rowStart[row + 1] += mAdjoint.rowStart[row];
+  }
+
+  // Filled in forward row order, the columns of every row are sorted
+  std::vector<std::size_t> next(mAdjoint.rowStart.begin(),
+                                mAdjoint.rowStart.end() - 1);
+  const std::size_t numRows = std::size_t(mWidth) * mHeight;
+  for (std::size_t row = 0; row < numRows; row++) {
+    for (std::size_t k = mForward.rowStart[row];
+         k < mForward.rowStart[row + 1]; k++) {
+      const int column = mForward.columns[k];
+      const std::size_t to = next[column]++;
+      mAdjoint.columns[to] = static_cast<int>(row);
+      mAdjoint.values[to] = mForward.values[k] / mAdjoint.weights[column];
+    }
+  }
+}
+
+std::size_t SparseBlurOperator::GetBytes() const {
+  std::size_t bytes = 0;
+  for (const Matrix* m : {&mForward, &mAdjoint}) {
+    bytes += m->rowStart.size() * sizeof(std::size_t) +
+             m->columns.size() * sizeof(int) +
+             m->values.size() * sizeof(float) +
+             m->weights.size() * sizeof(float);
+  }
+  return bytes;
+}
+
+bool SparseBlurOperator::Matches(const Homography* const* homographies,
+                                 int numSamples, int iwidth, int iheight,
+                                 int width, int height) const {
+  if (numSamples != static_cast<int>(mHomographies.size()) ||
+      iwidth != mIwidth || iheight != mIheight || width != mWidth ||
+      height != mHeight || getSamplerTransform() != mTransform ||
+      getSamplerResyncPixels() != mResyncPixels) {
+    return false;
+  }
+
+  for (int i = 0; i < numSamples; i++) {
+    if (std::memcmp(homographies[i]->Hmatrix, mHomographies[i].Hmatrix,
+                    sizeof(mHomographies[i].Hmatrix)) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void SparseBlurOperator::blurGray(const float* InputImg, float* BlurImg,
+                                  float* outputWeight, bool bforward,
+                                  ThreadPool* threadPool,
+                                  const BlurEpilogue& aEpilogue) const {
+  const float* input[] = {InputImg};
+  float* output[] = {BlurImg};
+  multiply<1>(bforward ? mForward : mAdjoint, input, output, outputWeight,
+              threadPool, aEpilogue);
+}
+
+void SparseBlurOperator::blurRgb(const float* InputImgR,
+                                 const float* InputImgG,
+                                 const float* InputImgB, float* BlurImgR,
+                                 float* BlurImgG, float* BlurImgB,
+                                 float* outputWeight, bool bforward,
+                                 ThreadPool* threadPool,
+                                 const BlurEpilogue& aEpilogue) const {
+  const float* input[] = {InputImgR, InputImgG, InputImgB};
+  float* output[] = {BlurImgR, BlurImgG, BlurImgB};
+  multiply<3>(bforward ? mForward : mAdjoint, input, output, outputWeight,
+              threadPool, aEpilogue);
+}
@@ -1,124 +1,113 @@
 #include "TVRegularizer.hpp"
 
-void TVRegularizer::SetBuffer(int width, int height) {
-  const std::size_t newSize = width * height;
+#include <algorithm>
+#include <utility>
 
-  if (newSize <= mDxImg.size()) {
-    return;
-  }
+namespace {
 
-  mDxImg.resize(newSize);
-  mDyImg.resize(newSize);
-  mDxxImg.resize(newSize);
-  mDyyImg.resize(newSize);
-
-  mDxImgR.resize(newSize);
-  mDyImgR.resize(newSize);
-  mDxxImgR.resize(newSize);
-  mDyyImgR.resize(newSize);
-  mDxImgG.resize(newSize);
-  mDyImgG.resize(newSize);
-  mDxxImgG.resize(newSize);
-  mDyyImgG.resize(newSize);
-  mDxImgB.resize(newSize);
-  mDyImgB.resize(newSize);
-  mDxxImgB.resize(newSize);
-  mDyyImgB.resize(newSize);
+// Gradient normalized to its sign
+float normalizeGradient(float gradient) {
+  if (gradient > 0) return 1.0f / 255.0f;
+  if (gradient < 0) return -1.0f / 255.0f;
+  return gradient;
 }
 
-void TVRegularizer::ClearBuffer() {
-  mDxImg.clear();
-  mDyImg.clear();
-  mDxxImg.clear();
-  mDyyImg.clear();
-
-  mDxImgR.clear();
-  mDyImgR.clear();
-  mDxxImgR.clear();
-  mDyyImgR.clear();
-  mDxImgG.clear();
-  mDyImgG.clear();
-  mDxxImgG.clear();
-  mDyyImgG.clear();
-  mDxImgB.clear();
-  mDyImgB.clear();
-  mDxxImgB.clear();
-  mDyyImgB.clear();
+// Normalized backward y gradient of a row, zero for the first row
+void gradientYRow(const float* Row, const float* PrevRow, int width,
+                  float* DyRow) {
+  for (int x = 0; x < width; x++) {
+    DyRow[x] = PrevRow ? normalizeGradient(Row[x] - PrevRow[x]) : 0.0f;
+  }
 }
 
-void TVRegularizer::ComputeGradientImageGray(float* Img, int width, int height,
-                                             float* DxImg, float* DyImg,
-                                             bool bflag) {
-  int x = 0, y = 0, index = 0;
-  for (y = 0, index = 0; y < height; y++) {
-    for (x = 0; x < width; x++, index++) {
-      if (bflag) {
-        if (x > 0) {
-          DxImg[index] = Img[index] - Img[index - 1];
-        } else {
-          DxImg[index] = 0;
-        }
-        if (y > 0) {
-          DyImg[index] = Img[index] - Img[index - width];
-        } else {
-          DyImg[index] = 0;
-        }
-      } else {
-        if (x < width - 1) {
-          DxImg[index] = Img[index] - Img[index + 1];
-        } else {
-          DxImg[index] = 0;
-        }
-        if (y < height - 1) {
-          DyImg[index] = Img[index] - Img[index + width];
-        } else {
-          DyImg[index] = 0;
-        }
-      }
+// Term of a row, the sum of the forward derivatives of its normalized
+// backward gradients. DyNextRow is nullptr for the last row.
+void termRow(const float* Row, const float* DyRow, const float* DyNextRow,
+             int width, float* TermRow) {
+  float dx = 0.0f;
+  for (int x = 0; x < width; x++) {
+    float dxx = 0.0f, dyy = 0.0f;
+    if (x < width - 1) {
+      const float dxNext = normalizeGradient(Row[x + 1] - Row[x]);
+      dxx = dx - dxNext;
+      dx = dxNext;
     }
+    if (DyNextRow) {
+      dyy = DyRow[x] - DyNextRow[x];
+    }
+    TermRow[x] = dxx + dyy;
   }
 }
 
-void TVRegularizer::ComputeGradientXImageGray(float* Img, int width, int height,
-                                              float* DxImg, bool bflag) {
-  int x = 0, y = 0, index = 0;
-  for (y = 0, index = 0; y < height; y++) {
-    for (x = 0; x < width; x++, index++) {
-      if (bflag) {
-        if (x > 0) {
-          DxImg[index] = Img[index] - Img[index - 1];
-        } else {
-          DxImg[index] = 0;
-        }
-      } else {
-        if (x < width - 1) {
-          DxImg[index] = Img[index] - Img[index + 1];
-        } else {
-          DxImg[index] = 0;
-        }
-      }
+}  // namespace
+
+void TVRegularizer::SetBuffer(int width, int height, int channels) {
+  const std::size_t newSize = width * height;
+
+  if (channels == 1) {
+    if (newSize <= mTermImg.size()) {
+      return;
     }
+
+    mTermImg.resize(newSize, *mBufferPool);
+  } else {
+    if (newSize <= mTermImgR.size()) {
+      return;
+    }
+
+    mTermImgR.resize(newSize, *mBufferPool);
+    mTermImgG.resize(newSize, *mBufferPool);
+    mTermImgB.resize(newSize, *mBufferPool);
+  }
+}
+
+void TVRegularizer::SetRowBuffer(int width, int channels) {
+  const std::size_t newSize = std::size_t(3) * channels * width;
+  if (newSize > mRowBuffer.size()) {
+    mRowBuffer.resize(newSize, *mBufferPool);
   }
 }
 
-void TVRegularizer::ComputeGradientYImageGray(float* Img, int width, int height,
-                                              float* DyImg, bool bflag) {
-  int x = 0, y = 0, index = 0;
-  for (y = 0, index = 0; y < height; y++) {
-    for (x = 0; x < width; x++, index++) {
-      if (bflag) {
-        if (y > 0) {
-          DyImg[index] = Img[index] - Img[index - width];
-        } else {
-          DyImg[index] = 0;
-        }
-      } else {
-        if (y < height - 1) {
-          DyImg[index] = Img[index] - Img[index + width];
-        } else {
-          DyImg[index] = 0;
-        }
+void TVRegularizer::ClearBuffer() {
+  mRowBuffer.clear();
+
+  mTermImg.clear();
+  mTermImgR.clear();
+  mTermImgG.clear();
+  mTermImgB.clear();
+}
+
+void TVRegularizer::SetBufferPool(BufferPool& aPool) {
+  ClearBuffer();
+  mBufferPool = &aPool;
+}
+
+template <int Channels, typename RowFunc>
+void TVRegularizer::SweepTerm(float* const (&Imgs)[Channels], int width,
+                              int height, RowFunc&& applyRow) {
+  SetRowBuffer(width, Channels);
+
+  // Normalized y gradients of the row and of the next row, and the term
+  float *DyRow[Channels], *DyNextRow[Channels], *TermRow[Channels];
+  for (int c = 0; c < Channels; c++) {
+    DyRow[c] = mRowBuffer.data() + 3 * c * width;
+    DyNextRow[c] = DyRow[c] + width;
+    TermRow[c] = DyNextRow[c] + width;
+    gradientYRow(Imgs[c], nullptr, width, DyRow[c]);
+  }
+
+  for (int y = 0; y < height; y++) {
+    const bool bLast = y == height - 1;
+    for (int c = 0; c < Channels; c++) {
+      const float* Row = Imgs[c] + y * width;
+      // Read before applyRow overwrites the row
+      if (!bLast) {
+        gradientYRow(Row + width, Row, width, DyNextRow[c]);
       }
+      termRow(Row, DyRow[c], bLast ? nullptr : DyNextRow[c], width,
+              TermRow[c]);
+      applyRow(c, y, TermRow[c]);
+      std::swap(DyRow[c], DyNextRow[c]);
     }
   }
 }
@@ -126,94 +115,51 @@ void TVRegularizer::ComputeGradientYImageGray(float* Img, int width, int height,
 void TVRegularizer::applyRegularizationGray(float* DeblurImg, int width,
                                             int height, bool bPoisson,
                                             float lambda) {
-  SetBuffer(width, height);
-
-  int x = 0, y = 0, index = 0;
-
-  ComputeGradientImageGray(DeblurImg, width, height, mDxImg.data(),
-                           mDyImg.data(), true);
-  for (y = 0, index = 0; y < height; y++) {  // Normalize the gradient
-    for (x = 0; x < width; x++, index++) {
-      if (mDxImg[index] > 0) mDxImg[index] = 1.0f / 255.0f;
-      if (mDxImg[index] < 0) mDxImg[index] = -1.0f / 255.0f;
-      if (mDyImg[index] > 0) mDyImg[index] = 1.0f / 255.0f;
-      if (mDyImg[index] < 0) mDyImg[index] = -1.0f / 255.0f;
-    }
-  }
-  ComputeGradientXImageGray(mDxImg.data(), width, height, mDxxImg.data(),
-                            false);
-  ComputeGradientYImageGray(mDyImg.data(), width, height, mDyyImg.data(),
-                            false);
-
-  for (y = 0, index = 0; y < height; y++) {  // Normalize the gradient
-    for (x = 0; x < width; x++, index++) {
-      if (bPoisson) {
-        DeblurImg[index] *=
-            1.0 / (1.0 + lambda * (mDxxImg[index] + mDyyImg[index]));
-      } else {
-        DeblurImg[index] -= lambda * (mDxxImg[index] + mDyyImg[index]);
-      }
-    }
-  }
+  float* const Imgs[] = {DeblurImg};
+  SweepTerm(Imgs, width, height, [&](int, int y, const float* TermRow) {
+    regularizePlane(DeblurImg + y * width, TermRow, width, bPoisson, lambda);
+  });
 }
 
 void TVRegularizer::applyRegularizationRgb(float* DeblurImgR, float* DeblurImgG,
                                            float* DeblurImgB, int width,
                                            int height, bool bPoisson,
                                            float lambda) {
-  SetBuffer(width, height);
-
-  int x = 0, y = 0, index = 0;
-
-  ComputeGradientImageGray(DeblurImgR, width, height, mDxImgR.data(),
-                           mDyImgR.data(), true);
-  ComputeGradientImageGray(DeblurImgG, width, height, mDxImgG.data(),
-                           mDyImgG.data(), true);
-  ComputeGradientImageGray(DeblurImgB, width, height, mDxImgB.data(),
-                           mDyImgB.data(), true);
-  for (y = 0, index = 0; y < height; y++) {
-    for (x = 0; x < width; x++, index++) {
-      if (mDxImgR[index] > 0) mDxImgR[index] = 1.0f / 255.0f;
-      if (mDxImgR[index] < 0) mDxImgR[index] = -1.0f / 255.0f;
-      if (mDyImgR[index] > 0) mDyImgR[index] = 1.0f / 255.0f;
-      if (mDyImgR[index] < 0) mDyImgR[index] = -1.0f / 255.0f;
-      if (mDxImgG[index] > 0) mDxImgG[index] = 1.0f / 255.0f;
-      if (mDxImgG[index] < 0) mDxImgG[index] = -1.0f / 255.0f;
-      if (mDyImgG[index] > 0) mDyImgG[index] = 1.0f / 255.0f;
-      if (mDyImgG[index] < 0) mDyImgG[index] = -1.0f / 255.0f;
-      if (mDxImgB[index] > 0) mDxImgB[index] = 1.0f / 255.0f;
-      if (mDxImgB[index] < 0) mDxImgB[index] = -1.0f / 255.0f;
-      if (mDyImgB[index] > 0) mDyImgB[index] = 1.0f / 255.0f;
-      if (mDyImgB[index] < 0) mDyImgB[index] = -1.0f / 255.0f;
-    }
-  }
-  ComputeGradientXImageGray(mDxImgR.data(), width, height, mDxxImgR.data(),
-                            false);
-  ComputeGradientYImageGray(mDyImgR.data(), width, height, mDyyImgR.data(),
-                            false);
-  ComputeGradientXImageGray(mDxImgG.data(), width, height, mDxxImgG.data(),
-                            false);
-  ComputeGradientYImageGray(mDyImgG.data(), width, height, mDyyImgG.data(),
-                            false);
-  ComputeGradientXImageGray(mDxImgB.data(), width, height, mDxxImgB.data(),
-                            false);
-  ComputeGradientYImageGray(mDyImgB.data(), width, height, mDyyImgB.data(),
-                            false);
-
-  for (y = 0, index = 0; y < height; y++) {  // Normalize the gradient
-    for (x = 0; x < width; x++, index++) {
-      if (bPoisson) {
-        DeblurImgR[index] *=
-            1.0 / (1.0 + lambda * (mDxxImgR[index] + mDyyImgR[index]));
-        DeblurImgG[index] *=
-            1.0 / (1.0 + lambda * (mDxxImgG[index] + mDyyImgG[index]));
-        DeblurImgB[index] *=
-            1.0 / (1.0 + lambda * (mDxxImgB[index] + mDyyImgB[index]));
-      } else {
-        DeblurImgR[index] -= lambda * (mDxxImgR[index] + mDyyImgR[index]);
-        DeblurImgG[index] -= lambda * (mDxxImgG[index] + mDyyImgG[index]);
-        DeblurImgB[index] -= lambda * (mDxxImgB[index] + mDyyImgB[index]);
-      }
-    }
-  }
+  float* const Imgs[] = {DeblurImgR, DeblurImgG, DeblurImgB};
+  SweepTerm(Imgs, width, height, [&](int c, int y, const float* TermRow) {
+    regularizePlane(Imgs[c] + y * width, TermRow, width, bPoisson, lambda);
+  });
+}
+
+bool TVRegularizer::computeRegularizationTermGray(float* DeblurImg, int width,
+                                                  int height,
+                                                  const float*& TermImg) {
+  SetBuffer(width, height, 1);
+
+  float* const Imgs[] = {DeblurImg};
+  SweepTerm(Imgs, width, height, [&](int, int y, const float* TermRow) {
+    std::copy(TermRow, TermRow + width, mTermImg.data() + y * width);
+  });
+
+  TermImg = mTermImg.data();
+  return true;
+}
+
+bool TVRegularizer::computeRegularizationTermRgb(
+    float* DeblurImgR, float* DeblurImgG, float* DeblurImgB, int width,
+    int height, const float*& TermImgR, const float*& TermImgG,
+    const float*& TermImgB) {
+  SetBuffer(width, height, 3);
+
+  float* const Imgs[] = {DeblurImgR, DeblurImgG, DeblurImgB};
+  float* const TermImgs[] = {mTermImgR.data(), mTermImgG.data(),
+                             mTermImgB.data()};
+  SweepTerm(Imgs, width, height, [&](int c, int y, const float* TermRow) {
+    std::copy(TermRow, TermRow + width, TermImgs[c] + y * width);
+  });
+
+  TermImgR = mTermImgR.data();
+  TermImgG = mTermImgG.data();
+  TermImgB = mTermImgB.data();
+  return true;
 }
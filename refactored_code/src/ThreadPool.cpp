@@ -0,0 +1,116 @@
+#include "ThreadPool.hpp"
+
+#include <exception>
+#include <utility>
+
+namespace {
+// Set on pool workers and on a caller while it runs tasks
+thread_local bool tInsidePool = false;
+}  // namespace
+
+ThreadPool::ThreadPool(int aNumThreads) {
+  if (aNumThreads <= 0) {
+    aNumThreads = static_cast<int>(std::thread::hardware_concurrency());
+  }
+
+  for (int i = 1; i < aNumThreads; i++) {
+    mWorkers.emplace_back(&ThreadPool::workerLoop, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard lock(mMutex);
+    mStop = true;
+  }
+  mWakeCondition.notify_all();
+
+  for (auto& worker : mWorkers) {
+    worker.join();
+  }
+}
+
+void ThreadPool::parallelFor(int aBegin, int aEnd,
+                             const std::function<void(int)>& aTask) {
+  if (aBegin >= aEnd) {
+    return;
+  }
+
+  if (mWorkers.empty() || tInsidePool || aEnd - aBegin == 1) {
+    for (int i = aBegin; i < aEnd; i++) {
+      aTask(i);
+    }
+    return;
+  }
+
+  std::lock_guard submitLock(mSubmitMutex);
+
+  {
+    std::lock_guard lock(mMutex);
+    mTask = &aTask;
+    mEnd = aEnd;
+    mNext = aBegin;
+    mBusyWorkers = static_cast<int>(mWorkers.size());
+    mGeneration++;
+  }
+  mWakeCondition.notify_all();
+
+  tInsidePool = true;
+  runTasks();
+  tInsidePool = false;
+
+  std::exception_ptr error;
+  {
+    std::unique_lock lock(mMutex);
+    mDoneCondition.wait(lock, [this] { return mBusyWorkers == 0; });
+    mTask = nullptr;
+    std::swap(error, mError);
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+bool ThreadPool::IsInsidePool() { return tInsidePool; }
+
+void ThreadPool::workerLoop() {
+  tInsidePool = true;
+
+  unsigned seenGeneration = 0;
+  for (;;) {
+    {
+      std::unique_lock lock(mMutex);
+      mWakeCondition.wait(lock, [this, seenGeneration] {
+        return mStop || mGeneration != seenGeneration;
+      });
+      if (mStop) {
+        return;
+      }
+      seenGeneration = mGeneration;
+    }
+
+    runTasks();
+
+    {
+      std::lock_guard lock(mMutex);
+      if (--mBusyWorkers == 0) {
+        mDoneCondition.notify_one();
+      }
+    }
+  }
+}
+
+void ThreadPool::runTasks() {
+  try {
+    for (int i = mNext++; i < mEnd; i = mNext++) {
+      (*mTask)(i);
+    }
+  } catch (...) {
+    // Keeps the first error for parallelFor and skips the remaining tasks
+    std::lock_guard lock(mMutex);
+    if (!mError) {
+      mError = std::current_exception();
+    }
+    mNext = mEnd;
+  }
+}
@@ -0,0 +1,185 @@
+#include "TiledDeblurrer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+#include "BufferPool.hpp"
+#include "DeblurParameters.hpp"
+
+namespace {
+
+// The error of the tiles is not computed
+class NoErrorCalculator : public IErrorCalculator {
+ public:
+  float calculateErrorGray(float*, int, int) override { return 0.0f; }
+  float calculateErrorRgb(float*, float*, float*, int, int) override {
+    return 0.0f;
+  }
+};
+
+// Region of width * height at (x, y) of the planes of a tile of stride
+// values per row
+Image<float> tileView(std::vector<float>& planes, int channels, int stride,
+                      int tileHeight, int x, int y, int width, int height) {
+  const std::size_t planeSize = std::size_t(stride) * tileHeight;
+  float* origin = planes.data() + std::size_t(y) * stride + x;
+  if (channels == 1) {
+    return Image<float>(origin, width, height, stride);
+  }
+  return Image<float>(origin, origin + planeSize, origin + 2 * planeSize,
+                      width, height, stride);
+}
+
+// T(-d) H T(d), where T(d) translates by d
+void translateHomography(const float (&H)[3][3], double dx, double dy,
+                         float (&tile)[3][3]) {
+  double M[3][3];
+  for (int r = 0; r < 3; r++) {
+    M[r][0] = H[r][0];
+    M[r][1] = H[r][1];
+    M[r][2] = H[r][0] * dx + H[r][1] * dy + H[r][2];
+  }
+  for (int c = 0; c < 3; c++) {
+    tile[0][c] = static_cast<float>(M[0][c] - dx * M[2][c]);
+    tile[1][c] = static_cast<float>(M[1][c] - dy * M[2][c]);
+    tile[2][c] = static_cast<float>(M[2][c]);
+  }
+}
+
+}  // namespace
+
+TiledDeblurrer::TiledDeblurrer(const MotionBlurImageGenerator& aMotion)
+    : mMotion(aMotion) {}
+
+void TiledDeblurrer::SetTileSize(int aTileSize) {
+  if (aTileSize <= 0) {
+    throw std::invalid_argument("The tile size must be positive");
+  }
+  mTileSize = aTileSize;
+}
+
+void TiledDeblurrer::SetHaloScale(float aHaloScale) {
+  mHaloScale = aHaloScale;
+}
+
+float TiledDeblurrer::GetFootprint(const MotionBlurImageGenerator& aMotion,
+                                   int width, int height) {
+  // The displacement of an affine motion is largest on a corner, the
+  // points along the border cover perspective motions
+  constexpr int kBorderStep = 64;
+  std::vector<std::pair<float, float>> points;
+  for (int x = 0; x <= width; x += kBorderStep) {
+    points.emplace_back(x, 0);
+    points.emplace_back(x, height);
+  }
+  for (int y = 0; y <= height; y += kBorderStep) {
+    points.emplace_back(0, y);
+    points.emplace_back(width, y);
+  }
+  points.emplace_back(width, height);
+
+  float footprint = 0.0f;
+  for (int i = 0; i < aMotion.GetNumSamples(); i++) {
+    for (const Homography* H : {&aMotion.Hmatrix[i], &aMotion.IHmatrix[i]}) {
+      for (const auto& [x, y] : points) {
+        // The samplers work in coordinates centered on the image
+        float fx = x - width * 0.5f, fy = y - height * 0.5f;
+        const float px = fx, py = fy;
+        H->Transform(fx, fy);
+        footprint = std::max(footprint, std::hypot(fx - px, fy - py));
+      }
+    }
+  }
+  return footprint;
+}
+
+int TiledDeblurrer::GetHalo(int width, int height) const {
+  // One more pixel for the bilinear taps
+  return static_cast<int>(
+             std::ceil(mHaloScale * GetFootprint(mMotion, width, height))) +
+         1;
+}
+
+void TiledDeblurrer::SetTileHomographies(int x, int y, int width, int height,
+                                         int imageWidth, int imageHeight) {
+  // Offset of the center of the region from the center of the image
+  const double dx = x + width * 0.5 - imageWidth * 0.5;
+  const double dy = y + height * 0.5 - imageHeight * 0.5;
+  mTileMotion.SetNumSamples(mMotion.GetNumSamples());
+  for (int i = 0; i < mMotion.GetNumSamples(); i++) {
+    translateHomography(mMotion.Hmatrix[i].Hmatrix, dx, dy,
+                        mTileMotion.Hmatrix[i].Hmatrix);
+    translateHomography(mMotion.IHmatrix[i].Hmatrix, dx, dy,
+                        mTileMotion.IHmatrix[i].Hmatrix);
+  }
+}
+
+DeblurResult TiledDeblurrer::deblur(IImageFile& BlurImg,
+                                    IImageFile& DeblurImg,
+                                    const DeblurParameters& aParameters,
+                                    const RegularizerFactory& makeRegularizer,
+                                    float lambda) {
+  const int width = BlurImg.GetWidth();
+  const int height = BlurImg.GetHeight();
+  const int channels = BlurImg.GetChannels();
+  if (DeblurImg.GetWidth() != width || DeblurImg.GetHeight() != height ||
+      DeblurImg.GetChannels() != channels) {
+    throw std::invalid_argument(
+        "The deblurred image must have the size of the blurred image");
+  }
+
+  const int halo = GetHalo(width, height);
+  NoErrorCalculator errorCalculator;
+  RLDeblurrer deblurrer(mTileMotion, errorCalculator);
+
+  std::vector<float> blurTile;
+  std::vector<float> deblurTile;
+  DeblurResult result;
+  std::size_t peakBufferBytes = 0;
+
+  for (int y = 0; y < height; y += mTileSize) {
+    for (int x = 0; x < width; x += mTileSize) {
+      // The core and the region of the tile with its halo
+      const int coreWidth = std::min(mTileSize, width - x);
+      const int coreHeight = std::min(mTileSize, height - y);
+      const int x0 = std::max(0, x - halo);
+      const int y0 = std::max(0, y - halo);
+      const int tileWidth = std::min(width, x + coreWidth + halo) - x0;
+      const int tileHeight = std::min(height, y + coreHeight + halo) - y0;
+
+      blurTile.resize(std::size_t(channels) * tileWidth * tileHeight);
+      const Image<float> blurView = tileView(
+          blurTile, channels, tileWidth, tileHeight, 0, 0, tileWidth,
+          tileHeight);
+      BlurImg.ReadRegion(x0, y0, blurView);
+      deblurTile = blurTile;
+      const Image<float> deblurView = tileView(
+          deblurTile, channels, tileWidth, tileHeight, 0, 0, tileWidth,
+          tileHeight);
+
+      SetTileHomographies(x0, y0, tileWidth, tileHeight, width, height);
+      const auto regularizer = makeRegularizer();
+      const DeblurResult tileResult = deblurrer.deblur(
+          blurView, deblurView, aParameters, *regularizer, lambda);
+      if (tileResult.iterations >= result.iterations) {
+        result = tileResult;
+      }
+      peakBufferBytes =
+          std::max(peakBufferBytes, tileResult.peakBufferBytes);
+
+      DeblurImg.WriteRegion(x, y,
+                            tileView(deblurTile, channels, tileWidth,
+                                     tileHeight, x - x0, y - y0, coreWidth,
+                                     coreHeight));
+    }
+  }
+
+  // Frees the frames of the tiles, the deblurrer uses the default pool
+  deblurrer.ClearBuffer();
+  BufferPool::GetDefault().Trim();
+
+  result.peakBufferBytes = peakBufferBytes;
+  return result;
+}
@@ -0,0 +1,61 @@
+#include "WarpMap.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+WarpMap::WarpMap(const Homography* const* homographies, int numSamples,
+                 int iwidth, int iheight, int width, int height,
+                 ThreadPool* threadPool)
+    : mIwidth(iwidth),
+      mIheight(iheight),
+      mWidth(width),
+      mHeight(height),
+      mTransform(getSamplerTransform()),
+      mResyncPixels(getSamplerResyncPixels()) {
+  for (int i = 0; i < numSamples; i++) {
+    mHomographies.push_back(*homographies[i]);
+  }
+  mTaps.resize(static_cast<std::size_t>(numSamples) * width * height);
+
+  const auto computeRow = [&](int row) {
+    const int i = row / height, y = row % height;
+    WarpTap* taps = mTaps.data() + static_cast<std::size_t>(row) * width;
+    for (int xBegin = 0; xBegin < width; xBegin += kRowSegmentWidth) {
+      const int xEnd = std::min(xBegin + kRowSegmentWidth, width);
+      computeWarpTaps(iwidth, iheight, width, height, *homographies[i], y,
+                      xBegin, xEnd, taps + xBegin);
+    }
+  };
+  if (threadPool) {
+    threadPool->parallelFor(0, numSamples * height, computeRow);
+  } else {
+    for (int row = 0; row < numSamples * height; row++) {
+      computeRow(row);
+    }
+  }
+}
+
+std::size_t WarpMap::GetBytes(int numSamples, int width, int height) {
+  return static_cast<std::size_t>(numSamples) * width * height *
+         sizeof(WarpTap);
+}
+
+std::size_t WarpMap::GetBytes() const { return mTaps.size() * sizeof(WarpTap); }
+
+bool WarpMap::Matches(const Homography* const* homographies, int numSamples,
+                      int iwidth, int iheight, int width, int height) const {
+  if (numSamples != GetNumSamples() || iwidth != mIwidth ||
+      iheight != mIheight || width != mWidth || height != mHeight ||
+      getSamplerTransform() != mTransform ||
+      getSamplerResyncPixels() != mResyncPixels) {
+    return false;
+  }
+
+  for (int i = 0; i < numSamples; i++) {
+    if (std::memcmp(homographies[i]->Hmatrix, mHomographies[i].Hmatrix,
+                    sizeof(mHomographies[i].Hmatrix)) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
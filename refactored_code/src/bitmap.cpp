@@ -12,12 +12,14 @@
 
 #include "bitmap.h"
 
+#include <algorithm>
 #include <cstring>
-#include <fstream>
 #include <iostream>
+#include <stdexcept>
 
 namespace {
 constexpr auto BMP_BI_RGB = 0L;
+constexpr auto BMP_BI_BITFIELDS = 3L;
 
 using BMP_WORD = uint16_t;
 using BMP_DWORD = uint32_t;
@@ -44,6 +46,67 @@ struct BMP_BITMAPINFOHEADER {
   BMP_DWORD biClrUsed;
   BMP_DWORD biClrImportant;
 };
+
+// Bytes of a row, padded to a multiple of 4
+std::size_t rowBytes(int width, int bitCount) {
+  return (std::size_t(width) * bitCount + 31) / 32 * 4;
+}
+
+template <class T>
+T readValue(const uint8_t* data) {
+  T value;
+  memcpy(&value, data, sizeof(T));
+  return value;
+}
+
+void writeHeader(uint8_t* data, int width, int height, int bitCount) {
+  const int paletteBytes = bitCount == 8 ? 256 * 4 : 0;
+  const BMP_DWORD bytes = BMP_DWORD(rowBytes(width, bitCount) * height);
+
+  BMP_BITMAPFILEHEADER bmfh{};
+  bmfh.bfType = 0x4d42;  // "BM"
+  bmfh.bfSize = sizeof(BMP_BITMAPFILEHEADER) + sizeof(BMP_BITMAPINFOHEADER) +
+                paletteBytes + bytes;
+  bmfh.bfReserved1 = 0;
+  bmfh.bfReserved2 = 0;
+  bmfh.bfOffBits = /*hack sizeof(BMP_BITMAPFILEHEADER)=14, sizeof doesn't
+                      work?*/
+      14 + sizeof(BMP_BITMAPINFOHEADER) + paletteBytes;
+
+  BMP_BITMAPINFOHEADER bmih{};
+  bmih.biSize = sizeof(BMP_BITMAPINFOHEADER);
+  bmih.biWidth = width;
+  bmih.biHeight = height;
+  bmih.biPlanes = 1;
+  bmih.biBitCount = bitCount;
+  bmih.biCompression = BMP_BI_RGB;
+  bmih.biSizeImage = 0;
+  bmih.biXPelsPerMeter = (int)(100 / 2.54 * 72);
+  bmih.biYPelsPerMeter = (int)(100 / 2.54 * 72);
+  bmih.biClrUsed = bitCount == 8 ? 256 : 0;
+  bmih.biClrImportant = 0;
+
+  //	memcpy(data, &bmfh, sizeof(BMP_BITMAPFILEHEADER));
+  memcpy(data, &bmfh.bfType, 2);
+  memcpy(data + 2, &bmfh.bfSize, 4);
+  memcpy(data + 6, &bmfh.bfReserved1, 2);
+  memcpy(data + 8, &bmfh.bfReserved2, 2);
+  memcpy(data + 10, &bmfh.bfOffBits, 4);
+  memcpy(data + 14, &bmih, sizeof(BMP_BITMAPINFOHEADER));
+
+  // Gray palette, every index is its own gray level
+  for (int i = 0; i < paletteBytes / 4; i++) {
+    uint8_t* entry = data + 14 + sizeof(BMP_BITMAPINFOHEADER) + i * 4;
+    entry[0] = entry[1] = entry[2] = static_cast<uint8_t>(i);
+    entry[3] = 0;
+  }
+}
+
+// The conversions of writeBMPchannels, values out of [0, 1] are clamped and
+// the others truncated
+inline uint8_t toByte(float value) {
+  return static_cast<uint8_t>(std::clamp(value, 0.0f, 1.0f) * 255.0f);
+}
 }  // namespace
 
 template <class T>
@@ -65,97 +128,42 @@ void swapBytes(T* val) {
 // Bitmap data returned is (R,G,B) tuples in row-major order.
 std::vector<uint8_t> readBMP(const std::string& fname, int& width,
                              int& height) {
-  std::fstream file(fname, std::fstream::in | std::fstream::binary);
-  BMP_DWORD pos = 0;
-
-  if (!file) return {};
-
-  //	I am doing file.read(reinterpret_cast<char*>(&bmfh),
-  // sizeof(BMP_BITMAPFILEHEADER)) in a
-  // safe way. :}
-  BMP_BITMAPFILEHEADER bmfh{};
-  file.read(reinterpret_cast<char*>(&(bmfh.bfType)), 2);
-  file.read(reinterpret_cast<char*>(&(bmfh.bfSize)), 4);
-  file.read(reinterpret_cast<char*>(&(bmfh.bfReserved1)), 2);
-  file.read(reinterpret_cast<char*>(&(bmfh.bfReserved2)), 2);
-  file.read(reinterpret_cast<char*>(&(bmfh.bfOffBits)), 4);
-
-  pos = bmfh.bfOffBits;
-
-  BMP_BITMAPINFOHEADER bmih{};
-  file.read(reinterpret_cast<char*>(&bmih), sizeof(BMP_BITMAPINFOHEADER));
-
-  // error checking
-  if (bmfh.bfType != 0x4d42) {  // "BM" actually
-    return {};
-  }
-  if (bmih.biBitCount != 24) return {};
-  /*
-          if ( bmih.biCompression != BMP_BI_RGB ) {
-                  return {};
-          }
-  */
-  file.seekg(pos, std::fstream::beg);
-
-  width = bmih.biWidth;
-  height = bmih.biHeight;
-
-  std::cout << "readBMP1 " << width << " " << height << '\n';
-
-  int padWidth = width * 3;
-  int pad = 0;
-  if (padWidth % 4 != 0) {
-    pad = 4 - (padWidth % 4);
-    padWidth += pad;
-  }
-  int bytes = height * padWidth;
-
-  std::vector<uint8_t> data(bytes);
-
-  file.read(reinterpret_cast<char*>(data.data()), bytes);
-
-  if (!file) {
-    return {};
-  }
-
-  // shuffle bitmap data such that it is (R,G,B) tuples in row-major order
-  int i = 0, j = 0;
-  j = 0;
-  uint8_t temp = 0;
-  uint8_t* in = nullptr;
-  uint8_t* out = nullptr;
-
-  in = data.data();
-  out = data.data();
-
-  for (j = 0; j < height; ++j) {
-    for (i = 0; i < width; ++i) {
-      out[1] = in[1];
-      temp = in[2];
-      out[2] = in[0];
-      out[0] = temp;
-
-      in += 3;
-      out += 3;
+  try {
+    const BMPFile file(fname);
+    width = file.GetWidth();
+    height = file.GetHeight();
+
+    std::vector<uint8_t> data(std::size_t(3) * width * height);
+    for (int y = 0; y < height; y++) {
+      file.ReadRowRgb(y, &data[std::size_t(3) * width * y]);
     }
-    in += pad;
+    return data;
+  } catch (const std::runtime_error&) {
+    return {};
   }
-
-  return data;
 }
 
 void readBMP(const std::string& fname, std::vector<float>& fImg, int& width,
              int& height) {
-  auto Img = readBMP(fname, width, height);
-  fImg.resize(3 * width * height);
-  auto pfImg = fImg.data();
-  int x = 0, y = 0, index = 0;
-  for (y = 0, index = 0; y < height; y++) {
-    for (x = 0; x < width; x++, index++) {
-      pfImg[3 * index] = Img[3 * index] / 255.0f;
-      pfImg[3 * index + 1] = Img[3 * index + 1] / 255.0f;
-      pfImg[3 * index + 2] = Img[3 * index + 2] / 255.0f;
+  fImg.clear();
+  try {
+    const BMPFile file(fname);
+    width = file.GetWidth();
+    height = file.GetHeight();
+
+    // Converted row by row, without a byte copy of the image
+    fImg.resize(std::size_t(3) * width * height);
+    std::vector<uint8_t> rgb(std::size_t(3) * width);
+    for (int y = 0; y < height; y++) {
+      file.ReadRowRgb(y, rgb.data());
+      float* pfImg = &fImg[std::size_t(3) * width * y];
+      for (int x = 0; x < 3 * width; x++) {
+        pfImg[x] = rgb[x] / 255.0f;
+      }
     }
+  } catch (const std::runtime_error& error) {
+    std::cout << error.what() << '\n';
+    return;
   }
 
   std::cout << "readBMP " << width << " " << height << '\n';
@@ -165,20 +173,32 @@ void readBMPchannels(const std::string& fname, std::vector<float>& fImgR,
                      std::vector<float>& fImgG, std::vector<float>& fImgB,
                      int& width, int& height) {
   std::cout << "readBMP fname " << fname << '\n';
-  auto Img = readBMP(fname, width, height);
-  fImgR.resize(width * height);
-  fImgG.resize(width * height);
-  fImgB.resize(width * height);
-  auto* pfImgR = fImgR.data();
-  auto* pfImgG = fImgG.data();
-  auto* pfImgB = fImgB.data();
-  int x = 0, y = 0, index = 0;
-  for (y = 0, index = 0; y < height; y++) {
-    for (x = 0; x < width; x++, index++) {
-      pfImgR[index] = Img[3 * index] / 255.0f;
-      pfImgG[index] = Img[3 * index + 1] / 255.0f;
-      pfImgB[index] = Img[3 * index + 2] / 255.0f;
+  fImgR.clear();
+  fImgG.clear();
+  fImgB.clear();
+  try {
+    BMPFile file(fname);
+    width = file.GetWidth();
+    height = file.GetHeight();
+    fImgR.resize(std::size_t(width) * height);
+    fImgG.resize(std::size_t(width) * height);
+    fImgB.resize(std::size_t(width) * height);
+
+    if (file.GetChannels() == 1) {
+      file.ReadRegion(0, 0, Image<float>(fImgR.data(), width, height));
+      fImgG = fImgR;
+      fImgB = fImgR;
+    } else {
+      file.ReadRegion(0, 0,
+                      Image<float>(fImgR.data(), fImgG.data(), fImgB.data(),
+                                   width, height));
     }
+  } catch (const std::runtime_error& error) {
+    std::cout << error.what() << '\n';
+    fImgR.clear();
+    fImgG.clear();
+    fImgB.clear();
+    return;
   }
 
   std::cout << "readBMP " << width << " " << height << '\n';
@@ -186,116 +206,224 @@ void readBMPchannels(const std::string& fname, std::vector<float>& fImgR,
 
 void writeBMP(const std::string& iname, int width, int height,
               const std::vector<uint8_t>& data) {
-  int bytes = 0, pad = 0;
-  bytes = width * 3;
-  pad = (bytes % 4) ? 4 - (bytes % 4) : 0;
-  bytes += pad;
-  bytes *= height;
-
-  BMP_BITMAPFILEHEADER bmfh{};
-  bmfh.bfType = 0x4d42;  // "BM"
-  bmfh.bfSize =
-      sizeof(BMP_BITMAPFILEHEADER) + sizeof(BMP_BITMAPINFOHEADER) + bytes;
-  bmfh.bfReserved1 = 0;
-  bmfh.bfReserved2 = 0;
-  bmfh.bfOffBits = /*hack sizeof(BMP_BITMAPFILEHEADER)=14, sizeof doesn't
-                      work?*/
-      14 + sizeof(BMP_BITMAPINFOHEADER);
-
-  BMP_BITMAPINFOHEADER bmih{};
-  bmih.biSize = sizeof(BMP_BITMAPINFOHEADER);
-  bmih.biWidth = width;
-  bmih.biHeight = height;
-  bmih.biPlanes = 1;
-  bmih.biBitCount = 24;
-  bmih.biCompression = BMP_BI_RGB;
-  bmih.biSizeImage = 0;
-  bmih.biXPelsPerMeter = (int)(100 / 2.54 * 72);
-  bmih.biYPelsPerMeter = (int)(100 / 2.54 * 72);
-  bmih.biClrUsed = 0;
-  bmih.biClrImportant = 0;
-
-  std::fstream outFile(iname, std::fstream::out | std::fstream::binary);
-
-  //	outFile.write(reinterpret_cast<const char*>(&bmfh),
-  // sizeof(BMP_BITMAPFILEHEADER));
-  outFile.write(reinterpret_cast<const char*>(&(bmfh.bfType)), 2);
-  outFile.write(reinterpret_cast<const char*>(&(bmfh.bfSize)), 4);
-  outFile.write(reinterpret_cast<const char*>(&(bmfh.bfReserved1)), 2);
-  outFile.write(reinterpret_cast<const char*>(&(bmfh.bfReserved2)), 2);
-  outFile.write(reinterpret_cast<const char*>(&(bmfh.bfOffBits)), 4);
-
-  outFile.write(reinterpret_cast<const char*>(&bmih),
-                sizeof(BMP_BITMAPINFOHEADER));
-
-  bytes /= height;
-  std::vector<uint8_t> scanline(bytes);
-  for (int j = 0; j < height; ++j) {
-    memcpy(scanline.data(), &data[j * 3 * width], 3 * width);
-    for (int i = 0; i < width; ++i) {
-      uint8_t temp = scanline[i * 3];
-      scanline[i * 3] = scanline[i * 3 + 2];
-      scanline[i * 3 + 2] = temp;
+  try {
+    BMPFile file(iname, width, height);
+    for (int y = 0; y < height; y++) {
+      const uint8_t* rgb = &data[std::size_t(3) * width * y];
+      uint8_t* row = file.GetRow(y);
+      for (int x = 0; x < width; x++) {
+        row[3 * x] = rgb[3 * x + 2];
+        row[3 * x + 1] = rgb[3 * x + 1];
+        row[3 * x + 2] = rgb[3 * x];
+      }
     }
-    outFile.write(reinterpret_cast<const char*>(scanline.data()), bytes);
+  } catch (const std::runtime_error& error) {
+    std::cout << error.what() << '\n';
   }
 }
 
 void writeBMP(const std::string& iname, int width, int height,
               const std::vector<float>& data) {
-  int x = 0, y = 0, index = 0;
-  std::vector<uint8_t> Img(3 * width * height);
-  for (y = 0, index = 0; y < height; y++) {
-    for (x = 0; x < width; x++, index++) {
-      if (data[3 * index] < 0)
-        Img[3 * index] = 0;
-      else if (data[3 * index] > 1)
-        Img[3 * index] = 255;
-      else
-        Img[3 * index] = (uint8_t)(data[3 * index] * 255.0f);
-      if (data[3 * index + 1] < 0)
-        Img[3 * index + 1] = 0;
-      else if (data[3 * index + 1] > 1)
-        Img[3 * index + 1] = 255;
-      else
-        Img[3 * index + 1] = (uint8_t)(data[3 * index + 1] * 255.0f);
-      if (data[3 * index + 2] < 0)
-        Img[3 * index + 2] = 0;
-      else if (data[3 * index + 2] > 1)
-        Img[3 * index + 2] = 255;
-      else
-        Img[3 * index + 2] = (uint8_t)(data[3 * index + 2] * 255.0f);
+  try {
+    BMPFile file(iname, width, height);
+    for (int y = 0; y < height; y++) {
+      const float* rgb = &data[std::size_t(3) * width * y];
+      uint8_t* row = file.GetRow(y);
+      for (int x = 0; x < width; x++) {
+        row[3 * x] = toByte(rgb[3 * x + 2]);
+        row[3 * x + 1] = toByte(rgb[3 * x + 1]);
+        row[3 * x + 2] = toByte(rgb[3 * x]);
+      }
     }
+  } catch (const std::runtime_error& error) {
+    std::cout << error.what() << '\n';
   }
-  writeBMP(iname, width, height, Img);
 }
+
 void writeBMPchannels(const std::string& iname, int width, int height,
                       const std::vector<float>& dataR,
                       const std::vector<float>& dataG,
                       const std::vector<float>& dataB) {
-  int x = 0, y = 0, index = 0;
-  std::vector<uint8_t> Img(3 * width * height);
-  for (y = 0, index = 0; y < height; y++) {
-    for (x = 0; x < width; x++, index++) {
-      if (dataR[index] < 0)
-        Img[3 * index] = 0;
-      else if (dataR[index] > 1)
-        Img[3 * index] = 255;
-      else
-        Img[3 * index] = (uint8_t)(dataR[index] * 255.0f);
-      if (dataG[index] < 0)
-        Img[3 * index + 1] = 0;
-      else if (dataG[index] > 1)
-        Img[3 * index + 1] = 255;
-      else
-        Img[3 * index + 1] = (uint8_t)(dataG[index] * 255.0f);
-      if (dataB[index] < 0)
-        Img[3 * index + 2] = 0;
-      else if (dataB[index] > 1)
-        Img[3 * index + 2] = 255;
-      else
-        Img[3 * index + 2] = (uint8_t)(dataB[index] * 255.0f);
+  try {
+    BMPFile file(iname, width, height);
+    file.WriteRegion(0, 0,
+                     Image<const float>(dataR.data(), dataG.data(),
+                                        dataB.data(), width, height));
+  } catch (const std::runtime_error& error) {
+    std::cout << error.what() << '\n';
+  }
+}
+
+BMPFile::BMPFile(const std::string& fname, bool bWritable)
+    : mFile(fname, bWritable) {
+  ParseHeader(fname);
+  if (bWritable && mBitCount == 8 && !mIdentityPalette) {
+    throw std::runtime_error("Cannot write the palette image " + fname);
+  }
+}
+
+BMPFile::BMPFile(const std::string& fname, int width, int height,
+                 int channels)
+    : mFile(fname, 14 + sizeof(BMP_BITMAPINFOHEADER) +
+                       (channels == 1 ? 256 * 4 : 0) +
+                       rowBytes(width, channels == 1 ? 8 : 24) * height),
+      mWidth(width),
+      mHeight(height),
+      mChannels(channels),
+      mBitCount(channels == 1 ? 8 : 24),
+      mOffset(14 + sizeof(BMP_BITMAPINFOHEADER) +
+              (channels == 1 ? 256 * 4 : 0)),
+      mRowBytes(rowBytes(width, mBitCount)),
+      mIdentityPalette(channels == 1) {
+  // The new file is zero, the rows are black until they are written
+  writeHeader(mFile.data(), width, height, mBitCount);
+  for (int i = 0; i < 256; i++) {
+    mPalette[i][0] = mPalette[i][1] = mPalette[i][2] = static_cast<uint8_t>(i);
+  }
+}
+
+void BMPFile::ParseHeader(const std::string& fname) {
+  const uint8_t* data = mFile.data();
+  const auto invalid = [&fname](const char* reason) {
+    return std::runtime_error("Cannot read " + fname + ": " + reason);
+  };
+  if (mFile.size() < 14 + sizeof(BMP_BITMAPINFOHEADER) ||
+      readValue<BMP_WORD>(data) != 0x4d42) {  // "BM" actually
+    throw invalid("not a BMP file");
+  }
+
+  mOffset = readValue<BMP_DWORD>(data + 10);
+  BMP_BITMAPINFOHEADER bmih{};
+  memcpy(&bmih, data + 14, sizeof(BMP_BITMAPINFOHEADER));
+
+  mWidth = bmih.biWidth;
+  mHeight = bmih.biHeight < 0 ? -bmih.biHeight : bmih.biHeight;
+  mTopDown = bmih.biHeight < 0;
+  mBitCount = bmih.biBitCount;
+  mRowBytes = rowBytes(mWidth, mBitCount);
+  if (mWidth <= 0 || mHeight == 0) {
+    throw invalid("empty image");
+  }
+
+  if (mBitCount == 8 && bmih.biCompression == BMP_BI_RGB) {
+    const int numColors = bmih.biClrUsed ? int(bmih.biClrUsed) : 256;
+    const std::size_t palette = 14 + std::size_t(bmih.biSize);
+    if (numColors > 256 || palette + numColors * 4 > mFile.size()) {
+      throw invalid("truncated palette");
+    }
+
+    // BGR0 entries
+    bool gray = true;
+    mIdentityPalette = numColors == 256;
+    for (int i = 0; i < numColors; i++) {
+      const uint8_t* entry = data + palette + i * 4;
+      mPalette[i][0] = entry[2];
+      mPalette[i][1] = entry[1];
+      mPalette[i][2] = entry[0];
+      gray = gray && entry[0] == entry[1] && entry[1] == entry[2];
+      mIdentityPalette = mIdentityPalette && gray && entry[0] == i;
+    }
+    mChannels = gray ? 1 : 3;
+  } else if (mBitCount == 24 && bmih.biCompression == BMP_BI_RGB) {
+    mChannels = 3;
+  } else if (mBitCount == 32 && (bmih.biCompression == BMP_BI_RGB ||
+                                 bmih.biCompression == BMP_BI_BITFIELDS)) {
+    mChannels = 3;
+    if (bmih.biCompression == BMP_BI_BITFIELDS) {
+      // The R, G and B masks follow the info header, each must select a
+      // whole byte
+      const uint8_t* masks = data + 14 + sizeof(BMP_BITMAPINFOHEADER);
+      for (int c = 0; c < 3; c++) {
+        const BMP_DWORD mask = readValue<BMP_DWORD>(masks + 4 * c);
+        int byte = 0;
+        while (byte < 4 && mask != BMP_DWORD(0xff) << (8 * byte)) byte++;
+        if (byte == 4) {
+          throw invalid("unsupported bit fields");
+        }
+        mChannelOffset[c] = byte;
+      }
+    }
+  } else {
+    throw invalid("unsupported bit count or compression");
+  }
+
+  if (mOffset + mRowBytes * mHeight > mFile.size()) {
+    throw invalid("truncated pixels");
+  }
+}
+
+const uint8_t* BMPFile::GetRow(int y) const {
+  const int row = mTopDown ? mHeight - 1 - y : y;
+  return mFile.data() + mOffset + mRowBytes * row;
+}
+
+uint8_t* BMPFile::GetRow(int y) {
+  if (!mFile.writable()) {
+    throw std::runtime_error("The BMP file is not writable");
+  }
+  const int row = mTopDown ? mHeight - 1 - y : y;
+  return mFile.data() + mOffset + mRowBytes * row;
+}
+
+void BMPFile::ReadRowRgb(int y, uint8_t* rgb) const {
+  const uint8_t* row = GetRow(y);
+  if (mBitCount == 8) {
+    for (int x = 0; x < mWidth; x++) {
+      memcpy(rgb + 3 * x, mPalette[row[x]], 3);
     }
+    return;
   }
-  writeBMP(iname, width, height, Img);
-}
\ No newline at end of file
+
+  const int step = mBitCount / 8;
+  for (int x = 0; x < mWidth; x++) {
+    for (int c = 0; c < 3; c++) {
+      rgb[3 * x + c] = row[x * step + mChannelOffset[c]];
+    }
+  }
+}
+
+void BMPFile::ReadRegion(int x, int y, const Image<float>& region) {
+  const int step = mBitCount / 8;
+  for (int j = 0; j < region.height(); j++) {
+    const uint8_t* pixels = static_cast<const BMPFile&>(*this).GetRow(y + j) +
+                            std::size_t(x) * step;
+
+    // One pass over the row for every channel, the bytes are converted as
+    // they are read from the mapping
+    for (int c = 0; c < region.channels(); c++) {
+      float* row = region.row(j, c);
+      if (mBitCount == 8) {
+        for (int i = 0; i < region.width(); i++) {
+          row[i] = mPalette[pixels[i]][c] / 255.0f;
+        }
+      } else {
+        const uint8_t* channel = pixels + mChannelOffset[c];
+        for (int i = 0; i < region.width(); i++) {
+          row[i] = channel[i * step] / 255.0f;
+        }
+      }
+    }
+  }
+}
+
+void BMPFile::WriteRegion(int x, int y, const Image<const float>& region) {
+  const int step = mBitCount / 8;
+  for (int j = 0; j < region.height(); j++) {
+    uint8_t* pixels = GetRow(y + j) + std::size_t(x) * step;
+    if (mBitCount == 8) {
+      const float* row = region.row(j);
+      for (int i = 0; i < region.width(); i++) {
+        pixels[i] = toByte(row[i]);
+      }
+      continue;
+    }
+
+    for (int c = 0; c < region.channels(); c++) {
+      const float* row = region.row(j, c);
+      uint8_t* channel = pixels + mChannelOffset[c];
+      for (int i = 0; i < region.width(); i++) {
+        channel[i * step] = toByte(row[i]);
+      }
+    }
+  }
+}
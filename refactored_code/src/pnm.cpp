@@ -0,0 +1,246 @@
+// ---------------------------------------------------------------------------
+// pnm.cpp
+//
+// PFM and binary PGM / PPM I/O. The PFM floats are in the byte order given by
+// the sign of the scale of the header, negative for little endian, and the
+// rows go from the bottom. The 16-bit PGM / PPM samples are big endian and
+// the rows go from the top.
+// ---------------------------------------------------------------------------
+
+#include "pnm.h"
+
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+constexpr bool kLittleEndian = std::endian::native == std::endian::little;
+
+std::size_t sampleBytes(PNMSample sample) {
+  switch (sample) {
+    case PNMSample::Byte:
+      return 1;
+    case PNMSample::Short:
+      return 2;
+    case PNMSample::Float:
+      return 4;
+  }
+  return 0;
+}
+
+// Header of a new file, its floats are in the byte order of the host
+std::string makeHeader(int width, int height, int channels,
+                       PNMSample sample) {
+  if (channels != 1 && channels != 3) {
+    throw std::invalid_argument("A PNM file has 1 or 3 channels");
+  }
+  const bool isFloat = sample == PNMSample::Float;
+  const char* magic = isFloat ? (channels == 1 ? "Pf" : "PF")
+                              : (channels == 1 ? "P5" : "P6");
+  const char* range = isFloat ? (kLittleEndian ? "-1.0" : "1.0")
+                      : sample == PNMSample::Byte ? "255"
+                                                  : "65535";
+  return std::string(magic) + "\n" + std::to_string(width) + " " +
+         std::to_string(height) + "\n" + range + "\n";
+}
+
+float swapFloat(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, 4);
+  bits = (bits >> 24) | ((bits >> 8) & 0xff00) | ((bits << 8) & 0xff0000) |
+         (bits << 24);
+  memcpy(&value, &bits, 4);
+  return value;
+}
+
+}  // namespace
+
+PNMFile::PNMFile(const std::string& fname, bool bWritable)
+    : mFile(fname, bWritable) {
+  ParseHeader(fname);
+}
+
+PNMFile::PNMFile(const std::string& fname, int width, int height,
+                 int channels, PNMSample sample)
+    : mFile(fname, makeHeader(width, height, channels, sample).size() +
+                       std::size_t(width) * height * channels *
+                           sampleBytes(sample)),
+      mWidth(width),
+      mHeight(height),
+      mChannels(channels),
+      mSample(sample),
+      mMaxValue(sample == PNMSample::Short ? 65535 : 255),
+      mRowBytes(std::size_t(width) * channels * sampleBytes(sample)) {
+  // The new file is zero, the rows are black until they are written
+  const std::string header = makeHeader(width, height, channels, sample);
+  memcpy(mFile.data(), header.data(), header.size());
+  mOffset = header.size();
+}
+
+void PNMFile::ParseHeader(const std::string& fname) {
+  const auto invalid = [&fname](const char* reason) {
+    return std::runtime_error("Cannot read " + fname + ": " + reason);
+  };
+  const char* data = reinterpret_cast<const char*>(mFile.data());
+  const std::size_t size = mFile.size();
+
+  // Tokens separated by white space and comments
+  std::size_t pos = 2;
+  const auto nextToken = [&]() {
+    while (pos < size) {
+      if (data[pos] == '#') {
+        while (pos < size && data[pos] != '\n') pos++;
+      } else if (std::isspace(static_cast<unsigned char>(data[pos]))) {
+        pos++;
+      } else {
+        break;
+      }
+    }
+    const std::size_t start = pos;
+    while (pos < size && !std::isspace(static_cast<unsigned char>(data[pos]))) {
+      pos++;
+    }
+    if (start == pos) {
+      throw invalid("truncated header");
+    }
+    return std::string(data + start, pos - start);
+  };
+
+  if (size < 2 || data[0] != 'P') {
+    throw invalid("not a PNM file");
+  }
+  switch (data[1]) {
+    case 'f':
+    case '5':
+      mChannels = 1;
+      break;
+    case 'F':
+    case '6':
+      mChannels = 3;
+      break;
+    default:
+      throw invalid("unsupported PNM format");
+  }
+
+  mWidth = std::atoi(nextToken().c_str());
+  mHeight = std::atoi(nextToken().c_str());
+  if (mWidth <= 0 || mHeight <= 0) {
+    throw invalid("empty image");
+  }
+  if (data[1] == 'f' || data[1] == 'F') {
+    mSample = PNMSample::Float;
+    const float scale = std::strtof(nextToken().c_str(), nullptr);
+    if (scale == 0.0f) {
+      throw invalid("zero scale");
+    }
+    mSwapBytes = (scale < 0.0f) != kLittleEndian;
+  } else {
+    mMaxValue = std::atoi(nextToken().c_str());
+    if (mMaxValue <= 0 || mMaxValue > 65535) {
+      throw invalid("unsupported maximum value");
+    }
+    mSample = mMaxValue < 256 ? PNMSample::Byte : PNMSample::Short;
+  }
+
+  // A single white space ends the header
+  mOffset = pos + 1;
+  mRowBytes = std::size_t(mWidth) * mChannels * sampleBytes(mSample);
+  if (mOffset + mRowBytes * mHeight > size) {
+    throw invalid("truncated pixels");
+  }
+}
+
+std::size_t PNMFile::GetPosition(int x, int y) const {
+  const int row = mSample == PNMSample::Float ? y : mHeight - 1 - y;
+  return mOffset + mRowBytes * row +
+         std::size_t(x) * mChannels * sampleBytes(mSample);
+}
+
+void PNMFile::ReadRegion(int x, int y, const Image<float>& region) {
+  const float scale = 1.0f / mMaxValue;
+  for (int j = 0; j < region.height(); j++) {
+    const uint8_t* pixels = mFile.data() + GetPosition(x, y + j);
+
+    // One pass over the row for every channel, the samples are converted as
+    // they are read from the mapping
+    for (int c = 0; c < region.channels(); c++) {
+      float* row = region.row(j, c);
+      switch (mSample) {
+        case PNMSample::Byte: {
+          const uint8_t* channel = pixels + c;
+          for (int i = 0; i < region.width(); i++) {
+            row[i] = channel[i * mChannels] * scale;
+          }
+          break;
+        }
+        case PNMSample::Short: {
+          const uint8_t* channel = pixels + 2 * c;
+          for (int i = 0; i < region.width(); i++) {
+            const uint8_t* sample = channel + 2 * i * mChannels;
+            row[i] = ((sample[0] << 8) | sample[1]) * scale;
+          }
+          break;
+        }
+        case PNMSample::Float: {
+          const uint8_t* channel = pixels + 4 * c;
+          for (int i = 0; i < region.width(); i++) {
+            memcpy(&row[i], channel + 4 * i * mChannels, 4);
+          }
+          if (mSwapBytes) {
+            for (int i = 0; i < region.width(); i++) {
+              row[i] = swapFloat(row[i]);
+            }
+          }
+          break;
+        }
+      }
+    }
+  }
+}
+
+void PNMFile::WriteRegion(int x, int y, const Image<const float>& region) {
+  if (!mFile.writable()) {
+    throw std::runtime_error("The PNM file is not writable");
+  }
+  const float maxValue = static_cast<float>(mMaxValue);
+  const auto toSample = [maxValue](float value) {
+    return static_cast<int>(std::clamp(value, 0.0f, 1.0f) * maxValue + 0.5f);
+  };
+  for (int j = 0; j < region.height(); j++) {
+    uint8_t* pixels = mFile.data() + GetPosition(x, y + j);
+    for (int c = 0; c < region.channels(); c++) {
+      const float* row = region.row(j, c);
+      switch (mSample) {
+        case PNMSample::Byte: {
+          uint8_t* channel = pixels + c;
+          for (int i = 0; i < region.width(); i++) {
+            channel[i * mChannels] = static_cast<uint8_t>(toSample(row[i]));
+          }
+          break;
+        }
+        case PNMSample::Short: {
+          uint8_t* channel = pixels + 2 * c;
+          for (int i = 0; i < region.width(); i++) {
+            const int value = toSample(row[i]);
+            uint8_t* sample = channel + 2 * i * mChannels;
+            sample[0] = static_cast<uint8_t>(value >> 8);
+            sample[1] = static_cast<uint8_t>(value);
+          }
+          break;
+        }
+        case PNMSample::Float: {
+          uint8_t* channel = pixels + 4 * c;
+          for (int i = 0; i < region.width(); i++) {
+            const float value = mSwapBytes ? swapFloat(row[i]) : row[i];
+            memcpy(channel + 4 * i * mChannels, &value, 4);
+          }
+          break;
+        }
+      }
+    }
+  }
+}
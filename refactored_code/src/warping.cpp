@@ -1,84 +1,438 @@
 #include "warping.h"
 
-#include "BicubicInterpolation.h"
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
 
-void warpImageGray(float* InputImg, float* inputWeight, int iwidth, int iheight,
-                   float* OutputImg, float* outputWeight, int width, int height,
-                   const Homography& homography) {
-  const float woffset = width * 0.5f;
-  const float hoffset = height * 0.5f;
-  const float iwoffset = iwidth * 0.5f;
-  const float ihoffset = iheight * 0.5f;
-
-  for (int y = 0, index = 0; y < height; y++) {
-    for (int x = 0; x < width; x++, index++) {
-      float fx = x - woffset;
-      float fy = y - hoffset;
-      homography.Transform(fx, fy);  // Inverse mapping, use inverse instead
-      fx += iwoffset;
-      fy += ihoffset;
-
-      if (fx >= 0 && fx < iwidth - 1 && fy >= 0 && fy < iheight - 1) {
-        if (inputWeight) {
-          outputWeight[index] =
-              0.01f +
-              ReturnInterpolatedValueFast(fx, fy, inputWeight, iwidth, iheight);
-        } else {
-          outputWeight[index] = 1.01f;
-        }
+#include "BilinearSampler.h"
+#include "BufferPool.hpp"
+#include "WarpMap.hpp"
+
+namespace {
+
+// Number of output rows in a tile of the row-tiled warp
+constexpr int kRowsPerTile = 16;
+
+// Output tile of the blur. A tile goes through all the samples before the
+// next one, its sums and the source window of its samples stay in L2. RGB
+// tiles have half the rows of gray tiles. The warp maps compute their taps
+// over the same row segments.
+constexpr int kBlurTileWidth = WarpMap::kRowSegmentWidth;
+constexpr int kBlurTileHeight = 32;
+
+// Pixels added around the source window, covers the float differences
+// between the window bounds and the sampler coordinates
+constexpr int kWindowMargin = 2;
+
+void warpRowsGray(float* InputImg, float* inputWeight, int iwidth, int iheight,
+                  float* OutputImg, float* outputWeight, int width, int height,
+                  const Homography& homography, int yBegin, int yEnd) {
+  for (int y = yBegin; y < yEnd; y++) {
+    // Inverse mapping, use inverse instead
+    sampleRowGray(InputImg, inputWeight, iwidth, iheight, OutputImg,
+                  outputWeight, width, height, homography, y, 0, width);
+  }
+}
+
+void warpRowsRgb(float* InputImgR, float* InputImgG, float* InputImgB,
+                 float* inputWeight, int iwidth, int iheight, float* OutputImgR,
+                 float* OutputImgG, float* OutputImgB, float* outputWeight,
+                 int width, int height, const Homography& homography,
+                 int yBegin, int yEnd) {
+  for (int y = yBegin; y < yEnd; y++) {
+    // Inverse mapping, use inverse instead
+    sampleRowRgb(InputImgR, InputImgG, InputImgB, inputWeight, iwidth, iheight,
+                 OutputImgR, OutputImgG, OutputImgB, outputWeight, width,
+                 height, homography, y, 0, width);
+  }
+}
+
+struct BlurImages {
+  int numPlanes;
+  float* input[3];
+  float* inputWeight;
+  int iwidth;
+  int iheight;
+  float* output[3];
+  float* outputWeight;
+  int width;
+  int height;
+  // Called on every normalized output row segment, may be nullptr
+  const std::function<void(int, int)>* epilogue;
+  // Taps of the samples, the positions are then not computed
+  const WarpMap* map = nullptr;
+};
+
+struct BlurTile {
+  int xBegin, xEnd;
+  int yBegin, yEnd;
+};
+
+// Copies of the source windows of the tiles being blurred, taken by a tile
+// and given back for the next one. The frames go back to the pool when the
+// blur returns.
+class WindowBuffers {
+ public:
+  PoolBuffer Take() {
+    std::lock_guard lock(mMutex);
+    if (mFree.empty()) {
+      return {};
+    }
+    PoolBuffer buffer = std::move(mFree.back());
+    mFree.pop_back();
+    return buffer;
+  }
+
+  void Give(PoolBuffer buffer) {
+    std::lock_guard lock(mMutex);
+    mFree.push_back(std::move(buffer));
+  }
+
+ private:
+  std::mutex mMutex;
+  std::vector<PoolBuffer> mFree;
+};
+
+// Bounding box of the input pixels read by the samples of the tile, false if
+// a homography maps the tile across the line at infinity
+bool sourceWindow(const BlurImages& img, const Homography* const* homographies,
+                  int numSamples, const BlurTile& tile, int& x0, int& y0,
+                  int& x1, int& y1) {
+  if (img.iwidth < 2 || img.iheight < 2) {
+    return false;
+  }
+
+  float minX = 0, minY = 0, maxX = 0, maxY = 0;
+  for (int i = 0; i < numSamples; i++) {
+    const auto& H = homographies[i]->Hmatrix;
+    for (int corner = 0; corner < 4; corner++) {
+      const float x =
+          (corner & 1 ? tile.xEnd - 1 : tile.xBegin) - img.width * 0.5f;
+      const float y =
+          (corner & 2 ? tile.yEnd - 1 : tile.yBegin) - img.height * 0.5f;
+      const float z = H[2][0] * x + H[2][1] * y + H[2][2];
+      if (!(z > 1e-6f)) {
+        return false;
+      }
+      const float fx = (H[0][0] * x + H[0][1] * y + H[0][2]) / z;
+      const float fy = (H[1][0] * x + H[1][1] * y + H[1][2]) / z;
+      if ((i == 0 && corner == 0) || fx < minX) minX = fx;
+      if ((i == 0 && corner == 0) || fx > maxX) maxX = fx;
+      if ((i == 0 && corner == 0) || fy < minY) minY = fy;
+      if ((i == 0 && corner == 0) || fy > maxY) maxY = fy;
+    }
+  }
+
+  // The sampler clamps to [0, iwidth - 1.001] and reads one pixel further
+  const float iwoffset = img.iwidth * 0.5f, ihoffset = img.iheight * 0.5f;
+  x0 = (int)std::clamp(minX + iwoffset - kWindowMargin, 0.0f,
+                       (float)(img.iwidth - 2));
+  y0 = (int)std::clamp(minY + ihoffset - kWindowMargin, 0.0f,
+                       (float)(img.iheight - 2));
+  x1 = (int)std::clamp(maxX + iwoffset + 1 + kWindowMargin, (float)(x0 + 1),
+                       (float)(img.iwidth - 1));
+  y1 = (int)std::clamp(maxY + ihoffset + 1 + kWindowMargin, (float)(y0 + 1),
+                       (float)(img.iheight - 1));
+  return true;
+}
+
+// Adds the samples of the tile, sample after sample, through a copy of their
+// source window
+void accumulateTileSamples(const BlurImages& img,
+                           const Homography* const* homographies,
+                           int numSamples, const BlurTile& tile,
+                           WindowBuffers& windows) {
+  const float* input[3] = {img.input[0], img.input[1], img.input[2]};
+  const float* inputWeight = img.inputWeight;
+  SamplerWindow window;
+  const SamplerWindow* pWindow = nullptr;
+  PoolBuffer windowBuffer;
+
+  int x0, y0, x1, y1;
+  if (sourceWindow(img, homographies, numSamples, tile, x0, y0, x1, y1) &&
+      (x1 - x0 + 1) * (y1 - y0 + 1) < img.iwidth * img.iheight) {
+    window = SamplerWindow{x0, y0, x1 - x0 + 1};
+    const int windowSize = window.stride * (y1 - y0 + 1);
+    const int numCopies = img.numPlanes + (inputWeight ? 1 : 0);
+    windowBuffer = windows.Take();
+    windowBuffer.resize(numCopies * windowSize, BufferPool::GetDefault());
+
+    for (int c = 0; c < numCopies; c++) {
+      const float* src = c < img.numPlanes ? img.input[c] : img.inputWeight;
+      float* dst = windowBuffer.data() + c * windowSize;
+      for (int y = y0; y <= y1; y++) {
+        memcpy(dst + (y - y0) * window.stride, src + y * img.iwidth + x0,
+               window.stride * sizeof(float));
+      }
+      if (c < img.numPlanes) {
+        input[c] = dst;
+      } else {
+        inputWeight = dst;
+      }
+    }
+    pWindow = &window;
+  }
+
+  for (int i = 0; i < numSamples; i++) {
+    for (int y = tile.yBegin; y < tile.yEnd; y++) {
+      if (img.numPlanes == 1) {
+        accumulateRowGray(input[0], inputWeight, img.iwidth, img.iheight,
+                          img.output[0], img.outputWeight, img.width,
+                          img.height, *homographies[i], y, tile.xBegin,
+                          tile.xEnd, pWindow);
       } else {
-        outputWeight[index] = 0.01f;
+        accumulateRowRgb(input[0], input[1], input[2], inputWeight,
+                         img.iwidth, img.iheight, img.output[0], img.output[1],
+                         img.output[2], img.outputWeight, img.width,
+                         img.height, *homographies[i], y, tile.xBegin,
+                         tile.xEnd, pWindow);
       }
+    }
+  }
 
-      if (fx < 0) fx = 0;
-      if (fy < 0) fy = 0;
-      if (fx >= iwidth - 1.001f) fx = iwidth - 1.001f;
-      if (fy >= iheight - 1.001f) fy = iheight - 1.001f;
+  if (pWindow) {
+    windows.Give(std::move(windowBuffer));
+  }
+}
 
-      OutputImg[index] =
-          ReturnInterpolatedValueFast(fx, fy, InputImg, iwidth, iheight);
+// Same sums from the taps of the map, in the same order
+void accumulateTileTaps(const BlurImages& img, const BlurTile& tile) {
+  const int tileWidth = tile.xEnd - tile.xBegin;
+  for (int i = 0; i < img.map->GetNumSamples(); i++) {
+    for (int y = tile.yBegin; y < tile.yEnd; y++) {
+      const int index = y * img.width + tile.xBegin;
+      const WarpTap* taps = img.map->GetTaps(i) + index;
+      if (img.numPlanes == 1) {
+        accumulateTapsGray(img.input[0], img.inputWeight, img.iwidth,
+                           img.iheight, taps, img.output[0] + index,
+                           img.outputWeight + index, tileWidth);
+      } else {
+        accumulateTapsRgb(img.input[0], img.input[1], img.input[2],
+                          img.inputWeight, img.iwidth, img.iheight, taps,
+                          img.output[0] + index, img.output[1] + index,
+                          img.output[2] + index, img.outputWeight + index,
+                          tileWidth);
+      }
     }
   }
 }
 
+// Adds the samples of the tile. With normalize the tile is cleared first and
+// divided by the weights at the end, then the epilogue runs on its rows.
+void blurTile(const BlurImages& img, const Homography* const* homographies,
+              int numSamples, const BlurTile& tile, bool normalize,
+              WindowBuffers& windows) {
+  const int tileWidth = tile.xEnd - tile.xBegin;
+  if (normalize) {
+    for (int y = tile.yBegin; y < tile.yEnd; y++) {
+      const int index = y * img.width + tile.xBegin;
+      for (int c = 0; c < img.numPlanes; c++) {
+        memset(img.output[c] + index, 0, tileWidth * sizeof(float));
+      }
+      memset(img.outputWeight + index, 0, tileWidth * sizeof(float));
+    }
+  }
+
+  if (img.map) {
+    accumulateTileTaps(img, tile);
+  } else {
+    accumulateTileSamples(img, homographies, numSamples, tile, windows);
+  }
+
+  if (normalize) {
+    for (int y = tile.yBegin; y < tile.yEnd; y++) {
+      const int begin = y * img.width + tile.xBegin;
+      for (int index = begin; index < begin + tileWidth; index++) {
+        for (int c = 0; c < img.numPlanes; c++) {
+          img.output[c][index] /= img.outputWeight[index];
+        }
+      }
+      if (img.epilogue && *img.epilogue) {
+        (*img.epilogue)(begin, begin + tileWidth);
+      }
+    }
+  }
+}
+
+void blurTiles(const BlurImages& img, const Homography* const* homographies,
+               int numSamples, bool normalize, ThreadPool* threadPool) {
+  const int tileHeight = img.numPlanes == 1 ? kBlurTileHeight
+                                            : kBlurTileHeight / 2;
+  const int numTilesX = (img.width + kBlurTileWidth - 1) / kBlurTileWidth;
+  const int numTilesY = (img.height + tileHeight - 1) / tileHeight;
+  WindowBuffers windows;
+  const auto task = [&](int tile) {
+    const int xBegin = (tile % numTilesX) * kBlurTileWidth;
+    const int yBegin = (tile / numTilesX) * tileHeight;
+    blurTile(img, homographies, numSamples,
+             BlurTile{xBegin, std::min(xBegin + kBlurTileWidth, img.width),
+                      yBegin, std::min(yBegin + tileHeight, img.height)},
+             normalize, windows);
+  };
+
+  if (threadPool) {
+    threadPool->parallelFor(0, numTilesX * numTilesY, task);
+  } else {
+    for (int tile = 0; tile < numTilesX * numTilesY; tile++) {
+      task(tile);
+    }
+  }
+}
+
+}  // namespace
+
+void warpImageGray(float* InputImg, float* inputWeight, int iwidth, int iheight,
+                   float* OutputImg, float* outputWeight, int width, int height,
+                   const Homography& homography) {
+  warpRowsGray(InputImg, inputWeight, iwidth, iheight, OutputImg, outputWeight,
+               width, height, homography, 0, height);
+}
+
 void warpImageRgb(float* InputImgR, float* InputImgG, float* InputImgB,
                   float* inputWeight, int iwidth, int iheight,
                   float* OutputImgR, float* OutputImgG, float* OutputImgB,
                   float* outputWeight, int width, int height,
                   const Homography& homography) {
-  const float woffset = width * 0.5f;
-  const float hoffset = height * 0.5f;
-  const float iwoffset = iwidth * 0.5f;
-  const float ihoffset = iheight * 0.5f;
-
-  for (int y = 0, index = 0; y < height; y++) {
-    for (int x = 0; x < width; x++, index++) {
-      float fx = x - woffset;
-      float fy = y - hoffset;
-      homography.Transform(fx, fy);  // Inverse mapping, use inverse instead
-      fx += iwoffset;
-      fy += ihoffset;
-
-      if (fx >= 0 && fx < iwidth - 1 && fy >= 0 && fy < iheight - 1) {
-        if (inputWeight) {
-          outputWeight[index] =
-              0.01f +
-              ReturnInterpolatedValueFast(fx, fy, inputWeight, iwidth, iheight);
-        } else {
-          outputWeight[index] = 1.01f;
-        }
-      } else {
-        outputWeight[index] = 0.01f;
-      }
+  warpRowsRgb(InputImgR, InputImgG, InputImgB, inputWeight, iwidth, iheight,
+              OutputImgR, OutputImgG, OutputImgB, outputWeight, width, height,
+              homography, 0, height);
+}
 
-      if (fx < 0) fx = 0;
-      if (fy < 0) fy = 0;
-      if (fx >= iwidth - 1.001f) fx = iwidth - 1.001f;
-      if (fy >= iheight - 1.001f) fy = iheight - 1.001f;
+void warpImageGray(float* InputImg, float* inputWeight, int iwidth, int iheight,
+                   float* OutputImg, float* outputWeight, int width, int height,
+                   const Homography& homography, ThreadPool& threadPool) {
+  const int numTiles = (height + kRowsPerTile - 1) / kRowsPerTile;
+  threadPool.parallelFor(0, numTiles, [&](int tile) {
+    const int yBegin = tile * kRowsPerTile;
+    const int yEnd = std::min(yBegin + kRowsPerTile, height);
+    warpRowsGray(InputImg, inputWeight, iwidth, iheight, OutputImg,
+                 outputWeight, width, height, homography, yBegin, yEnd);
+  });
+}
 
-      ReturnInterpolatedValueFast(fx, fy, InputImgR, InputImgG, InputImgB,
-                                  iwidth, iheight, OutputImgR[index],
-                                  OutputImgG[index], OutputImgB[index]);
-    }
-  }
-}
\ No newline at end of file
+void warpImageRgb(float* InputImgR, float* InputImgG, float* InputImgB,
+                  float* inputWeight, int iwidth, int iheight,
+                  float* OutputImgR, float* OutputImgG, float* OutputImgB,
+                  float* outputWeight, int width, int height,
+                  const Homography& homography, ThreadPool& threadPool) {
+  const int numTiles = (height + kRowsPerTile - 1) / kRowsPerTile;
+  threadPool.parallelFor(0, numTiles, [&](int tile) {
+    const int yBegin = tile * kRowsPerTile;
+    const int yEnd = std::min(yBegin + kRowsPerTile, height);
+    warpRowsRgb(InputImgR, InputImgG, InputImgB, inputWeight, iwidth, iheight,
+                OutputImgR, OutputImgG, OutputImgB, outputWeight, width, height,
+                homography, yBegin, yEnd);
+  });
+}
+
+void blurImageGray(float* InputImg, float* inputWeight, int iwidth, int iheight,
+                   float* BlurImg, float* outputWeight, int width, int height,
+                   const Homography* const* homographies, int numSamples,
+                   const std::function<void(int, int)>& epilogue) {
+  const BlurImages img{1,      {InputImg, nullptr, nullptr}, inputWeight,
+                       iwidth, iheight, {BlurImg, nullptr, nullptr},
+                       outputWeight, width, height, &epilogue};
+  blurTiles(img, homographies, numSamples, true, nullptr);
+}
+
+void blurImageRgb(float* InputImgR, float* InputImgG, float* InputImgB,
+                  float* inputWeight, int iwidth, int iheight, float* BlurImgR,
+                  float* BlurImgG, float* BlurImgB, float* outputWeight,
+                  int width, int height, const Homography* const* homographies,
+                  int numSamples,
+                  const std::function<void(int, int)>& epilogue) {
+  const BlurImages img{3,      {InputImgR, InputImgG, InputImgB}, inputWeight,
+                       iwidth, iheight, {BlurImgR, BlurImgG, BlurImgB},
+                       outputWeight, width, height, &epilogue};
+  blurTiles(img, homographies, numSamples, true, nullptr);
+}
+
+void blurImageGray(float* InputImg, float* inputWeight, int iwidth, int iheight,
+                   float* BlurImg, float* outputWeight, int width, int height,
+                   const Homography* const* homographies, int numSamples,
+                   ThreadPool& threadPool,
+                   const std::function<void(int, int)>& epilogue) {
+  const BlurImages img{1,      {InputImg, nullptr, nullptr}, inputWeight,
+                       iwidth, iheight, {BlurImg, nullptr, nullptr},
+                       outputWeight, width, height, &epilogue};
+  blurTiles(img, homographies, numSamples, true, &threadPool);
+}
+
+void blurImageRgb(float* InputImgR, float* InputImgG, float* InputImgB,
+                  float* inputWeight, int iwidth, int iheight, float* BlurImgR,
+                  float* BlurImgG, float* BlurImgB, float* outputWeight,
+                  int width, int height, const Homography* const* homographies,
+                  int numSamples, ThreadPool& threadPool,
+                  const std::function<void(int, int)>& epilogue) {
+  const BlurImages img{3,      {InputImgR, InputImgG, InputImgB}, inputWeight,
+                       iwidth, iheight, {BlurImgR, BlurImgG, BlurImgB},
+                       outputWeight, width, height, &epilogue};
+  blurTiles(img, homographies, numSamples, true, &threadPool);
+}
+
+void blurImageGray(float* InputImg, float* inputWeight, int iwidth, int iheight,
+                   float* BlurImg, float* outputWeight, int width, int height,
+                   const WarpMap& map,
+                   const std::function<void(int, int)>& epilogue) {
+  const BlurImages img{1,      {InputImg, nullptr, nullptr}, inputWeight,
+                       iwidth, iheight, {BlurImg, nullptr, nullptr},
+                       outputWeight, width, height, &epilogue, &map};
+  blurTiles(img, nullptr, 0, true, nullptr);
+}
+
+void blurImageRgb(float* InputImgR, float* InputImgG, float* InputImgB,
+                  float* inputWeight, int iwidth, int iheight, float* BlurImgR,
+                  float* BlurImgG, float* BlurImgB, float* outputWeight,
+                  int width, int height, const WarpMap& map,
+                  const std::function<void(int, int)>& epilogue) {
+  const BlurImages img{3,      {InputImgR, InputImgG, InputImgB}, inputWeight,
+                       iwidth, iheight, {BlurImgR, BlurImgG, BlurImgB},
+                       outputWeight, width, height, &epilogue, &map};
+  blurTiles(img, nullptr, 0, true, nullptr);
+}
+
+void blurImageGray(float* InputImg, float* inputWeight, int iwidth, int iheight,
+                   float* BlurImg, float* outputWeight, int width, int height,
+                   const WarpMap& map, ThreadPool& threadPool,
+                   const std::function<void(int, int)>& epilogue) {
+  const BlurImages img{1,      {InputImg, nullptr, nullptr}, inputWeight,
+                       iwidth, iheight, {BlurImg, nullptr, nullptr},
+                       outputWeight, width, height, &epilogue, &map};
+  blurTiles(img, nullptr, 0, true, &threadPool);
+}
+
+void blurImageRgb(float* InputImgR, float* InputImgG, float* InputImgB,
+                  float* inputWeight, int iwidth, int iheight, float* BlurImgR,
+                  float* BlurImgG, float* BlurImgB, float* outputWeight,
+                  int width, int height, const WarpMap& map,
+                  ThreadPool& threadPool,
+                  const std::function<void(int, int)>& epilogue) {
+  const BlurImages img{3,      {InputImgR, InputImgG, InputImgB}, inputWeight,
+                       iwidth, iheight, {BlurImgR, BlurImgG, BlurImgB},
+                       outputWeight, width, height, &epilogue, &map};
+  blurTiles(img, nullptr, 0, true, &threadPool);
+}
+
+void accumulateBlurGray(float* InputImg, float* inputWeight, int iwidth,
+                        int iheight, float* BlurImg, float* outputWeight,
+                        int width, int height,
+                        const Homography* const* homographies, int numSamples) {
+  const BlurImages img{1,      {InputImg, nullptr, nullptr}, inputWeight,
+                       iwidth, iheight, {BlurImg, nullptr, nullptr},
+                       outputWeight, width, height, nullptr};
+  blurTiles(img, homographies, numSamples, false, nullptr);
+}
+
+void accumulateBlurRgb(float* InputImgR, float* InputImgG, float* InputImgB,
+                       float* inputWeight, int iwidth, int iheight,
+                       float* BlurImgR, float* BlurImgG, float* BlurImgB,
+                       float* outputWeight, int width, int height,
+                       const Homography* const* homographies, int numSamples) {
+  const BlurImages img{3,      {InputImgR, InputImgG, InputImgB}, inputWeight,
+                       iwidth, iheight, {BlurImgR, BlurImgG, BlurImgB},
+                       outputWeight, width, height, nullptr};
+  blurTiles(img, homographies, numSamples, false, nullptr);
+}